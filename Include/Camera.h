@@ -6,6 +6,19 @@
 #include "VecMat.h"
 #include "Widgets.h"
 
+// Frustum: six world-space planes (a,b,c,d) extracted from a camera fullview
+// a point p is inside a plane if a*p.x+b*p.y+c*p.z+d >= 0
+
+struct Frustum {
+	vec4	planes[6];					// left, right, bottom, top, near, far
+	Frustum() { }
+	Frustum(const mat4 &fullview);
+	bool	SphereVisible(vec3 center, float radius) const;
+		// false if sphere entirely outside any plane
+	bool	BoxVisible(vec3 min, vec3 max, const mat4 &toWorld) const;
+		// false if axis-aligned box (in space given by toWorld) entirely outside any plane
+};
+
 // mousex, mousey in screen coordinates (xmouse increases rightwards, ymouse increases downwards)
 // OpenGL expects Y-axis upwards, mouse coords expect Y downwards
 // simple camera parameters and methods for mouse
@@ -35,6 +48,7 @@ public:
 	mat4    modelview, persp, fullview; // read-only
 	mat4    GetRotate();
 	vec3	Position();
+	Frustum	GetFrustum();				// planes from fullview; extract once per frame
 	void    SetRotateCenter(vec3 r);
 	void    Up();
 	void    Down(double xmouse, double ymouse, bool shift = false, bool control = false);
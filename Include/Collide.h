@@ -0,0 +1,75 @@
+// Collide.h - oriented bounding box trees for mesh-mesh overlap, contact, and distance queries
+
+#ifndef COLLIDE_HDR
+#define COLLIDE_HDR
+
+#include <float.h>
+#include <vector>
+#include "VecMat.h"
+
+using std::vector;
+
+// Oriented Box
+
+struct OBB {
+	vec3 center;
+	vec3 axes[3];							// orthonormal
+	vec3 halfSize;							// extent along each axis
+};
+
+float Separation(const OBB &a, const OBB &b);
+	// largest gap between projections of a and b onto the 15 separating axes of two boxes
+	// positive means disjoint (and is a lower bound on their distance); else they overlap
+
+// Tree
+
+class OBBTree {
+	// binary tree of boxes fit (by principal axes) to triangle vertices; leaves hold few triangles
+public:
+	struct Node {
+		OBB box;
+		int children = -1;					// index of first child (second follows), -1 if leaf
+		int start = 0, count = 0;			// leaf triangles, ids[start] to ids[start+count-1]
+	};
+	vector<Node> nodes;						// nodes[0] is root
+	vector<int> ids;						// original triangle ids, in leaf order
+	vector<vec3> corners;					// three vertices per triangle, in leaf order
+	void Build(vector<vec3> &points, vector<int3> &triangles, int leafSize = 4);
+	bool Empty() { return nodes.empty(); }
+};
+
+// Queries
+// boxes of the second tree are carried into the first's space by inverse(toWorld1)*toWorld2;
+// non-uniform scale is handled (boxes are conservatively refit), but similarity transforms are tightest
+
+struct ContactPair {
+	int triangle1, triangle2;				// original triangle ids in the two meshes
+};
+
+bool Overlap(OBBTree &tree1, const mat4 &toWorld1, OBBTree &tree2, const mat4 &toWorld2,
+			 vector<ContactPair> *contacts = NULL, int maxContacts = 1 << 30);
+	// true if any triangles intersect; if contacts null, stop at the first intersecting pair,
+	// else collect (up to maxContacts) intersecting pairs
+
+struct DistanceResult {
+	float distance = FLT_MAX;				// in space of tree1 (world space if toWorld1 is rigid)
+	int triangle1 = -1, triangle2 = -1;
+	vec3 point1, point2;					// closest points, world space
+};
+
+float MinDistance(OBBTree &tree1, const mat4 &toWorld1, OBBTree &tree2, const mat4 &toWorld2,
+				  DistanceResult *result = NULL, float maxDistance = FLT_MAX);
+	// least distance between the meshes (0 if they intersect); pairs of boxes farther apart than
+	// the best found (or maxDistance) are pruned; returns FLT_MAX if nothing within maxDistance
+
+bool TrianglesIntersect(vec3 v0, vec3 v1, vec3 v2, vec3 u0, vec3 u1, vec3 u2);
+	// Moller, "A Fast Triangle-Triangle Intersection Test", including coplanar triangles
+	// (zero-area triangles never intersect)
+
+float TriangleDistance(vec3 v0, vec3 v1, vec3 v2, vec3 u0, vec3 u1, vec3 u2, vec3 *p = NULL, vec3 *q = NULL);
+	// least distance between triangles, closest points p (on v) and q (on u)
+
+vec3 ClosestOnTriangle(vec3 p, vec3 a, vec3 b, vec3 c);
+	// point of triangle abc nearest p
+
+#endif
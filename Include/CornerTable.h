@@ -0,0 +1,87 @@
+// CornerTable.h - array-based triangle adjacency (corner table) for constant-time topological queries
+
+#ifndef CORNER_TABLE_HDR
+#define CORNER_TABLE_HDR
+
+#include <vector>
+#include "VecMat.h"
+
+using std::vector;
+
+// corner c = 3*triangle+k is vertex k of triangle; it is equivalent to the half-edge opposite it,
+// from Vertex(Next(c)) to Vertex(Prev(c)); Opposite(c) is the corner facing c across that edge
+
+class CornerTable {
+public:
+	vector<int> V;							// vertex of each corner, -1 if triangle deleted
+	vector<int> O;							// opposite corner, -1 if boundary (or non-manifold) edge
+	vector<int> vertexCorners;				// a corner of each vertex, -1 if unused; on a boundary,
+											// the first corner of its fan (so Swing reaches all corners)
+	int nVertices = 0, nDeleted = 0;
+	int nNonManifoldEdges = 0;				// edges of more than two triangles, or inconsistently oriented
+	// construction
+	void Build(vector<int3> &triangles, int nVertices);
+		// threads match corners across edges (bucketed by lower vertex id), near linear time
+	void GetTriangles(vector<int3> &triangles);
+		// undeleted triangles (after edits, rebuild for compact arrays)
+	// navigation
+	static int Next(int c) { return c%3 == 2? c-2 : c+1; }
+	static int Prev(int c) { return c%3 == 0? c+2 : c-1; }
+	int NTriangles() { return V.size()/3; }
+	int Vertex(int c) { return V[c]; }
+	int Opposite(int c) { return O[c]; }
+	int Swing(int c) { int o = O[Next(c)]; return o < 0? -1 : Next(o); }
+		// next corner of Vertex(c), counter-clockwise; -1 at boundary
+	int SwingBack(int c) { int o = O[Prev(c)]; return o < 0? -1 : Prev(o); }
+	bool BoundaryEdge(int c) { return O[c] < 0; }
+	bool BoundaryVertex(int v) { int c = vertexCorners[v]; return c >= 0 && O[Prev(c)] < 0; }
+	bool Deleted(int t) { return V[3*t] < 0; }
+	// one-ring
+	template<class F> void ForEachCorner(int v, F f) {
+		// call f(c) for each corner of v
+		int start = vertexCorners[v], c = start;
+		if (c >= 0)
+			do { f(c); c = Swing(c); } while (c >= 0 && c != start);
+	}
+	template<class F> void ForEachNeighbor(int v, F f) {
+		// call f(neighbor) for each vertex sharing an edge with v
+		int start = vertexCorners[v], c = start, last = -1;
+		if (c < 0)
+			return;
+		do { f(V[Next(c)]); last = c; c = Swing(c); } while (c >= 0 && c != start);
+		if (c < 0)
+			f(V[Prev(last)]);
+	}
+	int Valence(int v);
+	bool Adjacent(int v1, int v2);
+	// edits (topological; caller checks geometry, eg triangle flips)
+	bool Flip(int c);
+		// replace the edge opposite c with the edge from Vertex(c) to the vertex opposite it
+		// false if edge is boundary or the new edge exists
+	int Split(int c);
+		// insert new vertex (id nVertices, returned) on edge opposite c; adds one or two triangles
+		// caller appends the new point (and any other per-vertex data)
+	bool Collapse(int c);
+		// merge Vertex(Prev(c)) into Vertex(Next(c)), deleting the one or two triangles on the edge
+		// false if the link condition fails (collapse would make the mesh non-manifold)
+private:
+	void Link(int c1, int c2) { if (c1 >= 0) O[c1] = c2; if (c2 >= 0) O[c2] = c1; }
+	int CornerOf(int c, int v);
+	void ResetVertexCorner(int v, int c);
+};
+
+// Operations on the Table
+
+void SmoothVertices(CornerTable &table, vector<vec3> &points, int iterations = 1,
+					float lambda = .5f, float mu = -.53f, bool fixBoundary = true);
+	// threaded umbrella (Laplacian) smoothing; if mu non-zero, each pass is followed by an
+	// inflating pass with factor mu (Taubin), which largely avoids shrinkage
+
+void ComputeVertexNormals(CornerTable &table, vector<vec3> &points, vector<vec3> &normals);
+	// threaded, angle-weighted; gathers over each vertex's corners (no atomics or locks)
+
+int CountCreases(CornerTable &table, vector<vec3> &points, float creaseAngle, vector<char> *creaseCorners = NULL);
+	// count interior edges whose triangles meet at more than creaseAngle (in degrees)
+	// creaseCorners, if non-null, set per corner (1 if edge opposite corner is a crease)
+
+#endif
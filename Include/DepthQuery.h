@@ -0,0 +1,89 @@
+// DepthQuery.h - batched, non-blocking depth-buffer reads and occlusion queries
+
+#ifndef DEPTH_QUERY_HDR
+#define DEPTH_QUERY_HDR
+
+#include <vector>
+#include "glad.h"
+#include "VecMat.h"
+
+using std::vector;
+
+// Depth Queries
+
+class DepthQueries {
+	// replaces per-point IsVisible/DepthXY, each of which stalls the pipeline: during a frame, Submit
+	// any number of pixels (or points), then Capture once; the bounding rectangle of submitted pixels
+	// is copied from the depth buffer into a pixel buffer asynchronously (fenced, in a ring of three),
+	// and a later Resolve (typically next frame) maps the copy once the GPU has finished with it
+public:
+	struct Result {
+		int x = 0, y = 0;						// pixel
+		int tag = 0;							// caller's label
+		float depth = 0;						// depth-buffer value, normalized to +/-1 (as DepthXY)
+		bool point = false;						// submitted as a 3D point
+		float z = 0, fudge = 0;					// transformed point depth (if point)
+		bool visible = true;					// z < depth+fudge (if point)
+	};
+	int Submit(int x, int y, int tag = 0);
+		// queue pixel for this frame's capture; return index into (eventual) results, or -1 if off-viewport
+	int Submit(vec3 p, mat4 fullview, int tag = 0, float fudge = 0);
+		// as IsVisible: queue screen location of transformed p, later test its depth against the buffer
+	void Capture(bool wholeViewport = false);
+		// call once per frame, when the depth buffer holds what the queries should see
+		// if wholeViewport, copy the entire viewport (see Depth(x, y, depth))
+	bool Resolve(bool wait = false);
+		// if captures have completed (or, if wait, after blocking on them), set results and return true
+	vector<Result> results;						// of the most recently resolved capture
+	int frame = 0;								// number of captures
+	int resultsFrame = 0;						// capture number of results (0 if none)
+	bool Depth(int x, int y, float &depth);
+		// look up pixel in the most recent resolved whole-viewport capture; false if none or outside
+	int Pending() { return (int) pending.size(); }
+	void Release();
+	~DepthQueries() { Release(); }
+private:
+	static const int nBuffers = 3;
+	struct Batch {
+		GLuint pbo = 0;
+		GLsync fence = NULL;
+		int capacity = 0;						// bytes
+		int4 rect;								// x, y, width, height
+		float depthRange[2] = {0, 1};
+		bool wholeViewport = false;
+		int frame = 0;
+		vector<Result> queries;
+	};
+	Batch batches[nBuffers];
+	int head = 0;								// next batch to fill (oldest in flight, if any)
+	int4 viewport;								// at first Submit of the frame
+	vector<Result> pending;						// submitted since last Capture
+	int4 imageRect;								// of last resolved whole-viewport capture
+	vector<float> image;						// its depths, normalized to +/-1
+	void ResolveBatch(Batch &b);
+};
+
+// Occlusion Queries
+
+class OcclusionQueries {
+	// hardware sample-count queries, polled without stalling: bracket a proxy draw (eg, bounding
+	// box, depth test on, color and depth writes off) with Begin(id)/End; while a query is in flight,
+	// Begin for that id is skipped, and Visible reports the last available result
+public:
+	void Begin(int id);
+	void End();
+	bool Visible(int id, bool *available = NULL);
+		// true if any samples passed (or no result yet); if non-null, available set false if no result yet
+	void Release();
+	~OcclusionQueries() { Release(); }
+private:
+	struct Query {
+		GLuint name = 0;
+		bool pending = false, visible = true, available = false;
+	};
+	vector<Query> queries;
+	int active = -1;
+	void Poll(Query &q);
+};
+
+#endif
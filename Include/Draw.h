@@ -5,6 +5,7 @@
 #define DRAW_HDR
 
 #include <glad.h>
+#include <vector>
 #include "VecMat.h"
 
 // viewport operations
@@ -22,11 +23,12 @@ mat4 ScreenMode();
 bool IsVisible(vec3 p, mat4 fullview, vec2 *screen = NULL, int *w = NULL, int *h = NULL, float fudge = 0);
 	// if the depth test is enabled, is point p visible?
 	// if non-null, set screen location (in pixels) of transformed p
-	// **** this is slow when used during rendering!
+	// **** this is slow when used during rendering! (for many points, see DepthQueries)
 bool DepthXY(int x, int y, float &depth);
 	// return false if depth-buffer disabled, else
 	// return true and set depth to z-value at pixel(x,y)
 	// normalized for +/-1 space
+	// synchronous readback stalls the pipeline (see DepthQueries, DepthQuery.h)
 // ScreenPoint, ScreenD require appropriate viewport
 vec2 ScreenPoint(vec3 p, mat4 m, int vp[4], float *zscreen = NULL);
 vec2 ScreenPoint(vec3 p, mat4 m, float *zscreen = NULL);
@@ -70,8 +72,11 @@ void Line(vec2 p1, vec2 p2, float width, vec3 col, float opacity = 1);
 void Line(vec2 p1, vec2 p2, float width, vec3 col1, vec3 col2, float opacity = 1);
 void Line(int x1, int y1, int x2, int y2, float width, vec3 col, float opacity = 1);
 void LineDash(vec3 p1, vec3 p2, float width, vec3 col1, vec3 col2, float opacity = 1, float dashLen = 20, float percentDash = .5);
+	// one line, dashes cut by the pixel shader (dashLen in pixels); colors interpolate along whole line
 void LineDot(vec3 p1, vec3 p2, float width, vec3 col, float opacity = 1, int pixelSpacing = 7);
+	// dots of diameter width, drawn as one batch of points
 void LineStrip(int nPoints, vec3 *points, vec3 &color, float opacity, float width);
+	// drawn as a Polyline (round joins and caps), with view as set by UseDrawShader; on macOS, as Lines
 void Quad(int x1, int y1, int x2, int y2, int x3, int y3, int x4, int y4, bool solid, vec3 color, float opacity = 1, float lineWidth = 1);
 void Quad(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4, bool solid, vec3 color, float opacity = 1, float lineWidth = 1);
 void Quad(vec3 p1, vec3 p2, vec3 p3, vec3 p4, bool solid, vec3 color, float opacity = 1, float lineWidth = 1);
@@ -84,7 +89,32 @@ void Arrow(vec2 base, vec2 head, vec3 color, float lineWidth = 1, double headSiz
 void ArrowV(vec3 base, vec3 v, mat4 modelview, mat4 persp, vec3 color, float lineWidth = 1, double headSize = 4);
 	// as above but vector and base are 3D, transformed by m
 void Cylinder(vec3 p1, vec3 p2, float r1, float r2, mat4 modelview, mat4 persp, vec4 color);
-	// p1 and p2 specify x,y,z for cylinder endpoints, and w for radius
+	// endpoints p1, p2 with radii r1, r2 (a cone if either is 0), open-ended; drawn as one instance of Cylinders
+
+// instanced cylinders and arrows
+// each instance is a tessellated patch whose sides (4 to 48) follow its radius on screen; one draw per call
+
+struct CylinderInstance {
+	vec3 p1; float r1;
+	vec3 p2; float r2;
+	vec4 color;								// alpha is opacity
+	CylinderInstance() { }
+	CylinderInstance(vec3 p1, vec3 p2, float r1, float r2, vec4 color) : p1(p1), r1(r1), p2(p2), r2(r2), color(color) { }
+};
+
+struct ArrowInstance {
+	vec3 base, head;
+	float radius;							// of shaft
+	vec4 color;
+	ArrowInstance() { }
+	ArrowInstance(vec3 base, vec3 head, float radius, vec4 color) : base(base), head(head), radius(radius), color(color) { }
+};
+
+void Cylinders(const CylinderInstance *instances, int nInstances, mat4 modelview, mat4 persp);
+void Cylinders(const std::vector<CylinderInstance> &instances, mat4 modelview, mat4 persp);
+void Arrows(const ArrowInstance *arrows, int nArrows, mat4 modelview, mat4 persp, float headLength = .25f, float headRadius = 2.5f);
+void Arrows(const std::vector<ArrowInstance> &arrows, mat4 modelview, mat4 persp, float headLength = .25f, float headRadius = 2.5f);
+	// shaft cylinder and cone head per arrow; headLength a fraction of the arrow, headRadius a multiple of its radius
 
 // triangle operations
 GLuint UseTriangleShader();
@@ -95,4 +125,107 @@ void Triangle(vec3 p1, vec3 p2, vec3 p3, vec3 c1, vec3 c2, vec3 c3,
 
 void Box(vec3 a, vec3 b, float width, vec3 col);
 
+// batching
+// Disk, Line, LineDash, LineDot, Quad (untextured), Triangle, Star, Box, and Arrow record into the current draw list;
+// outside BeginDrawList/EndDrawList the list is flushed at once (one draw per call), within them
+// primitives accumulate and EndDrawList draws them with one upload and one draw per group
+// view (see UseDrawShader, UseTriangleShader) is recorded with each primitive
+
+class DrawList {
+public:
+	struct Vertex {
+		vec3 point, color;
+		float dash = 0;						// distance along line, in dash periods
+	};
+	struct State {
+		GLenum mode = GL_LINES;				// GL_POINTS, GL_LINES, or GL_TRIANGLES
+		bool triangleShader = false;		// Triangle outlines, else draw shader
+		mat4 view;
+		float opacity = 1, size = 1;		// line width or point diameter
+		bool ring = false;
+		float dashFraction = 1;				// portion of each dash period drawn
+		bool outline = false;
+		vec4 outlineColor;
+		float outlineWidth = 1, transition = 1;
+		bool operator==(const State &s) const;
+	};
+	struct Group {
+		State state;
+		int start = 0, count = 0;			// vertices
+	};
+	std::vector<Vertex> vertices;
+	std::vector<Group> groups;				// consecutive primitives with equal state share a group
+	void Disk(vec3 p, float diameter, vec3 color, float opacity = 1, bool ring = false);
+	void Line(vec3 p1, vec3 p2, float width, vec3 col1, vec3 col2, float opacity = 1);
+	void LineDash(vec3 p1, vec3 p2, float width, vec3 col1, vec3 col2, float opacity = 1, float dashLen = 20, float percentDash = .5);
+	void LineDot(vec3 p1, vec3 p2, float width, vec3 col, float opacity = 1, int pixelSpacing = 7);
+		// lengths in pixels, given the current view and viewport
+	void Quad(vec3 p1, vec3 p2, vec3 p3, vec3 p4, bool solid, vec3 color, float opacity = 1, float lineWidth = 1);
+	void Triangle(vec3 p1, vec3 p2, vec3 p3, vec3 c1, vec3 c2, vec3 c3, float opacity = 1, bool outline = false,
+				  vec4 outlineCol = vec3(0,0,0), float outlineWidth = 1, float transition = 1);
+	void Flush();
+		// upload all vertices, draw each group (in order recorded), clear
+	void Clear() { vertices.resize(0); groups.resize(0); }
+	bool Empty() { return groups.empty(); }
+	void Release();
+	~DrawList() { Release(); }
+private:
+	GLuint vao = 0, vbo = 0;
+	int capacity = 0;						// bytes allocated in vbo
+	Vertex *Add(const State &s, int nVertices);
+};
+
+// lines wider than one pixel (and not dashed) are drawn as Polyline segments, with butt caps, if the
+// polyline shader is available (see PolylineAvailable), else with glLineWidth
+
+void BeginDrawList(DrawList *list = NULL);
+	// route drawing to list (if null, to the current list, else an implicit list); calls nest
+void EndDrawList();
+	// flush the list when its outermost Begin is ended
+DrawList &CurrentDrawList();
+void FlushDrawList();
+	// draw anything pending in the current list (eg, before unbatched drawing)
+
+// polylines
+// segments are expanded to screen-aligned quads by a vertex shader reading points from storage buffers
+// (OpenGL 4.3, so not on macOS); joins, caps, and anti-aliasing are computed per pixel, so width is not
+// limited by glLineWidth; without 4.3, segments are drawn as GL_LINES (no joins or caps)
+
+enum class LineJoin { Miter, Round };
+enum class LineCap { Butt, Square, Round };
+
+bool PolylineAvailable();
+	// true if the polyline shader is built (first call tries, reporting failure once)
+
+struct PolylineVertex {
+	vec3 point;
+	float width = 1;						// in pixels
+	vec4 color = vec4(0, 0, 0, 1);			// alpha is opacity
+	PolylineVertex() { }
+	PolylineVertex(vec3 p, float w, vec4 c) : point(p), width(w), color(c) { }
+};
+
+class Polyline {
+public:
+	LineJoin join = LineJoin::Round;
+	LineCap cap = LineCap::Round;
+	float miterLimit = 4;					// miter length (as multiple of half width) before it is clipped
+	std::vector<PolylineVertex> vertices;
+	std::vector<GLuint> segments;			// first vertex of each segment, high bits flag strip start/end
+	bool dirty = true;						// set if vertices edited directly; Draw uploads when set
+	void AddStrip(const vec3 *points, int nPoints, float width, vec4 color);
+	void AddStrip(const PolylineVertex *strip, int nVertices);
+		// each strip is independent (joins within, caps at its ends)
+	void Clear() { vertices.resize(0); segments.resize(0); dirty = true; }
+		// capacity is kept, so refilling each frame does not allocate
+	void Draw(mat4 view);
+		// one draw for all strips; view maps points to clip space (eg, camera.fullview)
+	void Release();
+	~Polyline() { Release(); }
+private:
+	GLuint vao = 0, vertexBuffer = 0, segmentBuffer = 0;
+	int vertexCapacity = 0, segmentCapacity = 0;
+	void AddSegments(int start, int nVertices);
+};
+
 #endif
@@ -0,0 +1,38 @@
+// GLState.h - shadow of frequently set OpenGL state: skip redundant changes, answer queries locally
+
+#ifndef GL_STATE_HDR
+#define GL_STATE_HDR
+
+#include "glad.h"
+#include "VecMat.h"
+
+void ShadowGLState(bool on = true);
+	// route glUseProgram, glBindVertexArray, glBindBuffer(Base/Range), glActiveTexture, glBindTexture,
+	// glEnable, glDisable, glIsEnabled, glBlendFunc, glViewport (and the matching glDelete calls)
+	// through a cache that drops calls that would not change state; existing code needs no change
+	// call after gladLoadGLLoader (InitGLFW does); assumes a single context
+void InvalidateGLState();
+	// forget cached values: call after state is changed other than through the calls above
+	// (eg, glBindTextureUnit, glBlendFuncSeparate, glViewportIndexed, or another context)
+
+// Queries
+// answered from the cache; the driver is asked only if a value is not yet known (or not shadowing)
+
+int4 ShadowedViewport();
+GLuint ShadowedProgram();
+GLuint ShadowedVertexArray();
+
+// Statistics
+
+struct GLStateCount {
+	int calls = 0;							// shadowed calls and queries
+	int redundant = 0;						// calls dropped, queries answered from the cache
+};
+
+GLStateCount GLStateCounts();
+	// totals since start (or last reset)
+void ResetGLStateCounts();
+void PrintGLStateCounts();
+	// totals and per-category (program, vertex array, buffer, texture, enable, blend, viewport, query)
+
+#endif
@@ -5,6 +5,7 @@
 
 #include "glad.h"
 #include <GLFW/glfw3.h>
+#include <vector>
 #include "VecMat.h"
 
 // GLFW
@@ -61,11 +62,63 @@ GLuint LinkProgramViaFile(const char *computeShaderFile);
 int CurrentProgram();
 void DeleteProgram(int program);
 
+// Buffer Uploads
+bool UploadBuffer(GLuint buffer, int offset, int nBytes, const void *data, bool persistent = false);
+	// copy nBytes of data to buffer at offset
+	// if persistent, stage through a persistently mapped ring (requires OpenGL 4.4) and copy on the GPU;
+	// ring regions are fenced and reused only after the GPU has consumed them
+	// otherwise (or if the ring is unavailable or too small) use glBufferSubData
+void FenceUploads();
+	// fence ring regions written since last call; call after a batch of persistent uploads
+void SetUploadRingSize(int nBytes);
+	// default 8MB; takes effect on next persistent upload
+
 // Binary Read/Write
 void WriteProgramBinary(GLuint program, const char *filename);
 bool ReadProgramBinary(GLuint program, const char *filename);
 GLuint ReadProgramBinary(const char *filename);
 
+// Program Cache
+// LinkProgramViaCode saves each linked program as a binary named by a hash of its stage sources and
+// the GL vendor, renderer, and version; linking the same sources again loads the binary instead of
+// compiling; binaries the driver rejects (eg, after an update) fall back to compiling, and are replaced
+void SetProgramCache(const char *directory = "ShaderCache", bool enable = true);
+	// directory is relative to the working directory, created if needed
+struct ProgramCacheCount {
+	int hits = 0;							// programs loaded from binaries
+	int misses = 0;							// programs compiled (and saved)
+	int rejected = 0;						// binaries the driver would not load
+};
+ProgramCacheCount ProgramCacheCounts();
+void PrintProgramCacheCounts();
+
+// Shader Warm-Up
+// library modules register their programs; WarmUpShaders, called once a context exists, submits them
+// all (compiling in parallel if the driver offers GL_KHR_parallel_shader_compile) without waiting;
+// the first LinkProgramViaCode of registered sources then returns the submitted program, checking
+// its status (and waiting only if the driver has not yet finished) rather than compiling mid-frame
+bool RegisterProgram(const char *name, const char **vertexCode, const char **pixelCode);
+bool RegisterProgram(const char *name,
+					 const char **vertexCode,
+					 const char **tessellationControlCode,
+					 const char **tessellationEvalCode,
+					 const char **geometryCode,
+					 const char **pixelCode);
+bool RegisterProgram(const char *name, const char **computeCode);
+	// the code arguments are addresses, matched to those later given LinkProgramViaCode; return true,
+	// eg, static bool registered = RegisterProgram("Letters", &vShader, &pShader);
+void WarmUpShaders(std::vector<const char *> names = {}, bool wait = false);
+	// submit the named registered programs (all, if names empty) not yet built, skipping any whose
+	// #version the context lacks; if wait, finish them all before returning
+bool ShadersReady();
+	// finish submitted programs the driver has completed; true if none remain
+	// (without parallel compilation the driver can't be asked, so all are finished, waiting if need be)
+void ReleaseUnclaimedShaders();
+	// delete programs submitted but never claimed by LinkProgramViaCode (eg, at exit)
+void PrintShaderTimes();
+	// per program: ms to submit, until finished (claimed, or found complete by ShadersReady), and
+	// blocked waiting for the driver
+
 // Uniforms
 void SetReport(bool report);
 	// if report, print any unknown uniforms or attributes
@@ -3,11 +3,35 @@
 #ifndef LETTERS_HDR
 #define LETTERS_HDR
 
+#include <vector>
+#include "glad.h"
 #include "VecMat.h"
 
 void Letters(int x, int y, const char *s, vec3 color, float ptSize);
 void Letters(vec3 p, mat4 m, const char *s, vec3 color, float ptSize);
 
 // s is any string but only letters, numerals, space, period, or dash, plus-sign, or slash are printed
+// glyphs (from an atlas built at compile time) and punctuation strokes of a string are drawn in one call
+
+void BeginLetters();
+	// calls nest; until the outermost EndLetters, strings accumulate and are then drawn in one call
+void EndLetters();
+void FlushLetters();
+	// draw accumulated strings now
+
+// glyph quads, also used by Text and TextBlock
+
+struct GlyphVertex {
+	vec2 point, uv;							// pixel position, texture coordinates
+	vec3 color;
+	float page = 0;							// atlas texture array layer (FreeType text)
+	GlyphVertex() { }
+	GlyphVertex(vec2 p, vec2 uv, vec3 c, float page = 0) : point(p), uv(uv), color(c), page(page) { }
+};
+
+void LetterQuads(int x, int y, char c, vec3 color, float ptSize, std::vector<GlyphVertex> &quads);
+	// append six vertices per quad (glyph or punctuation stroke) for c at pixel (x, y); advance is ptSize
+GLuint UseLettersShader(mat4 view);
+	// bind shader (attributes: vec4 point, with uv in zw, and vec3 color) and atlas; return previous program
 
 #endif
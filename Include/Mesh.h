@@ -7,7 +7,9 @@
 #include "glad.h"
 #include "Camera.h"
 #include "IO.h"
+#include "Meshlets.h"
 #include "Quaternion.h"
+#include "SDF.h"
 #include "VecMat.h"
 
 using std::string;
@@ -21,6 +23,7 @@ GLuint UseMeshShader(bool lines = false);
 	// lines false is slightly more efficient
 
 const char *GetMeshPixelShaderNoLines();
+	// inputs vPoint, vNormal, vUv, and (flat) vInstanceColor
 
 struct TriInfo {
 	vec4 plane;
@@ -38,13 +41,60 @@ struct QuadInfo {
 	QuadInfo(vec3 p1, vec3 p2, vec3 p3, vec3 p4);
 };
 
+// Bounding Volumes and Culling
+
+struct BoundingVolume {
+	vec3 min, max;		// axis-aligned box
+	vec3 center;		// sphere
+	float radius = 0;
+	BoundingVolume() { };
+	BoundingVolume(vector<vec3> &pts);
+	BoundingVolume(vector<vec3> &pts, vector<int3> &triangles, int startTriangle, int nTriangles);
+		// bound the vertices of a range of triangles (eg, a Group)
+	bool Visible(const Frustum &frustum, const mat4 &toWorld) const;
+		// sphere test, then (if sphere straddles a plane) box test
+};
+
+struct CullStats {
+	int nMeshes = 0, nMeshesCulled = 0;
+	int nGroups = 0, nGroupsCulled = 0;
+};
+
+// Levels of Detail
+
+struct MeshLod {
+	int startTriangle = 0, nTriangles = 0;	// range in element buffer (lod triangles follow mesh triangles)
+	float error = 0;						// simplification error, in object units
+	vector<Group> groups;					// correspond with triangleGroups, startTriangle in element buffer
+};
+
+// Dynamic Buffering
+
+struct DirtyRange {
+	// union of modified elements, [begin, end)
+	int begin = 0, end = 0;
+	void Mark(int start, int count) {
+		if (end <= begin) { begin = start; end = start+count; }
+		else { begin = start < begin? start : begin; end = start+count > end? start+count : end; }
+	}
+	bool Empty() { return end <= begin; }
+	void Clear() { begin = end = 0; }
+};
+
+enum class MeshData { Points, Normals, Uvs, Triangles };
+
 // Mesh Class and Operations
 
 class Mesh {
 public:
 	Mesh() { };
 	Mesh(const char *filename) { Read(string(filename)); }
-	~Mesh() { if (vbo > 0) glDeleteBuffers(1, &vbo); };
+	~Mesh() {
+		if (vbo > 0) glDeleteBuffers(1, &vbo);
+		if (ebo > 0) glDeleteBuffers(1, &ebo);
+		if (vao > 0) glDeleteVertexArrays(1, &vao);
+		if (instanceVbo > 0) glDeleteBuffers(1, &instanceVbo);
+	};
 	string objFilename, texFilename;
 	// vertices and facets
 	vector<vec3>	points;
@@ -66,6 +116,8 @@ public:
 	GLuint			vao = 0;		// vertex array object
 	GLuint			vbo = 0;		// vertex buffer]
 	GLuint			ebo = 0;		// element (triangle) buffer
+	GLuint			instanceVbo = 0;	// per-instance matrices and colors (see DisplayInstanced)
+	int				instanceBufferSize = 0;
 	// texture, color
 	GLuint			textureName = 0;
 	vec3			color = vec3(1, 1, 1);
@@ -73,11 +125,52 @@ public:
 	vector<TriInfo> triInfos;
 	vector<QuadInfo> quadInfos;
 	vector<QuadInfo> bounds;
+	// bounding volumes (set by Buffer), visibility (set by Cull)
+	BoundingVolume	boundingVolume;
+	vector<BoundingVolume> groupVolumes;	// correspond with triangleGroups
+	bool			culled = false;
+	vector<bool>	groupCulled;			// correspond with triangleGroups
+	// levels of detail (set by BuildLods): level 0 is triangles, level i > 0 is lods[i-1]
+	vector<int3>	lodTriangles;			// follow triangles in element buffer
+	vector<MeshLod>	lods;
+	float			lodTolerance = .002f;	// max projected error, as fraction of viewport half-height
+	int				lod = 0;				// level last displayed
+	int				lodLevels = 4;			// as last given BuildLods (Optimize rebuilds with these)
+	float			lodRatio = .5f, lodMaxError = FLT_MAX;
+	// meshlets (set by BuildMeshlets): triangles reordered so each meshlet is a contiguous range
+	vector<Meshlet>	meshlets;
+	MeshletCuller	meshletCuller;			// set its flags to choose frustum, cone, occlusion tests
+	bool			useMeshlets = true;		// if meshlets built, Display culls them on the GPU
+	int				meshletMaxVertices = 64, meshletMaxTriangles = 124;	// as last given BuildMeshlets
+	// signed distance field (set by BakeSDF), in mesh space
+	SDF				sdf;
+	// post-load reordering (see MeshOptimize.h)
+	bool			optimize = false;		// if true, Read calls Optimize before Buffer
+	bool			optimizeOverdraw = false;
+	// dynamic buffering (see SetDynamic)
+	bool			dynamic = false;
+	bool			persistentUpload = false;	// stage uploads through persistently mapped ring
+	float			headroom = 1.5f;			// capacity/size when dynamic buffers (re)allocate
+	int				vertexCapacity = 0;			// vertices allocated in vbo
+	int				triangleCapacity = 0;		// triangles allocated in ebo
+	int				normalsOffset = 0;			// bytes into vbo, 0 if no normals buffered
+	int				uvsOffset = 0;				// bytes into vbo, 0 if no uvs buffered
+	DirtyRange		dirtyPoints, dirtyNormals, dirtyUvs, dirtyTriangles;
 	// operations
 	void Clear();
 	void Buffer();
 	void Buffer(vector<vec3> &pts, vector<vec3> *nrms = NULL, vector<vec2> *uvs = NULL);
 		// if non-null, nrms and uvs assumed same size as pts
+	void BufferTriangles();
+		// load element buffer with triangles and lodTriangles
+	void SetDynamic(bool dynamic = true, bool persistentUpload = false, float headroom = 1.5f);
+		// dynamic buffers are allocated with headroom; after editing points, normals, uvs, or triangles
+		// call MarkDirty; Display (or UpdateBuffer) uploads only the dirty ranges
+		// levels of detail are not kept for dynamic meshes
+	void MarkDirty(MeshData data, int start = 0, int count = -1);
+		// count -1 marks through end of array
+	void UpdateBuffer();
+		// upload dirty ranges, reallocating (with headroom) if arrays outgrew capacity
 	void Set(vector<vec3> &pts, vector<vec3> *nrms = NULL, vector<vec2> *tex = NULL,
 			 vector<int> *tris = NULL, vector<int> *quads = NULL);
 	void SetToWorld();
@@ -86,19 +179,48 @@ public:
 		// as above but first assigning toWorld
 	void SetWrtParent();
 		// for this mesh set wrtParent given parent and toWorld
-	void Display(Camera camera, bool lines = false, bool useGroupColor = false);
+	void SetBoundingVolumes(vector<vec3> &pts);
+	void SetBoundingVolumes() { SetBoundingVolumes(points); }
+		// bound points and each triangle group (called by Buffer)
+	bool Cull(const Frustum &frustum, CullStats *stats = NULL);
+		// set culled and groupCulled, accumulate stats; return true if any part visible
+	void Optimize(bool overdraw = false);
+		// reorder triangles within groups for vertex cache (and, optionally, overdraw),
+		// reorder vertices for fetch locality; print ACMR before and after
+	int BuildLods(int nLevels = 4, float ratio = .5f, float maxError = FLT_MAX);
+		// successively simplify (see Simplify.h) by ratio, keeping seams and group boundaries
+		// levels share the vertex buffer; return number of levels built (excluding level 0)
+	int SelectLod(const Camera &camera);
+		// coarsest level whose error, projected by camera, is below lodTolerance
+	int BuildMeshlets(int maxVertices = 64, int maxTriangles = 124);
+		// reorder triangles (within groups and materials) into meshlets (see Meshlets.h)
+		// return number of meshlets (none for dynamic meshes)
+	bool BakeSDF(int resolution = 64, float padding = .1f);
+		// threaded bake of sdf from points and triangles (see SDF.h); uploaded as a 3D texture if buffered
+		// for inside tests and proximity queries, transform world points by inverse(toWorld)
+	void Display(const Camera &camera, bool lines = false, bool useGroupColor = false);
 		// display with assigned color
-	void Display(Camera camera, vec3 color, bool lines = false);
+	void Display(const Camera &camera, vec3 color, bool lines = false);
 		// display with given color
-	void Display(Camera camera, vec3 color, int textureUnit, bool lines = false);
+	void Display(const Camera &camera, vec3 color, int textureUnit, bool lines = false);
 		// display with given color and texture - used primarily for tinting the texture by the color
-	void Display(Camera camera, int textureUnit, bool lines = false, bool useGroupColor = false);
+	void Display(const Camera &camera, int textureUnit, bool lines = false, bool useGroupColor = false);
+		// nothing drawn if culled; culled groups are skipped; level of detail per SelectLod
+		// at level 0 with meshlets and useMeshlets (and not useGroupColor), meshlets are culled on the GPU
 		// texture is enabled if textureUnit >= 0 and textureName set
 		// before this call, app can optionally change uniforms from their default, including:
 		//     nLights, lights, color, opacity, ambient
 		//     useLight, useTint, fwdFacingOnly, facetedShading
 		//     outlineColor, outlineWidth, transition
 		// see Mesh.cpp pixel shader uniform inputs for complete list
+	void DisplayInstanced(const Camera &camera, const mat4 *instances, int nInstances, const vec3 *colors = NULL,
+						  bool nonUniformScale = false, int textureUnit = -1, bool lines = false);
+	void DisplayInstanced(const Camera &camera, vector<mat4> &instances, vector<vec3> *colors = NULL,
+						  bool nonUniformScale = false, int textureUnit = -1, bool lines = false);
+		// draw nInstances copies with one glDrawElementsInstanced; each instance matrix replaces toWorld
+		// colors, if non-null, override color per instance
+		// nonUniformScale transforms normals by inverse transpose of each instance (in vertex shader)
+		// instance buffer is orphaned each call; no culling or level of detail
 	bool Read(string objFile, mat4 *m = NULL, bool standardize = true, bool buffer = true, bool forceTriangles = false);
 		// read in object file (with normals, uvs), initialize matrix, build vertex buffer
 	bool Read(string objFile, string texFile, mat4 *m = NULL, bool standardize = true, bool buffer = true, bool forceTriangles = false);
@@ -109,6 +231,12 @@ public:
 		// as above but true if 0 <= alpha <= 1
 };
 
+// Culling
+
+CullStats Cull(vector<Mesh *> &meshes, const Frustum &frustum, bool recurse = true);
+	// cull each mesh (and, if recurse, its children) against frustum, typically camera.GetFrustum()
+	// call once per frame before Display; returns number of meshes and groups tested and culled
+
 // Intersections
 
 void BuildTriInfos(vector<vec3> &points, vector<int3> &triangles, vector<TriInfo> &triInfos);
@@ -0,0 +1,104 @@
+// MeshBatch.h - draw many meshes and triangle groups with a single glMultiDrawElementsIndirect
+// requires OpenGL 4.3 (shader storage and indirect draw buffers)
+
+#ifndef MESH_BATCH_HDR
+#define MESH_BATCH_HDR
+
+#include <map>
+#include <vector>
+#include "glad.h"
+#include "Camera.h"
+#include "Mesh.h"
+
+using std::vector;
+
+// Range Allocation
+
+struct Range {
+	int start = 0, count = 0;
+	Range(int s = 0, int n = 0) : start(s), count(n) { }
+};
+
+class RangeAllocator {
+	// first-fit allocation of contiguous ranges; freed ranges coalesce with neighbors
+public:
+	int capacity = 0;
+	vector<Range> free;							// sorted by start
+	int Allocate(int count);					// return start, or -1 if no room
+	void Free(int start, int count);
+	void Grow(int newCapacity);					// append [capacity, newCapacity) as free
+};
+
+// Shared Geometry Buffer
+
+struct MeshAllocation {
+	int firstVertex = 0, nVertices = 0;			// in pool vertices
+	int firstIndex = 0, nIndices = 0;			// in pool indices (triangle ids relative to firstVertex)
+};
+
+class MeshPool {
+	// one vertex buffer (interleaved point, normal, uv) and one element buffer for many meshes
+	// buffers grow (doubling, via glCopyBufferSubData) when an allocation does not fit
+public:
+	GLuint vao = 0, vbo = 0, ebo = 0;
+	RangeAllocator vertices, indices;
+	std::map<Mesh *, MeshAllocation> allocations;
+	bool Add(Mesh *m);							// allocate and upload mesh points, normals, uvs, triangles
+	bool Update(Mesh *m);						// re-upload (reallocate if size changed)
+	void Remove(Mesh *m);
+	MeshAllocation *Find(Mesh *m);
+	void Release();
+	MeshPool(int vertexCapacity = 1 << 16, int indexCapacity = 3 << 16);
+	~MeshPool() { Release(); }
+private:
+	int initialVertices, initialIndices;
+	void Init();
+	void GrowVertices(int minCapacity);
+	void GrowIndices(int minCapacity);
+};
+
+// Per-Frame Batch
+
+struct DrawElementsIndirectCommand {
+	GLuint count, instanceCount, firstIndex;
+	GLint  baseVertex;
+	GLuint baseInstance;						// set to draw index, read by shader as drawID
+};
+
+struct DrawData {
+	mat4 toWorld;								// row-major, as in VecMat.h
+	vec4 color;									// rgb, opacity
+	vec4 material;								// ambient, diffuse, specular, unused
+};
+
+class MeshBatch {
+public:
+	MeshPool pool;
+	struct Entry { Mesh *mesh; vec4 material; };
+	vector<Entry> entries;
+	// last Display statistics
+	int nDraws = 0, nMeshesDrawn = 0;
+	// registration
+	bool Add(Mesh *m, vec4 material = vec4(.1f, .7f, .7f, 0));
+		// material is (ambient, diffuse, specular) as with mesh pixel shader amb, dif, spc
+	bool Update(Mesh *m);						// call after mesh geometry changes
+	void Remove(Mesh *m);
+	// display
+	void Display(const Camera &camera, bool useGroupColor = false, float opacity = 1);
+		// one glMultiDrawElementsIndirect for all registered meshes that are not culled
+		// with useGroupColor, each visible triangle group is a separate command with group color
+		// textures are not supported by the batch (use Mesh::Display)
+		// before this call, app can set shader uniforms nLights, lights (see GetMeshBatchShader)
+	void Release();
+	~MeshBatch() { Release(); }
+private:
+	vector<DrawElementsIndirectCommand> commands;
+	vector<DrawData> drawData;
+	GLuint indirectBuffer = 0, drawBuffer = 0, drawIdBuffer = 0;
+	int drawCapacity = 0;
+	void Reserve(int nDraws);
+};
+
+GLuint GetMeshBatchShader();
+
+#endif
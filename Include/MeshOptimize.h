@@ -0,0 +1,44 @@
+// MeshOptimize.h - reorder triangles and vertices for post-transform cache, overdraw, and vertex fetch
+
+#ifndef MESH_OPTIMIZE_HDR
+#define MESH_OPTIMIZE_HDR
+
+#include <vector>
+#include "IO.h"
+#include "VecMat.h"
+
+using std::vector;
+
+float ACMR(vector<int3> &triangles, int cacheSize = 16);
+	// average cache miss ratio: vertex shader invocations per triangle given a FIFO post-transform cache
+	// 3 is worst; about .6 is typical of a well ordered regular mesh
+
+void OptimizeVertexCache(vector<int3> &triangles, int start, int nTriangles, int cacheSize = 32);
+	// reorder triangles[start] to triangles[start+nTriangles-1] for vertex cache locality
+	// (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+
+void OptimizeOverdraw(vector<vec3> &points, vector<int3> &triangles, int start, int nTriangles,
+					  int cacheSize = 16, int minCluster = 64);
+	// reorder clusters of an already cache-optimized range so outward-facing clusters draw first
+	// clusters break where the cache is cold, so cache efficiency is largely kept
+	// (after Sander, Nehab, Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw")
+
+void OptimizeVertexFetch(vector<int3> &triangles, int nVertices, vector<int> &remap, vector<int4> *quads = NULL);
+	// number vertices in order of first use (unused vertices last), set remap[oldId] = newId
+	// update triangles (and quads) accordingly; per-vertex arrays should then be reordered by Remap
+
+template<class T> void Remap(vector<T> &a, vector<int> &remap) {
+	if (a.size() != remap.size())
+		return;
+	vector<T> copy(a);
+	for (size_t i = 0; i < a.size(); i++)
+		a[remap[i]] = copy[i];
+}
+
+void OptimizeMesh(vector<vec3> &points, vector<vec3> &normals, vector<vec2> &uvs,
+				  vector<int3> &triangles, vector<int4> &quads, vector<Group> &groups, vector<Mtl> &mtls,
+				  bool overdraw = false, float *acmrBefore = NULL, float *acmrAfter = NULL);
+	// reorder triangles within each group and material range (so ranges remain valid), optionally
+	// reduce overdraw, then reorder vertices for fetch locality
+
+#endif
@@ -0,0 +1,115 @@
+// MeshStream.h - out-of-core meshes: spatially chunked files, memory mapped, paged into a GPU pool
+
+#ifndef MESH_STREAM_HDR
+#define MESH_STREAM_HDR
+
+#include <stdint.h>
+#include <vector>
+#include "glad.h"
+#include "Camera.h"
+#include "Mesh.h"
+#include "VecMat.h"
+
+using std::vector;
+
+// Chunked File Format
+// header, then chunks (each page aligned: points, normals, triangles with chunk-local ids), then chunk table
+
+struct ChunkFileHeader {
+	char magic[4] = { 'M', 'C', 'H', 'K' };
+	int version = 1;
+	int nChunks = 0;
+	int maxVertices = 0, maxTriangles = 0;	// largest chunk
+	int unused = 0;
+	uint64_t tableOffset = 0;				// bytes from start of file to ChunkInfo array
+	vec3 min, max;							// bounds of all points
+};
+
+struct ChunkInfo {
+	uint64_t offset = 0;					// bytes from start of file to chunk points
+	int nVertices = 0, nTriangles = 0;
+	vec3 center;							// bounding sphere
+	float radius = 0;
+	vec3 min, max;
+};
+
+bool WriteChunkedMesh(const char *filename, vector<vec3> &points, vector<int3> &triangles,
+					  vector<vec3> *normals = NULL, int maxTrianglesPerChunk = 1 << 16);
+	// partition triangles spatially (median splits of centroids along longest axis) and write chunks
+	// if normals null (or not matching points), area-weighted vertex normals are computed
+
+bool ConvertObjToChunked(const char *objFilename, const char *chunkFilename, int maxTrianglesPerChunk = 1 << 16);
+	// stream an .obj file (points and faces only) into chunked form without holding its triangles:
+	// faces are binned to temporary files by position, then each bin is partitioned and written
+	// points and normals (24 bytes per vertex) must fit in memory
+
+// Memory-Mapped File
+
+class MappedFile {
+public:
+	const char *data = NULL;
+	uint64_t size = 0;
+	bool Open(const char *filename);		// map entire file read-only
+	void Close();
+	void Evict(const void *p, uint64_t nBytes);
+		// hint that the pages holding [p, p+nBytes) are not needed soon (they re-read from file on access)
+	~MappedFile() { Close(); }
+private:
+#ifdef _WIN32
+	void *file = NULL, *mapping = NULL;
+#else
+	int fd = -1;
+#endif
+};
+
+// Chunked Mesh (host side)
+
+class ChunkedMesh {
+public:
+	MappedFile file;
+	ChunkFileHeader header;
+	const ChunkInfo *chunks = NULL;			// header.nChunks entries, in mapped memory
+	bool Open(const char *filename);
+	void Close();
+	const vec3 *Points(int chunk) { return (const vec3 *) (file.data+chunks[chunk].offset); }
+	const vec3 *Normals(int chunk) { return Points(chunk)+chunks[chunk].nVertices; }
+	const int3 *Triangles(int chunk) { return (const int3 *) (Normals(chunk)+chunks[chunk].nVertices); }
+	bool Read(int chunk, Mesh &mesh, bool buffer = true);
+		// copy chunk to mesh points, normals, triangles (eg, to edit or display one chunk with Mesh::Display)
+};
+
+// Streamed Mesh (residency manager)
+
+class StreamedMesh {
+	// GPU pool of fixed-size slots, each holding one chunk (up to header.maxVertices, maxTriangles)
+	// Update ranks chunks (in view first, then by distance from camera) and pages the highest-ranked
+	// into slots, evicting the least recently used slots whose chunks are no longer wanted
+public:
+	ChunkedMesh source;
+	mat4 toWorld;
+	vec3 color = vec3(1, 1, 1);
+	uint64_t gpuBudget = 256 << 20;			// bytes for vertex and element pools
+	int maxUploadsPerFrame = 8;				// limit per-frame stalls from page faults and uploads
+	bool persistentUpload = false;			// stage uploads via persistently mapped ring (see UploadBuffer)
+	bool evictHostPages = true;				// after upload, hint that the chunk's mapped pages may be dropped
+	// statistics from last Update
+	int nSlots = 0, nResident = 0, nVisible = 0, nDrawn = 0, nUploads = 0, nEvictions = 0;
+	bool Open(const char *filename, bool standardize = true, uint64_t gpuBudget = 256 << 20);
+		// map file and allocate pool; if standardize, toWorld maps bounds into +/-1
+	void Update(const Camera &camera);
+	void Display(const Camera &camera, bool lines = false);
+		// Update, then draw resident chunks in view with the mesh shader (see Mesh::Display for uniforms)
+	void Release();
+	~StreamedMesh() { Release(); }
+private:
+	struct Slot { int chunk = -1, lastUsed = -1; };
+	vector<Slot> slots;
+	vector<int> chunkSlots, order;			// slot of each chunk (-1 if not resident), chunks by rank
+	vector<char> chunkVisible;
+	vector<float> chunkDistances;
+	GLuint vao = 0, vbo = 0, ebo = 0;
+	int frame = 0;
+	void Load(int chunk, int slot);
+};
+
+#endif
@@ -0,0 +1,78 @@
+// Meshlets.h - partition triangles into small clusters, cull clusters on the GPU
+// GPU culling requires OpenGL 4.3 (compute shaders, shader storage, indirect draw buffers)
+
+#ifndef MESHLETS_HDR
+#define MESHLETS_HDR
+
+#include <vector>
+#include "glad.h"
+#include "Camera.h"
+#include "IO.h"
+#include "VecMat.h"
+
+using std::vector;
+
+// Meshlet Building
+
+struct Meshlet {
+	// layout matches std430 struct in culling shader
+	vec3 center;						// bounding sphere
+	float radius = 0;
+	vec3 coneAxis;						// unit average of triangle normals
+	float coneCutoff = 1;				// sine of cone half-angle; 1 if cone too wide to cull
+	int startTriangle = 0, nTriangles = 0;
+	int nVertices = 0, unused = 0;
+};
+
+int BuildMeshlets(vector<vec3> &points, vector<int3> &triangles, int start, int nTriangles,
+				  vector<Meshlet> &meshlets, int maxVertices = 64, int maxTriangles = 124);
+	// reorder triangles[start] to triangles[start+nTriangles-1] so each meshlet is a contiguous run
+	// of at most maxTriangles triangles that reference at most maxVertices vertices
+	// triangles are added across shared vertices, preferring fewest new vertices, then nearest
+	// append meshlets (with bounds), return number appended
+
+int BuildMeshlets(vector<vec3> &points, vector<int3> &triangles, vector<Group> &groups, vector<Mtl> &mtls,
+				  vector<Meshlet> &meshlets, int maxVertices = 64, int maxTriangles = 124);
+	// as above, separately within each group and material range (so ranges remain valid)
+
+void SetMeshletBounds(vector<vec3> &points, vector<int3> &triangles, Meshlet &m);
+	// bounding sphere of meshlet vertices and normal cone of its triangles
+
+inline bool MeshletBackfacing(const Meshlet &m, vec3 eye) {
+	// true if every triangle faces away from eye (eye in mesh space)
+	vec3 d = m.center-eye;
+	return dot(d, m.coneAxis) >= m.coneCutoff*length(d)+m.radius;
+}
+
+// GPU Culling
+
+class MeshletCuller {
+	// compute pass tests each meshlet, appends a draw command for each visible meshlet
+	// (counted by an atomic counter), then one indirect multi-draw renders them
+public:
+	bool frustumCull = true, coneCull = true;
+	bool occlusionCull = false;			// test against hierarchical depth of a prior frame (see UpdateHiZ)
+	int nMeshlets = 0;
+	bool Upload(vector<Meshlet> &meshlets);
+	void Cull(const Camera &camera, const mat4 &toWorld);
+		// call before the draw shader is in use (this dispatches a compute shader)
+	void Draw();
+		// draw visible meshlets with the current shader and vertex array, whose element buffer
+		// holds the triangles ordered by BuildMeshlets
+	int VisibleCount();
+		// meshlets passing the last Cull; reads back the counter, so stalls
+	void Release();
+	~MeshletCuller() { Release(); }
+private:
+	GLuint meshletBuffer = 0, commandBuffer = 0, counterBuffer = 0;
+};
+
+// Hierarchical Depth
+
+void UpdateHiZ(const Camera &camera);
+	// copy the current depth buffer into a max-depth mip pyramid used by later occlusionCull passes
+	// call once the frame's occluders are drawn; camera must be the one they were drawn with
+	// occlusion is tested against that frame, so with fast motion a meshlet may appear a frame late
+void ReleaseHiZ();
+
+#endif
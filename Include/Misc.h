@@ -4,6 +4,8 @@
 #define MISC_HDR
 
 #include <string.h>
+#include <thread>
+#include <vector>
 #include "VecMat.h"
 
 // Matrix Misc
@@ -18,6 +20,28 @@ std::string GetDirectory();
 time_t FileModified(const char *name);
 bool FileExists(const char *name);
 
+// Threads
+
+template<class F> void ParallelFor(int n, F f, int minPerThread = 1024) {
+	// call f(i) for 0 <= i < n, split into contiguous ranges across hardware threads
+	// f must be safe to call concurrently for different i
+	int nHardware = (int) std::thread::hardware_concurrency(), nThreads = n/minPerThread;
+	if (nThreads > nHardware) nThreads = nHardware;
+	if (nThreads < 2) {
+		for (int i = 0; i < n; i++)
+			f(i);
+		return;
+	}
+	std::vector<std::thread> threads;
+	for (int t = 0; t < nThreads; t++)
+		threads.push_back(std::thread([&f, t, n, nThreads]() {
+			for (int i = t*n/nThreads, end = (t+1)*n/nThreads; i < end; i++)
+				f(i);
+		}));
+	for (size_t t = 0; t < threads.size(); t++)
+		threads[t].join();
+}
+
 // Intersections
 
 float RaySphere(vec3 base, vec3 v, vec3 center, float radius);
@@ -0,0 +1,44 @@
+// Normals.h - multi-threaded vertex normals, crease splitting, and tangents
+
+#ifndef NORMALS_HDR
+#define NORMALS_HDR
+
+#include <vector>
+#include "VecMat.h"
+
+using std::vector;
+
+enum class NormalWeight { Equal, Area, Angle };
+	// contribution of each triangle to its vertex normals: unit face normal, by triangle area,
+	// or by angle of triangle at vertex (least sensitive to tessellation)
+
+struct VertexAdjacency {
+	// triangle corners (3*triangle+k) of vertex v: corners[offsets[v]] to corners[offsets[v+1]-1]
+	vector<int> offsets, corners;
+	void Build(vector<int3> &triangles, int nVertices);
+	bool Valid(vector<int3> &triangles, int nVertices) {
+		return (int) offsets.size() == nVertices+1 && corners.size() == 3*triangles.size();
+	}
+};
+
+void ComputeVertexNormals(vector<vec3> &points, vector<int3> &triangles, vector<vec3> &normals,
+						  NormalWeight weight = NormalWeight::Area, VertexAdjacency *adjacency = NULL);
+	// threads compute weighted face normals, then gather them per vertex (no atomics or locks)
+	// for deforming meshes, pass the same adjacency each call: it is built only when invalid
+
+int SplitCreases(vector<vec3> &points, vector<int3> &triangles, vector<vec3> &normals, float creaseAngle = 60,
+				 NormalWeight weight = NormalWeight::Angle, vector<vec2> *uvs = NULL, vector<int> *sourceVertices = NULL);
+	// where adjacent triangles meet at more than creaseAngle (in degrees), duplicate the shared vertices
+	// so each smooth fan has its own normal; points (and uvs) are extended, triangles updated
+	// sourceVertices, if non-null, set to original vertex of each vertex
+	// return number of vertices added
+
+void NormalizeVectors(vec3 *v, int n);
+	// normalize in place, with SSE (4 vectors at a time) if available; zero vectors remain zero
+
+void ComputeTangents(vector<vec3> &points, vector<vec3> &normals, vector<vec2> &uvs, vector<int3> &triangles,
+					 vector<vec4> &tangents, VertexAdjacency *adjacency = NULL);
+	// per-vertex tangent (xyz) orthogonal to normal, w is handedness (+/-1) of bitangent = w*cross(normal, tangent)
+	// for normal mapping; normals and uvs must correspond with points
+
+#endif
@@ -0,0 +1,47 @@
+// SDF.h - signed distance fields baked from triangle meshes
+
+#ifndef SDF_HDR
+#define SDF_HDR
+
+#include <vector>
+#include "glad.h"
+#include "VecMat.h"
+
+using std::vector;
+
+// Distance Grid
+
+class SDF {
+	// signed distance (negative inside) sampled at the corners of a regular grid, in mesh space
+public:
+	int3 res;								// samples along x, y, z
+	vec3 min, max;							// grid corners (mesh bounds plus padding)
+	vec3 cellSize;							// (max-min)/(res-1)
+	vector<float> values;					// x varies fastest
+	GLuint texture = 0;						// GL_R32F 3D texture, if uploaded
+	bool Empty() const { return values.empty(); }
+	float Value(int i, int j, int k) const { return values[i+res.i1*(j+res.i2*k)]; }
+	float Sample(vec3 p) const;
+		// trilinear; beyond the grid, the value at the nearest grid point plus the distance to it
+	vec3 Gradient(vec3 p) const;
+		// central differences of Sample; for unit steps, normalize (approximates surface normal)
+	bool Inside(vec3 p) const { return Sample(p) < 0; }
+	vec3 Project(vec3 p, int iterations = 2) const;
+		// move p toward the surface along the gradient
+	GLuint Upload();
+		// create (or refill) texture; linear filtered, clamped to edge
+	mat4 TextureTransform() const;
+		// mesh space to texture coordinates (grid samples lie at texel centers)
+		// in a shader: texture(sdf, (textureTransform*vec4(p, 1)).xyz).r
+	void Release();
+	~SDF() { Release(); }
+};
+
+bool BakeSDF(vector<vec3> &points, vector<int3> &triangles, SDF &sdf, int resolution = 64, float padding = .1f);
+	// resolution samples along the longest side of the padded bounds, proportionally fewer along others
+	// padding is a fraction of the longest side of the mesh bounds
+	// distances are to the nearest triangle (bounding volume hierarchy); sign is from the generalized
+	// winding number (hierarchical dipole approximation), so open or self-intersecting meshes are tolerated
+	// grid rows are threaded (see ParallelFor); return false if no triangles
+
+#endif
@@ -0,0 +1,26 @@
+// Simplify.h - quadric error edge-collapse simplification, for mesh levels of detail
+
+#ifndef SIMPLIFY_HDR
+#define SIMPLIFY_HDR
+
+#include <float.h>
+#include <vector>
+#include "IO.h"
+#include "VecMat.h"
+
+using std::vector;
+
+int Simplify(vector<vec3> &points, vector<int3> &triangles, vector<int3> &result, int targetTriangles,
+			 float maxError = FLT_MAX, vector<Group> *groups = NULL, vector<Group> *resultGroups = NULL,
+			 float *resultError = NULL);
+	// collapse edges in order of least quadric error until result has no more than targetTriangles
+	// or no remaining collapse has error below maxError (a distance, in units of points)
+	// each edge collapses onto an existing endpoint: points are never moved or added,
+	// so result indexes the same vertices (and vertex buffer) as triangles
+	// locked vertices (never removed): mesh border, uv/normal seams (position shared by
+	// another vertex), group boundaries (vertex used by more than one group)
+	// if groups non-null, triangles are presumed ordered by group and resultGroups is set for result
+	// resultError, if non-null, set to largest error of any collapse
+	// return number of triangles in result
+
+#endif
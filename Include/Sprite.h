@@ -6,6 +6,7 @@
 #include <glad.h>
 #include <time.h>
 #include <vector>
+#include "DepthQuery.h"
 #include "VecMat.h"
 
 using namespace std;
@@ -74,7 +75,10 @@ public:
 	void Down(double x, double y);					// x,y in pixels
 	vec2 Drag(double x, double y);					// move; x,y in pixels
 	void Wheel(double spin, bool scale = true);		// scale or rotate
-	bool Hit(double x, double y);					// test z-buf (if avail) or bounding-box; x,y in pixels
+	bool Hit(double x, double y, DepthQueries *depths = NULL);
+		// test z-buf (if avail) or bounding-box; x,y in pixels
+		// if depths non-null and its last whole-viewport capture covers (x,y), use that rather than
+		// reading the depth buffer (which stalls)
 	// display
 	void Display(mat4 *view = 0, int texUnit = 0);	// if view NULL, space presumed NDC (+/-1)
 	void Outline(vec3 color, float width = 2);		// draw bounding-box
@@ -4,35 +4,37 @@
 #ifndef TEXT_HDR
 #define TEXT_HDR
 
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include "glad.h"
 #include "GLFW/glfw3.h"
 #include "GLXtras.h"
+#include "Letters.h"
 
 class Character {
 public:
-	GLuint  textureID;  // glyph texture
-	int2    gSize;      // glyph size
-	int2    bearing;    // offset from baseline to left/top of glyph
+	vec2    uv0, uv1;   // glyph rectangle in atlas page, top-left and bottom-right
+	int     page;       // atlas page (texture array layer), -1 if no image (eg, space)
+	vec2    size;       // glyph rectangle size, in pixels at the font's pixelRes (includes distance margin)
+	vec2    bearing;    // offset from baseline to left/top of glyph rectangle
 	GLuint  advance;    // offset to next glyph
-	Character() { textureID = advance = 0; }
-	Character(int textureID, int2 gSize, int2 bearing, GLuint advance) :
-		textureID(textureID), gSize(gSize), bearing(bearing), advance(advance) { }
+	Character() { page = -1; advance = 0; }
 };
 
+typedef std::unordered_map<int, Character> CharacterMap;
+
 // character set and current pointer
 struct CharacterSet {
-	int charRes;
-	Character characters[128];
-	CharacterSet() { charRes = 0; }
-	CharacterSet(const CharacterSet &cs) {
-		charRes = 0;
-		for (int i = 0; i < 128; i++)
-			characters[i] = cs.characters[i];
-	}
+	int charRes = 0, pixelRes = 0;
+	void *face = NULL;         // FreeType face, kept open to rasterize glyphs on demand
+	CharacterMap characters;   // by Unicode code point, as rasterized (and not since evicted)
 };
 
 CharacterSet *SetFont(const char *fontName, int charRes = 15, int pixelRes = 15, bool forceInit = false);
-	// sets, returns current font
+	// sets, returns current font; glyphs are signed distance fields, sharp at any scale, so a font
+	// is loaded once, whatever the size (text scale of charRes draws glyphs at pixelRes pixels per em)
+	// text is UTF-8; glyphs are rasterized on first use
 
 void Text(int x, int y, vec3 color, float scale, const char *format, ...);
 	// position null-terminated text at pixel (x, y)
@@ -52,6 +54,74 @@ int TextWidth(int scale, const char *format, ...);
 void RenderText(const char *text, float x, float y, vec3 color, float scale, mat4 view, bool vertical = false);
 	// text with arbitrary orientation
 
+// effects
+// FreeType text only, drawn in the same pass as the glyphs; a change flushes pending text
+
+void TextOutline(float width, vec3 color = vec3(0, 0, 0));
+	// width is a fraction (0: none, 1: max) of the distance-field margin, about 1/8 em
+void TextShadow(vec2 offset, float opacity = .5f, vec3 color = vec3(0, 0, 0));
+	// offset in screen directions as a fraction (+/-1) of the margin; opacity 0 for none
+
+// glyph cache
+// glyphs of all FreeType fonts share 1024x1024 single-byte pages, added as needed up to a cap; when
+// full, the least recently used page is recycled (its glyphs are rasterized again if used again)
+
+void SetGlyphCacheSize(int maxBytes);
+	// cap, default 16 MB (at least one page)
+int GlyphCacheSize();
+	// bytes of texture allocated
+void ClearGlyphCache();
+
+// batching
+// each string is laid out as one vertex array and drawn with one call; between BeginText and EndText,
+// strings (of any color) accumulate and are drawn together, unless the font or view changes
+
+void BeginText();
+	// calls nest
+void EndText();
+	// draw accumulated text when the outermost Begin is ended
+void FlushText();
+	// draw accumulated text now
+
+// retained text
+
+class TextBlock {
+	// for text drawn every frame (eg, a HUD): glyph quads stay in a vertex buffer, so Draw is one call
+	// with no layout; Print/SetText compare the new string to the old, lay out from the first changed
+	// character only, and upload only the vertices that differ (typically those of a changed digit)
+public:
+	TextBlock(float x = 0, float y = 0, vec3 color = vec3(0, 0, 0), float scale = 12);
+	bool Print(const char *format, ...);
+		// format, then as SetText
+	bool SetText(const char *text);
+		// re-layout if text differs from current; return true if changed
+	void SetPosition(float x, float y);
+	void SetColor(vec3 color);
+	void SetScale(float scale);
+		// if changed, all text is laid out again
+	const char *GetText() { return text.c_str(); }
+	float Width() { return pens.empty()? 0 : pens.back()-x; }
+	void Draw();
+		// at pixel (x, y) of the screen
+	void Draw(mat4 view);
+	void Release();
+	~TextBlock() { Release(); }
+private:
+	float x, y, scale;
+	vec3 color;
+	CharacterSet *font = NULL;					// current when laid out (FreeType only)
+	int generation = 0;							// of glyph cache when laid out
+	std::string text;
+	std::vector<GlyphVertex> vertices, previous;
+	std::vector<int> starts;					// first vertex of each character, and end
+	std::vector<float> pens;					// pen position at each character, and end
+	bool relayout = true;						// position, color, scale, or font changed
+	int dirtyBegin = 0, dirtyEnd = 0;			// range of vertices to upload
+	GLuint vArray = 0, vBuffer = 0;
+	int capacity = 0;							// vertices allocated in vBuffer
+	void Layout(const char *s);
+};
+
 const char *Nice(float f);
 	// minimal display of f
 
@@ -7,9 +7,7 @@
 namespace {
 
 int VpHeight() {  // viewport height
-	vec4 vp;
-	glGetFloatv(GL_VIEWPORT, (float *) &vp);
-	return (int) vp[3];
+	return VPh();
 }
 
 vec3 EulerFromMatrix(mat4 R) {
@@ -38,6 +36,47 @@ const char *usage = R"(
 )";
 }
 
+// Frustum
+
+Frustum::Frustum(const mat4 &m) {
+	// Gribb/Hartmann: clip-space inequalities -w <= x,y,z <= w expressed with rows of m
+	for (int i = 0; i < 3; i++) {
+		planes[2*i] = m[3]+m[i];
+		planes[2*i+1] = m[3]-m[i];
+	}
+	for (int i = 0; i < 6; i++) {
+		vec4 &p = planes[i];
+		float len = length(vec3(p.x, p.y, p.z));
+		if (len > FLT_MIN)
+			p /= len;
+	}
+}
+
+bool Frustum::SphereVisible(vec3 c, float r) const {
+	for (int i = 0; i < 6; i++) {
+		const vec4 &p = planes[i];
+		if (p.x*c.x+p.y*c.y+p.z*c.z+p.w < -r)
+			return false;
+	}
+	return true;
+}
+
+bool Frustum::BoxVisible(vec3 min, vec3 max, const mat4 &toWorld) const {
+	// transform each plane to box space (plane*toWorld), test box corner farthest along plane normal
+	for (int i = 0; i < 6; i++) {
+		const vec4 &w = planes[i];
+		vec4 p;
+		for (int k = 0; k < 4; k++)
+			p[k] = w.x*toWorld[0][k]+w.y*toWorld[1][k]+w.z*toWorld[2][k]+w.w*toWorld[3][k];
+		vec3 far(p.x > 0? max.x : min.x, p.y > 0? max.y : min.y, p.z > 0? max.z : min.z);
+		if (p.x*far.x+p.y*far.y+p.z*far.z+p.w < 0)
+			return false;
+	}
+	return true;
+}
+
+Frustum Camera::GetFrustum() { return Frustum(fullview); }
+
 void Camera::Save(const char *filename) {
 	FILE *out = fopen(filename, "wb");
 	fwrite(&rot, sizeof(mat4), 1, out);
@@ -0,0 +1,563 @@
+// Collide.cpp - oriented bounding box trees for mesh-mesh overlap, contact, and distance queries
+
+#include <algorithm>
+#include "Collide.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#define COLLIDE_SSE
+	#include <xmmintrin.h>
+#endif
+
+namespace {
+
+const float epsilon = 1e-6f;
+
+vec3 TransformPoint(const mat4 &m, vec3 p) {
+	return vec3(m[0][0]*p.x+m[0][1]*p.y+m[0][2]*p.z+m[0][3],
+				m[1][0]*p.x+m[1][1]*p.y+m[1][2]*p.z+m[1][3],
+				m[2][0]*p.x+m[2][1]*p.y+m[2][2]*p.z+m[2][3]);
+}
+
+vec3 TransformVector(const mat4 &m, vec3 v) {
+	return vec3(m[0][0]*v.x+m[0][1]*v.y+m[0][2]*v.z,
+				m[1][0]*v.x+m[1][1]*v.y+m[1][2]*v.z,
+				m[2][0]*v.x+m[2][1]*v.y+m[2][2]*v.z);
+}
+
+// Box Fitting
+
+void Eigenvectors(float a[3][3], vec3 axes[3]) {
+	// cyclic Jacobi rotations of symmetric a; columns of v converge to eigenvectors
+	float v[3][3] = { {1, 0, 0}, {0, 1, 0}, {0, 0, 1} };
+	for (int sweep = 0; sweep < 32; sweep++) {
+		if (a[0][1]*a[0][1]+a[0][2]*a[0][2]+a[1][2]*a[1][2] < 1e-20f)
+			break;
+		for (int p = 0; p < 2; p++)
+			for (int q = p+1; q < 3; q++) {
+				if (fabs(a[p][q]) < 1e-30f)
+					continue;
+				float theta = (a[q][q]-a[p][p])/(2*a[p][q]);
+				float t = (theta >= 0? 1 : -1)/(fabs(theta)+sqrt(theta*theta+1));
+				float c = 1/sqrt(t*t+1), s = t*c;
+				for (int k = 0; k < 3; k++) {
+					float akp = a[k][p], akq = a[k][q];
+					a[k][p] = c*akp-s*akq;
+					a[k][q] = s*akp+c*akq;
+				}
+				for (int k = 0; k < 3; k++) {
+					float apk = a[p][k], aqk = a[q][k];
+					a[p][k] = c*apk-s*aqk;
+					a[q][k] = s*apk+c*aqk;
+				}
+				for (int k = 0; k < 3; k++) {
+					float vkp = v[k][p], vkq = v[k][q];
+					v[k][p] = c*vkp-s*vkq;
+					v[k][q] = s*vkp+c*vkq;
+				}
+			}
+	}
+	for (int i = 0; i < 3; i++)
+		axes[i] = vec3(v[0][i], v[1][i], v[2][i]);
+}
+
+void FitBox(OBB &box, vector<vec3> &points, vector<int3> &triangles, int *ids, int n) {
+	// principal axes of triangle vertices, extents by projection
+	vec3 mean;
+	for (int i = 0; i < n; i++)
+		for (int k = 0; k < 3; k++)
+			mean += points[triangles[ids[i]][k]];
+	mean /= (float) (3*n);
+	float cov[3][3] = { {0, 0, 0}, {0, 0, 0}, {0, 0, 0} };
+	for (int i = 0; i < n; i++)
+		for (int k = 0; k < 3; k++) {
+			vec3 d = points[triangles[ids[i]][k]]-mean;
+			for (int r = 0; r < 3; r++)
+				for (int c = 0; c < 3; c++)
+					cov[r][c] += d[r]*d[c];
+		}
+	Eigenvectors(cov, box.axes);
+	vec3 min(FLT_MAX), max(-FLT_MAX);
+	for (int i = 0; i < n; i++)
+		for (int k = 0; k < 3; k++) {
+			vec3 d = points[triangles[ids[i]][k]]-mean;
+			for (int a = 0; a < 3; a++) {
+				float x = dot(d, box.axes[a]);
+				min[a] = std::min(min[a], x);
+				max[a] = std::max(max[a], x);
+			}
+		}
+	box.center = mean;
+	for (int a = 0; a < 3; a++) {
+		box.center += (.5f*(min[a]+max[a]))*box.axes[a];
+		box.halfSize[a] = .5f*(max[a]-min[a]);
+	}
+}
+
+OBB TransformBox(const OBB &b, const mat4 &m) {
+	// box enclosing the (possibly sheared) image of b under m
+	vec3 edges[3];
+	for (int i = 0; i < 3; i++)
+		edges[i] = TransformVector(m, b.halfSize[i]*b.axes[i]);
+	OBB r;
+	r.center = TransformPoint(m, b.center);
+	r.axes[0] = normalize(TransformVector(m, b.axes[0]));
+	vec3 a1 = TransformVector(m, b.axes[1]);
+	r.axes[1] = normalize(a1-dot(a1, r.axes[0])*r.axes[0]);
+	r.axes[2] = cross(r.axes[0], r.axes[1]);
+	for (int i = 0; i < 3; i++)
+		r.halfSize[i] = fabs(dot(edges[0], r.axes[i]))+fabs(dot(edges[1], r.axes[i]))+fabs(dot(edges[2], r.axes[i]));
+	return r;
+}
+
+float BoxSize(const OBB &b) { return b.halfSize.x+b.halfSize.y+b.halfSize.z; }
+
+} // end namespace
+
+float Separation(const OBB &a, const OBB &b) {
+	// after Gottschalk, Lin, Manocha, "OBBTree: A Hierarchical Structure for Rapid Interference Detection"
+	float R[3][3], absR[3][3], t[3];
+	const vec3 &ha = a.halfSize, &hb = b.halfSize;
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++) {
+			R[i][j] = dot(a.axes[i], b.axes[j]);
+			absR[i][j] = fabs(R[i][j])+epsilon;
+		}
+	vec3 d = b.center-a.center;
+	for (int i = 0; i < 3; i++)
+		t[i] = dot(d, a.axes[i]);
+	float gap = -FLT_MAX;
+	for (int i = 0; i < 3; i++)
+		gap = std::max(gap, fabs(t[i])-ha[i]-(hb[0]*absR[i][0]+hb[1]*absR[i][1]+hb[2]*absR[i][2]));
+	for (int j = 0; j < 3; j++) {
+		float tj = t[0]*R[0][j]+t[1]*R[1][j]+t[2]*R[2][j];
+		gap = std::max(gap, fabs(tj)-hb[j]-(ha[0]*absR[0][j]+ha[1]*absR[1][j]+ha[2]*absR[2][j]));
+	}
+	for (int i = 0; i < 3; i++) {
+		int i1 = (i+1)%3, i2 = (i+2)%3;
+		for (int j = 0; j < 3; j++) {
+			int j1 = (j+1)%3, j2 = (j+2)%3;
+			float len = sqrt(std::max(0.f, 1-R[i][j]*R[i][j]));
+			if (len < epsilon)
+				continue;						// parallel axes: cross product is degenerate
+			float ra = ha[i1]*absR[i2][j]+ha[i2]*absR[i1][j];
+			float rb = hb[j1]*absR[i][j2]+hb[j2]*absR[i][j1];
+			float tl = t[i2]*R[i1][j]-t[i1]*R[i2][j];
+			gap = std::max(gap, (fabs(tl)-ra-rb)/len);
+		}
+	}
+	return gap;
+}
+
+// Tree
+
+namespace {
+
+void BuildNode(OBBTree &tree, vector<vec3> &points, vector<int3> &triangles, vector<vec3> &centroids,
+			   int node, int start, int count, int leafSize) {
+	int *ids = tree.ids.data()+start;
+	FitBox(tree.nodes[node].box, points, triangles, ids, count);
+	tree.nodes[node].start = start;
+	tree.nodes[node].count = count;
+	if (count <= leafSize)
+		return;
+	// split along longest axis at box center, else at median
+	OBB &box = tree.nodes[node].box;
+	int a = box.halfSize[0] > box.halfSize[1]? (box.halfSize[0] > box.halfSize[2]? 0 : 2) : (box.halfSize[1] > box.halfSize[2]? 1 : 2);
+	vec3 axis = box.axes[a];
+	float split = dot(box.center, axis);
+	int half = (int) (std::partition(ids, ids+count, [&](int t) { return dot(centroids[t], axis) < split; })-ids);
+	if (half == 0 || half == count) {
+		half = count/2;
+		std::nth_element(ids, ids+half, ids+count, [&](int t1, int t2) { return dot(centroids[t1], axis) < dot(centroids[t2], axis); });
+	}
+	int children = tree.nodes.size();
+	tree.nodes[node].children = children;
+	tree.nodes.resize(children+2);
+	BuildNode(tree, points, triangles, centroids, children, start, half, leafSize);
+	BuildNode(tree, points, triangles, centroids, children+1, start+half, count-half, leafSize);
+}
+
+} // end namespace
+
+void OBBTree::Build(vector<vec3> &points, vector<int3> &triangles, int leafSize) {
+	int n = triangles.size();
+	nodes.resize(0);
+	ids.resize(n);
+	corners.resize(3*n);
+	if (!n)
+		return;
+	vector<vec3> centroids(n);
+	for (int t = 0; t < n; t++) {
+		ids[t] = t;
+		centroids[t] = (points[triangles[t].i1]+points[triangles[t].i2]+points[triangles[t].i3])/3;
+	}
+	nodes.reserve(2*n/std::max(1, leafSize)+1);
+	nodes.resize(1);
+	BuildNode(*this, points, triangles, centroids, 0, 0, n, std::max(1, leafSize));
+	for (int i = 0; i < n; i++)
+		for (int k = 0; k < 3; k++)
+			corners[3*i+k] = points[triangles[ids[i]][k]];
+}
+
+// Triangle Tests
+
+namespace {
+
+void Isect(float vv0, float vv1, float vv2, float d0, float d1, float d2, float &i0, float &i1) {
+	i0 = vv0+(vv1-vv0)*d0/(d0-d1);
+	i1 = vv0+(vv2-vv0)*d0/(d0-d2);
+}
+
+bool Intervals(float vv0, float vv1, float vv2, float d0, float d1, float d2, float &i0, float &i1) {
+	// interval of triangle on the line of plane intersection; false if coplanar
+	if (d0*d1 > 0) Isect(vv2, vv0, vv1, d2, d0, d1, i0, i1);
+	else if (d0*d2 > 0) Isect(vv1, vv0, vv2, d1, d0, d2, i0, i1);
+	else if (d1*d2 > 0 || d0 != 0) Isect(vv0, vv1, vv2, d0, d1, d2, i0, i1);
+	else if (d1 != 0) Isect(vv1, vv0, vv2, d1, d0, d2, i0, i1);
+	else if (d2 != 0) Isect(vv2, vv0, vv1, d2, d0, d1, i0, i1);
+	else return false;
+	if (i0 > i1) std::swap(i0, i1);
+	return true;
+}
+
+bool EdgesCross(vec2 a0, vec2 a1, vec2 b0, vec2 b1) {
+	auto Orient = [](vec2 p, vec2 q, vec2 r) { return (q.x-p.x)*(r.y-p.y)-(q.y-p.y)*(r.x-p.x); };
+	float o1 = Orient(a0, a1, b0), o2 = Orient(a0, a1, b1), o3 = Orient(b0, b1, a0), o4 = Orient(b0, b1, a1);
+	return o1*o2 <= 0 && o3*o4 <= 0 &&
+		   std::max(a0.x, a1.x) >= std::min(b0.x, b1.x) && std::max(b0.x, b1.x) >= std::min(a0.x, a1.x) &&
+		   std::max(a0.y, a1.y) >= std::min(b0.y, b1.y) && std::max(b0.y, b1.y) >= std::min(a0.y, a1.y);
+}
+
+bool InTriangle(vec2 p, vec2 a, vec2 b, vec2 c) {
+	float d1 = (b.x-a.x)*(p.y-a.y)-(b.y-a.y)*(p.x-a.x);
+	float d2 = (c.x-b.x)*(p.y-b.y)-(c.y-b.y)*(p.x-b.x);
+	float d3 = (a.x-c.x)*(p.y-c.y)-(a.y-c.y)*(p.x-c.x);
+	return (d1 >= 0 && d2 >= 0 && d3 >= 0) || (d1 <= 0 && d2 <= 0 && d3 <= 0);
+}
+
+bool CoplanarIntersect(vec3 n, vec3 v[3], vec3 u[3]) {
+	// project to plane most nearly perpendicular to n, then test edges and containment
+	int drop = fabs(n.x) > fabs(n.y)? (fabs(n.x) > fabs(n.z)? 0 : 2) : (fabs(n.y) > fabs(n.z)? 1 : 2);
+	int i0 = drop == 0? 1 : 0, i1 = drop == 2? 1 : 2;
+	vec2 a[3], b[3];
+	for (int k = 0; k < 3; k++) {
+		a[k] = vec2(v[k][i0], v[k][i1]);
+		b[k] = vec2(u[k][i0], u[k][i1]);
+	}
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			if (EdgesCross(a[i], a[(i+1)%3], b[j], b[(j+1)%3]))
+				return true;
+	return InTriangle(a[0], b[0], b[1], b[2]) || InTriangle(b[0], a[0], a[1], a[2]);
+}
+
+} // end namespace
+
+bool TrianglesIntersect(vec3 v0, vec3 v1, vec3 v2, vec3 u0, vec3 u1, vec3 u2) {
+	// planes are unit length so epsilon is a distance; degenerate triangles do not intersect
+	vec3 n1 = cross(v1-v0, v2-v0), n2 = cross(u1-u0, u2-u0);
+	float l1 = length(n1), l2 = length(n2);
+	if (l1 == 0 || l2 == 0)
+		return false;
+	n1 /= l1;
+	n2 /= l2;
+	// reject if u entirely on one side of plane of v
+	float d1 = -dot(n1, v0);
+	float du0 = dot(n1, u0)+d1, du1 = dot(n1, u1)+d1, du2 = dot(n1, u2)+d1;
+	if (fabs(du0) < epsilon) du0 = 0;
+	if (fabs(du1) < epsilon) du1 = 0;
+	if (fabs(du2) < epsilon) du2 = 0;
+	if (du0*du1 > 0 && du0*du2 > 0)
+		return false;
+	// reject if v entirely on one side of plane of u
+	float d2 = -dot(n2, u0);
+	float dv0 = dot(n2, v0)+d2, dv1 = dot(n2, v1)+d2, dv2 = dot(n2, v2)+d2;
+	if (fabs(dv0) < epsilon) dv0 = 0;
+	if (fabs(dv1) < epsilon) dv1 = 0;
+	if (fabs(dv2) < epsilon) dv2 = 0;
+	if (dv0*dv1 > 0 && dv0*dv2 > 0)
+		return false;
+	// compare intervals along line of plane intersection (projected to its largest axis)
+	vec3 dir = cross(n1, n2);
+	int axis = fabs(dir.x) > fabs(dir.y)? (fabs(dir.x) > fabs(dir.z)? 0 : 2) : (fabs(dir.y) > fabs(dir.z)? 1 : 2);
+	float a0, a1, b0, b1;
+	if (!Intervals(v0[axis], v1[axis], v2[axis], dv0, dv1, dv2, a0, a1) ||
+		!Intervals(u0[axis], u1[axis], u2[axis], du0, du1, du2, b0, b1)) {
+		vec3 v[] = { v0, v1, v2 }, u[] = { u0, u1, u2 };
+		return CoplanarIntersect(n1, v, u);
+	}
+	return !(a1 < b0 || b1 < a0);
+}
+
+// Distance
+
+vec3 ClosestOnTriangle(vec3 p, vec3 a, vec3 b, vec3 c) {
+	// Ericson, "Real-Time Collision Detection," 5.1.5
+	vec3 ab = b-a, ac = c-a, ap = p-a;
+	float d1 = dot(ab, ap), d2 = dot(ac, ap);
+	if (d1 <= 0 && d2 <= 0) return a;
+	vec3 bp = p-b;
+	float d3 = dot(ab, bp), d4 = dot(ac, bp);
+	if (d3 >= 0 && d4 <= d3) return b;
+	float vc = d1*d4-d3*d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0) return a+(d1/(d1-d3))*ab;
+	vec3 cp = p-c;
+	float d5 = dot(ab, cp), d6 = dot(ac, cp);
+	if (d6 >= 0 && d5 <= d6) return c;
+	float vb = d5*d2-d1*d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0) return a+(d2/(d2-d6))*ac;
+	float va = d3*d6-d5*d4;
+	if (va <= 0 && (d4-d3) >= 0 && (d5-d6) >= 0) return b+((d4-d3)/((d4-d3)+(d5-d6)))*(c-b);
+	float denom = 1/(va+vb+vc);
+	return a+(vb*denom)*ab+(vc*denom)*ac;
+}
+
+namespace {
+
+float ClosestSegments(vec3 p1, vec3 q1, vec3 p2, vec3 q2, vec3 &c1, vec3 &c2) {
+	// Ericson 5.1.9; return squared distance
+	vec3 d1 = q1-p1, d2 = q2-p2, r = p1-p2;
+	float a = dot(d1, d1), e = dot(d2, d2), f = dot(d2, r), s = 0, t = 0;
+	if (a <= epsilon && e <= epsilon) { c1 = p1; c2 = p2; return dot(r, r); }
+	if (a <= epsilon)
+		t = std::min(1.f, std::max(0.f, f/e));
+	else {
+		float c = dot(d1, r);
+		if (e <= epsilon)
+			s = std::min(1.f, std::max(0.f, -c/a));
+		else {
+			float b = dot(d1, d2), denom = a*e-b*b;
+			s = denom != 0? std::min(1.f, std::max(0.f, (b*f-c*e)/denom)) : 0;
+			t = (b*s+f)/e;
+			if (t < 0) { t = 0; s = std::min(1.f, std::max(0.f, -c/a)); }
+			else if (t > 1) { t = 1; s = std::min(1.f, std::max(0.f, (b-c)/a)); }
+		}
+	}
+	c1 = p1+s*d1;
+	c2 = p2+t*d2;
+	vec3 d = c1-c2;
+	return dot(d, d);
+}
+
+bool SegmentHitsTriangle(vec3 p, vec3 q, vec3 a, vec3 b, vec3 c, vec3 &hit) {
+	vec3 d = q-p, e1 = b-a, e2 = c-a, h = cross(d, e2);
+	float det = dot(e1, h);
+	if (fabs(det) < 1e-12f)
+		return false;
+	vec3 s = p-a;
+	float f = 1/det, u = f*dot(s, h);
+	if (u < 0 || u > 1)
+		return false;
+	vec3 qv = cross(s, e1);
+	float v = f*dot(d, qv), t = f*dot(e2, qv);
+	if (v < 0 || u+v > 1 || t < 0 || t > 1)
+		return false;
+	hit = p+t*d;
+	return true;
+}
+
+} // end namespace
+
+float TriangleDistance(vec3 v0, vec3 v1, vec3 v2, vec3 u0, vec3 u1, vec3 u2, vec3 *p, vec3 *q) {
+	vec3 v[] = { v0, v1, v2 }, u[] = { u0, u1, u2 }, bestP = v0, bestQ = u0, c1, c2;
+	float best = FLT_MAX;
+	auto Consider = [&](float d2, vec3 a, vec3 b) { if (d2 < best) { best = d2; bestP = a; bestQ = b; } };
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			Consider(ClosestSegments(v[i], v[(i+1)%3], u[j], u[(j+1)%3], c1, c2), c1, c2);
+	for (int i = 0; i < 3; i++) {
+		vec3 cu = ClosestOnTriangle(v[i], u0, u1, u2), cv = ClosestOnTriangle(u[i], v0, v1, v2);
+		Consider(dot(v[i]-cu, v[i]-cu), v[i], cu);
+		Consider(dot(u[i]-cv, u[i]-cv), cv, u[i]);
+	}
+	if (best > 0 && TrianglesIntersect(v0, v1, v2, u0, u1, u2)) {
+		best = 0;
+		vec3 hit;
+		for (int i = 0; i < 3; i++)
+			if (SegmentHitsTriangle(v[i], v[(i+1)%3], u0, u1, u2, hit) || SegmentHitsTriangle(u[i], u[(i+1)%3], v0, v1, v2, hit)) {
+				bestP = bestQ = hit;
+				break;
+			}
+	}
+	if (p) *p = bestP;
+	if (q) *q = bestQ;
+	return sqrt(best);
+}
+
+// Queries
+
+namespace {
+
+struct Query {
+	OBBTree &tree1, &tree2;
+	mat4 m;									// tree2 space to tree1 space
+	vector<vec3> leafCorners;				// tree2 leaf corners in tree1 space
+	int leaf = -1;							// node whose corners are in leafCorners
+	Query(OBBTree &t1, const mat4 &toWorld1, OBBTree &t2, const mat4 &toWorld2) : tree1(t1), tree2(t2) {
+		m = Invert(toWorld1)*toWorld2;
+	}
+	OBB Box2(int node) { return TransformBox(tree2.nodes[node].box, m); }
+	vec3 *Corners2(int node) {
+		if (node != leaf) {
+			OBBTree::Node &n = tree2.nodes[node];
+			leafCorners.resize(3*n.count);
+			for (int i = 0; i < 3*n.count; i++)
+				leafCorners[i] = TransformPoint(m, tree2.corners[3*n.start+i]);
+			leaf = node;
+		}
+		return leafCorners.data();
+	}
+	bool DescendFirst(int n1, int n2, OBB &b2) {
+		// true to split node of tree1, else node of tree2
+		bool leaf1 = tree1.nodes[n1].children < 0, leaf2 = tree2.nodes[n2].children < 0;
+		return leaf2 || (!leaf1 && BoxSize(tree1.nodes[n1].box) >= BoxSize(b2));
+	}
+};
+
+int LeafOverlaps(Query &q, int n1, int n2, vector<ContactPair> *contacts, int maxContacts) {
+	// test each triangle of leaf n1 against those of leaf n2; return number of intersecting pairs
+	OBBTree::Node &a = q.tree1.nodes[n1], &b = q.tree2.nodes[n2];
+	vec3 *u = q.Corners2(n2);
+	int nFound = 0;
+	for (int i = a.start; i < a.start+a.count; i++) {
+		vec3 *v = &q.tree1.corners[3*i];
+		vec3 n = cross(v[1]-v[0], v[2]-v[0]);
+		float len = length(n);
+		if (len == 0)
+			continue;
+		n /= len;
+		float d = -dot(n, v[0]);
+		for (int g = 0; g < b.count; g += 4) {
+			int nLanes = std::min(4, b.count-g), candidates = (1 << nLanes)-1;
+#ifdef COLLIDE_SSE
+			// signed distances of four triangles' vertices to plane of v; reject lanes wholly on one side
+			__m128 nx = _mm_set1_ps(n.x), ny = _mm_set1_ps(n.y), nz = _mm_set1_ps(n.z), nd = _mm_set1_ps(d);
+			__m128 eps = _mm_set1_ps(epsilon), negEps = _mm_set1_ps(-epsilon);
+			__m128 above = _mm_castsi128_ps(_mm_set1_epi32(-1)), below = above;
+			for (int k = 0; k < 3; k++) {
+				float x[4], y[4], z[4];
+				for (int l = 0; l < 4; l++) {
+					vec3 &p = u[3*(g+std::min(l, nLanes-1))+k];
+					x[l] = p.x; y[l] = p.y; z[l] = p.z;
+				}
+				__m128 xy = _mm_add_ps(_mm_mul_ps(nx, _mm_loadu_ps(x)), _mm_mul_ps(ny, _mm_loadu_ps(y)));
+				__m128 dist = _mm_add_ps(_mm_add_ps(xy, _mm_mul_ps(nz, _mm_loadu_ps(z))), nd);
+				above = _mm_and_ps(above, _mm_cmpgt_ps(dist, eps));
+				below = _mm_and_ps(below, _mm_cmplt_ps(dist, negEps));
+			}
+			candidates &= ~_mm_movemask_ps(_mm_or_ps(above, below));
+#endif
+			for (int l = 0; l < nLanes; l++) {
+				if (!(candidates & (1 << l)))
+					continue;
+				vec3 *w = &u[3*(g+l)];
+				if (TrianglesIntersect(v[0], v[1], v[2], w[0], w[1], w[2])) {
+					nFound++;
+					if (!contacts)
+						return nFound;
+					if ((int) contacts->size() < maxContacts)
+						contacts->push_back({q.tree1.ids[i], q.tree2.ids[b.start+g+l]});
+				}
+			}
+		}
+	}
+	return nFound;
+}
+
+} // end namespace
+
+bool Overlap(OBBTree &tree1, const mat4 &toWorld1, OBBTree &tree2, const mat4 &toWorld2,
+			 vector<ContactPair> *contacts, int maxContacts) {
+	if (contacts)
+		contacts->resize(0);
+	if (tree1.Empty() || tree2.Empty())
+		return false;
+	Query q(tree1, toWorld1, tree2, toWorld2);
+	bool found = false;
+	vector<int2> stack(1, int2(0, 0));
+	while (stack.size()) {
+		int2 pair = stack.back();
+		stack.pop_back();
+		int n1 = pair.i1, n2 = pair.i2;
+		OBB b2 = q.Box2(n2);
+		if (Separation(tree1.nodes[n1].box, b2) > 0)
+			continue;
+		int c1 = tree1.nodes[n1].children, c2 = tree2.nodes[n2].children;
+		if (c1 < 0 && c2 < 0) {
+			if (LeafOverlaps(q, n1, n2, contacts, maxContacts)) {
+				found = true;
+				if (!contacts || (int) contacts->size() >= maxContacts)
+					return true;
+			}
+		}
+		else if (q.DescendFirst(n1, n2, b2)) {
+			stack.push_back(int2(c1, n2));
+			stack.push_back(int2(c1+1, n2));
+		}
+		else {
+			stack.push_back(int2(n1, c2));
+			stack.push_back(int2(n1, c2+1));
+		}
+	}
+	return found;
+}
+
+float MinDistance(OBBTree &tree1, const mat4 &toWorld1, OBBTree &tree2, const mat4 &toWorld2,
+				  DistanceResult *result, float maxDistance) {
+	DistanceResult r;
+	r.distance = maxDistance;
+	bool found = false;
+	if (!tree1.Empty() && !tree2.Empty()) {
+		Query q(tree1, toWorld1, tree2, toWorld2);
+		struct Pair { int n1, n2; float bound; };
+		vector<Pair> stack(1, {0, 0, std::max(0.f, Separation(tree1.nodes[0].box, q.Box2(0)))});
+		while (stack.size() && r.distance > 0) {
+			Pair pair = stack.back();
+			stack.pop_back();
+			if (pair.bound >= r.distance)
+				continue;
+			int n1 = pair.n1, n2 = pair.n2, c1 = tree1.nodes[n1].children, c2 = tree2.nodes[n2].children;
+			if (c1 < 0 && c2 < 0) {
+				OBBTree::Node &a = tree1.nodes[n1], &b = tree2.nodes[n2];
+				vec3 *u = q.Corners2(n2), p1, p2;
+				for (int i = a.start; i < a.start+a.count; i++)
+					for (int j = 0; j < b.count; j++) {
+						vec3 *v = &tree1.corners[3*i], *w = &u[3*j];
+						float d = TriangleDistance(v[0], v[1], v[2], w[0], w[1], w[2], &p1, &p2);
+						if (d < r.distance) {
+							found = true;
+							r.distance = d;
+							r.triangle1 = tree1.ids[i];
+							r.triangle2 = tree2.ids[b.start+j];
+							r.point1 = p1;
+							r.point2 = p2;
+						}
+					}
+				continue;
+			}
+			// push children, nearer pair last so it is examined first
+			OBB b2 = q.Box2(n2);
+			Pair children[2];
+			if (q.DescendFirst(n1, n2, b2))
+				for (int k = 0; k < 2; k++)
+					children[k] = {c1+k, n2, std::max(0.f, Separation(tree1.nodes[c1+k].box, b2))};
+			else
+				for (int k = 0; k < 2; k++)
+					children[k] = {n1, c2+k, std::max(0.f, Separation(tree1.nodes[n1].box, q.Box2(c2+k)))};
+			if (children[0].bound < children[1].bound)
+				std::swap(children[0], children[1]);
+			for (int k = 0; k < 2; k++)
+				if (children[k].bound < r.distance)
+					stack.push_back(children[k]);
+		}
+	}
+	if (!found)
+		r.distance = FLT_MAX;
+	else {
+		r.point1 = TransformPoint(toWorld1, r.point1);
+		r.point2 = TransformPoint(toWorld1, r.point2);
+	}
+	if (result)
+		*result = r;
+	return r.distance;
+}
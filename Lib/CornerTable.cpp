@@ -0,0 +1,275 @@
+// CornerTable.cpp - array-based triangle adjacency (corner table) for constant-time topological queries
+
+#include <algorithm>
+#include "CornerTable.h"
+#include "Misc.h"
+
+// Construction
+
+void CornerTable::Build(vector<int3> &triangles, int nVerts) {
+	int nCorners = 3*triangles.size();
+	nVertices = nVerts;
+	nDeleted = 0;
+	V.resize(nCorners);
+	O.assign(nCorners, -1);
+	ParallelFor(triangles.size(), [this, &triangles](int t) {
+		for (int k = 0; k < 3; k++)
+			V[3*t+k] = triangles[t][k];
+	});
+	// bucket corners by lower vertex of opposite edge
+	vector<int> offsets(nVertices+1, 0), buckets(nCorners);
+	for (int c = 0; c < nCorners; c++)
+		offsets[std::min(V[Next(c)], V[Prev(c)])+1]++;
+	for (int v = 0; v < nVertices; v++)
+		offsets[v+1] += offsets[v];
+	vector<int> fill(offsets.begin(), offsets.end()-1);
+	for (int c = 0; c < nCorners; c++)
+		buckets[fill[std::min(V[Next(c)], V[Prev(c)])]++] = c;
+	// within each bucket, pair corners whose edges share the upper vertex and run in opposite directions
+	vector<int> nBad(nVertices, 0);
+	ParallelFor(nVertices, [this, &offsets, &buckets, &nBad](int v) {
+		int *b = &buckets[offsets[v]], n = offsets[v+1]-offsets[v];
+		auto Upper = [this](int c) { return std::max(V[Next(c)], V[Prev(c)]); };
+		std::sort(b, b+n, [this, &Upper](int c1, int c2) { return Upper(c1) < Upper(c2); });
+		for (int i = 0; i < n; ) {
+			int j = i+1;
+			while (j < n && Upper(b[j]) == Upper(b[i]))
+				j++;
+			if (j-i == 2 && V[Next(b[i])] == V[Prev(b[i+1])])
+				Link(b[i], b[i+1]);
+			else if (j-i > 1)
+				nBad[v]++;
+			i = j;
+		}
+	}, 256);
+	nNonManifoldEdges = 0;
+	for (int v = 0; v < nVertices; v++)
+		nNonManifoldEdges += nBad[v];
+	// vertex corners, preferring the start of a boundary fan
+	vertexCorners.assign(nVertices, -1);
+	for (int c = 0; c < nCorners; c++) {
+		int &vc = vertexCorners[V[c]];
+		if (vc < 0 || O[Prev(c)] < 0)
+			vc = c;
+	}
+}
+
+void CornerTable::GetTriangles(vector<int3> &triangles) {
+	triangles.resize(0);
+	for (int t = 0; t < NTriangles(); t++)
+		if (!Deleted(t))
+			triangles.push_back(int3(V[3*t], V[3*t+1], V[3*t+2]));
+}
+
+// One-Ring
+
+int CornerTable::Valence(int v) {
+	int n = 0;
+	ForEachNeighbor(v, [&n](int) { n++; });
+	return n;
+}
+
+bool CornerTable::Adjacent(int v1, int v2) {
+	bool adjacent = false;
+	ForEachNeighbor(v1, [&adjacent, v2](int v) { adjacent = adjacent || v == v2; });
+	return adjacent;
+}
+
+// Edits
+
+int CornerTable::CornerOf(int c, int v) {
+	// corner of v in triangle of corner c, or -1
+	if (c < 0)
+		return -1;
+	int t = 3*(c/3);
+	return V[t] == v? t : V[t+1] == v? t+1 : V[t+2] == v? t+2 : -1;
+}
+
+void CornerTable::ResetVertexCorner(int v, int c) {
+	// set vertexCorners[v] from corner c of v, moved back to the start of its fan if on a boundary
+	if (c >= 0)
+		for (int start = c, back = SwingBack(c); back >= 0 && back != start; back = SwingBack(back))
+			c = back;
+	vertexCorners[v] = c;
+}
+
+bool CornerTable::Flip(int c) {
+	// triangles (vc, a, b) and (d, b, a) become (vc, a, d) and (d, b, vc)
+	int o = O[c];
+	if (o < 0)
+		return false;
+	int c1 = Next(c), c2 = Prev(c), o1 = Next(o), o2 = Prev(o);
+	int vc = V[c], a = V[c1], b = V[c2], d = V[o];
+	if (vc == d || Adjacent(vc, d))
+		return false;
+	int oCA = O[c2], oBC = O[c1], oAD = O[o1], oDB = O[o2];
+	V[c2] = d;
+	V[o2] = vc;
+	Link(c, oAD);
+	Link(c1, o1);
+	Link(c2, oCA);
+	Link(o, oBC);
+	Link(o2, oDB);
+	ResetVertexCorner(vc, c);
+	ResetVertexCorner(a, c1);
+	ResetVertexCorner(b, o1);
+	ResetVertexCorner(d, c2);
+	return true;
+}
+
+int CornerTable::Split(int c) {
+	// (vc, a, b) becomes (vc, a, m) and new (vc, m, b); if interior,
+	// (d, b, a) becomes (d, b, m) and new (d, m, a)
+	int o = O[c], m = nVertices++;
+	int c1 = Next(c), c2 = Prev(c), vc = V[c], a = V[c1], b = V[c2];
+	int oCA = O[c2], oBC = O[c1];
+	int t3 = V.size();
+	V.insert(V.end(), { vc, m, b });
+	O.insert(O.end(), { -1, -1, -1 });
+	vertexCorners.push_back(-1);
+	V[c2] = m;
+	Link(c1, t3+2);
+	Link(c2, oCA);
+	Link(t3+1, oBC);
+	if (o >= 0) {
+		int o1 = Next(o), o2 = Prev(o), d = V[o];
+		int oAD = O[o1], oDB = O[o2];
+		int t4 = V.size();
+		V.insert(V.end(), { d, m, a });
+		O.insert(O.end(), { -1, -1, -1 });
+		V[o2] = m;
+		Link(o, t3);
+		Link(o1, t4+2);
+		Link(o2, oDB);
+		Link(t4, c);
+		Link(t4+1, oAD);
+	}
+	else
+		O[c] = -1;
+	ResetVertexCorner(m, c2);
+	ResetVertexCorner(a, c1);
+	ResetVertexCorner(b, t3+2);
+	ResetVertexCorner(vc, c);
+	return m;
+}
+
+bool CornerTable::Collapse(int c) {
+	int o = O[c], c1 = Next(c), c2 = Prev(c);
+	int vc = V[c], a = V[c1], b = V[c2], d = o >= 0? V[o] : -1;
+	if (vc < 0)
+		return false;
+	// link condition: common neighbors of a and b are exactly the opposite vertices
+	int nCommon = 0;
+	bool linkOk = true;
+	ForEachNeighbor(a, [this, b, vc, d, &nCommon, &linkOk](int n) {
+		if (Adjacent(b, n)) {
+			nCommon++;
+			linkOk = linkOk && (n == vc || n == d);
+		}
+	});
+	if (!linkOk || nCommon != (o >= 0? 2 : 1))
+		return false;
+	// an interior edge between boundary vertices would pinch the mesh
+	if (o >= 0 && BoundaryVertex(a) && BoundaryVertex(b))
+		return false;
+	// corners of b, before edits
+	vector<int> cornersB;
+	ForEachCorner(b, [&cornersB](int k) { cornersB.push_back(k); });
+	// neighbors across the outer edges of deleted triangles become opposite each other
+	int oCA = O[c2], oBC = O[c1], oAD = o >= 0? O[Next(o)] : -1, oDB = o >= 0? O[Prev(o)] : -1;
+	Link(oCA, oBC);
+	if (o >= 0)
+		Link(oAD, oDB);
+	for (size_t i = 0; i < cornersB.size(); i++)
+		V[cornersB[i]] = a;
+	int deleted[] = { c/3, o >= 0? o/3 : -1 };
+	for (int i = 0; i < 2; i++)
+		if (deleted[i] >= 0) {
+			for (int k = 3*deleted[i]; k < 3*deleted[i]+3; k++)
+				V[k] = O[k] = -1;
+			nDeleted++;
+		}
+	// vertex corners from triangles that remain
+	int outer[] = { oCA, oBC, oAD, oDB }, verts[] = { a, vc, d };
+	for (int i = 0; i < 3; i++) {
+		if (verts[i] < 0)
+			continue;
+		int k = -1;
+		for (int j = 0; j < 4 && k < 0; j++)
+			k = CornerOf(outer[j], verts[i]);
+		if (k < 0 && verts[i] == a)
+			for (size_t j = 0; j < cornersB.size() && k < 0; j++)
+				k = V[cornersB[j]] == a? cornersB[j] : -1;
+		ResetVertexCorner(verts[i], k);
+	}
+	vertexCorners[b] = -1;
+	return true;
+}
+
+// Operations on the Table
+
+namespace {
+
+void SmoothPass(CornerTable &table, vector<vec3> &points, vector<vec3> &result, float factor, bool fixBoundary) {
+	ParallelFor(table.nVertices, [&](int v) {
+		result[v] = points[v];
+		if (fixBoundary && table.BoundaryVertex(v))
+			return;
+		vec3 sum;
+		int n = 0;
+		table.ForEachNeighbor(v, [&](int k) { sum += points[k]; n++; });
+		if (n)
+			result[v] += factor*(sum/(float) n-points[v]);
+	}, 256);
+}
+
+} // end namespace
+
+void SmoothVertices(CornerTable &table, vector<vec3> &points, int iterations, float lambda, float mu, bool fixBoundary) {
+	vector<vec3> result(points.size());
+	for (int i = 0; i < iterations; i++) {
+		SmoothPass(table, points, result, lambda, fixBoundary);
+		points.swap(result);
+		if (mu != 0) {
+			SmoothPass(table, points, result, mu, fixBoundary);
+			points.swap(result);
+		}
+	}
+}
+
+void ComputeVertexNormals(CornerTable &table, vector<vec3> &points, vector<vec3> &normals) {
+	normals.resize(table.nVertices);
+	ParallelFor(table.nVertices, [&](int v) {
+		vec3 sum;
+		table.ForEachCorner(v, [&](int c) {
+			vec3 p = points[v], e1 = points[table.V[CornerTable::Next(c)]]-p, e2 = points[table.V[CornerTable::Prev(c)]]-p;
+			float l1 = length(e1), l2 = length(e2), l = length(cross(e1, e2));
+			if (l1 > 0 && l2 > 0 && l > 0)
+				sum += (acos(std::max(-1.f, std::min(1.f, dot(e1, e2)/(l1*l2))))/l)*cross(e1, e2);
+		});
+		float len = length(sum);
+		normals[v] = len > 0? sum/len : sum;
+	}, 256);
+}
+
+int CountCreases(CornerTable &table, vector<vec3> &points, float creaseAngle, vector<char> *creaseCorners) {
+	int nCorners = table.V.size();
+	float cosCrease = cos(creaseAngle*3.1415926f/180);
+	vector<char> creases(nCorners, 0);
+	auto Normal = [&](int c) {
+		int t = 3*(c/3);
+		vec3 p1 = points[table.V[t]], n = cross(points[table.V[t+1]]-p1, points[table.V[t+2]]-p1);
+		float len = length(n);
+		return len > 0? n/len : n;
+	};
+	ParallelFor(nCorners, [&](int c) {
+		int o = table.O[c];
+		creases[c] = table.V[c] >= 0 && o >= 0 && dot(Normal(c), Normal(o)) < cosCrease;
+	});
+	int n = 0;
+	for (int c = 0; c < nCorners; c++)
+		n += creases[c];
+	if (creaseCorners)
+		creaseCorners->swap(creases);
+	return n/2;
+}
@@ -0,0 +1,209 @@
+// DepthQuery.cpp - batched, non-blocking depth-buffer reads and occlusion queries
+
+#include <algorithm>
+#include <stdio.h>
+#include "Draw.h"
+#include "DepthQuery.h"
+
+// Depth Queries
+
+int DepthQueries::Submit(int x, int y, int tag) {
+	if (pending.empty())
+		viewport = VPi();
+	if (x < viewport.i1 || y < viewport.i2 || x >= viewport.i1+viewport.i3 || y >= viewport.i2+viewport.i4)
+		return -1;
+	Result r;
+	r.x = x;
+	r.y = y;
+	r.tag = tag;
+	pending.push_back(r);
+	return (int) pending.size()-1;
+}
+
+int DepthQueries::Submit(vec3 p, mat4 fullview, int tag, float fudge) {
+	if (pending.empty())
+		viewport = VPi();
+	vec4 xp = fullview*vec4(p, 1);
+	if (xp.w <= 0)
+		return -1;
+	vec2 clip(xp.x/xp.w, xp.y/xp.w);
+	int x = (int) (viewport.i1+viewport.i3*(1+clip.x)/2.f), y = (int) (viewport.i2+viewport.i4*(1+clip.y)/2.f);
+	int id = Submit(x, y, tag);
+	if (id >= 0) {
+		pending[id].point = true;
+		pending[id].z = xp.z/xp.w;
+		pending[id].fudge = fudge;
+	}
+	return id;
+}
+
+void DepthQueries::Capture(bool wholeViewport) {
+	frame++;
+	if (pending.empty() && !wholeViewport)
+		return;
+	Batch &b = batches[head];
+	if (b.fence)
+		// ring full: the oldest capture must be consumed before its buffer is reused
+		Resolve(true);
+	int4 rect;
+	if (wholeViewport)
+		rect = pending.empty()? VPi() : viewport;
+	else {
+		int x0 = pending[0].x, y0 = pending[0].y, x1 = x0, y1 = y0;
+		for (Result &r : pending) {
+			x0 = std::min(x0, r.x); x1 = std::max(x1, r.x);
+			y0 = std::min(y0, r.y); y1 = std::max(y1, r.y);
+		}
+		rect = int4(x0, y0, x1-x0+1, y1-y0+1);
+	}
+	int nBytes = rect.i3*rect.i4*sizeof(float);
+	if (!b.pbo)
+		glGenBuffers(1, &b.pbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, b.pbo);
+	if (nBytes > b.capacity) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, nBytes, NULL, GL_STREAM_READ);
+		b.capacity = nBytes;
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(rect.i1, rect.i2, rect.i3, rect.i4, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+		// with a pack buffer bound, returns immediately
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	b.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glGetFloatv(GL_DEPTH_RANGE, b.depthRange);
+	b.rect = rect;
+	b.wholeViewport = wholeViewport;
+	b.frame = frame;
+	b.queries.swap(pending);
+	pending.resize(0);
+	head = (head+1)%nBuffers;
+}
+
+void DepthQueries::ResolveBatch(Batch &b) {
+	int nPixels = b.rect.i3*b.rect.i4;
+	float range = b.depthRange[1]-b.depthRange[0];
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, b.pbo);
+	float *depths = (float *) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, nPixels*sizeof(float), GL_MAP_READ_BIT);
+	if (depths) {
+		for (Result &r : b.queries) {
+			float v = depths[(r.y-b.rect.i2)*b.rect.i3+r.x-b.rect.i1];
+			r.depth = -1+2*(v-b.depthRange[0])/range;
+			if (r.point)
+				r.visible = r.z < r.depth+r.fudge;
+		}
+		if (b.wholeViewport) {
+			image.resize(nPixels);
+			for (int i = 0; i < nPixels; i++)
+				image[i] = -1+2*(depths[i]-b.depthRange[0])/range;
+			imageRect = b.rect;
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	else
+		printf("DepthQueries: can't map pixel buffer\n");
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glDeleteSync(b.fence);
+	b.fence = NULL;
+	results.swap(b.queries);
+	b.queries.resize(0);
+	resultsFrame = b.frame;
+}
+
+bool DepthQueries::Resolve(bool wait) {
+	// batches complete in order, oldest at head
+	bool resolved = false;
+	for (int k = 0; k < nBuffers; k++) {
+		Batch &b = batches[(head+k)%nBuffers];
+		if (!b.fence)
+			continue;
+		GLenum status = wait?
+			glClientWaitSync(b.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) :	// at most 1 sec
+			glClientWaitSync(b.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+		ResolveBatch(b);
+		resolved = true;
+	}
+	return resolved;
+}
+
+bool DepthQueries::Depth(int x, int y, float &depth) {
+	int4 &r = imageRect;
+	if (image.empty() || x < r.i1 || y < r.i2 || x >= r.i1+r.i3 || y >= r.i2+r.i4)
+		return false;
+	depth = image[(y-r.i2)*r.i3+x-r.i1];
+	return true;
+}
+
+void DepthQueries::Release() {
+	for (Batch &b : batches) {
+		if (b.fence)
+			glDeleteSync(b.fence);
+		if (b.pbo)
+			glDeleteBuffers(1, &b.pbo);
+		b.fence = NULL;
+		b.pbo = 0;
+		b.capacity = 0;
+		b.queries.resize(0);
+	}
+	pending.resize(0);
+	image.resize(0);
+}
+
+// Occlusion Queries
+
+void OcclusionQueries::Poll(Query &q) {
+	if (!q.pending)
+		return;
+	GLuint available = 0, samplesPassed = 0;
+	glGetQueryObjectuiv(q.name, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (available) {
+		glGetQueryObjectuiv(q.name, GL_QUERY_RESULT, &samplesPassed);
+		q.visible = samplesPassed != 0;
+		q.available = true;
+		q.pending = false;
+	}
+}
+
+void OcclusionQueries::Begin(int id) {
+	active = -1;
+	if (id < 0)
+		return;
+	if (id >= (int) queries.size())
+		queries.resize(id+1);
+	Query &q = queries[id];
+	Poll(q);
+	if (q.pending)
+		return;	// previous query in flight: don't wait, don't reissue
+	if (!q.name)
+		glGenQueries(1, &q.name);
+	glBeginQuery(GL_ANY_SAMPLES_PASSED, q.name);
+	q.pending = true;
+	active = id;
+}
+
+void OcclusionQueries::End() {
+	if (active >= 0)
+		glEndQuery(GL_ANY_SAMPLES_PASSED);
+	active = -1;
+}
+
+bool OcclusionQueries::Visible(int id, bool *available) {
+	bool a = false, v = true;
+	if (id >= 0 && id < (int) queries.size()) {
+		Query &q = queries[id];
+		Poll(q);
+		a = q.available;
+		v = q.visible;
+	}
+	if (available)
+		*available = a;
+	return v;
+}
+
+void OcclusionQueries::Release() {
+	for (Query &q : queries)
+		if (q.name)
+			glDeleteQueries(1, &q.name);
+	queries.resize(0);
+	active = -1;
+}
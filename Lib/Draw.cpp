@@ -2,10 +2,13 @@
 
 #include <glad.h>
 #include "Draw.h"
+#include "GLState.h"
 #include "GLXtras.h"
+#include <algorithm>
 #include <float.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vector>
 // #include <gl/glu.h>
 
@@ -14,23 +17,17 @@ using std::string;
 // Screen Mode
 
 void ViewportSize(int &width, int &height) {
-	int vp[4];
-	glGetIntegerv(GL_VIEWPORT, vp);
+	int4 vp = ShadowedViewport();
 	width = vp[2];
 	height = vp[3];
 }
 
 vec4 VP() {
-	vec4 vp;
-	glGetFloatv(GL_VIEWPORT, (float *) &vp);
-	return vp;
+	int4 vp = ShadowedViewport();
+	return vec4((float) vp[0], (float) vp[1], (float) vp[2], (float) vp[3]);
 }
 
-int4 VPi() {
-	int4 vp;
-	glGetIntegerv(GL_VIEWPORT, (int *) &vp);
-	return vp;
-}
+int4 VPi() { return ShadowedViewport(); }
 
 int VPw() { return VPi()[2]; }
 
@@ -38,8 +35,7 @@ int VPh() { return VPi()[3]; }
 
 mat4 Viewport() {
 	// map +/-1 space to screen space viewport
-	float vp[4];
-	glGetFloatv(GL_VIEWPORT, vp);
+	vec4 vp = VP();
 	float x = vp[0], y = vp[1], w = vp[2], h = vp[3];
 	return mat4(vec4(w/2,0,0,x+w/2), vec4(0,h/2,0,y+h/2), vec4(0,0,1,0), vec4(0,0,0,1));
 		// **** something wrong here?
@@ -47,8 +43,7 @@ mat4 Viewport() {
 
 mat4 ScreenMode() {
 	// map pixel space (xorigin, yorigin)-(xorigin+width,yorigin+height) to NDC (clip) space (-1,-1)-(1,1)
-	float vp[4];
-	glGetFloatv(GL_VIEWPORT, vp);
+	vec4 vp = VP();
 	float x = vp[0], y = vp[1], w = vp[2], h = vp[3];
 	return Translate(-1, -1, 0)*Scale(2/w, 2/h, 1)*Translate(-x, -y, 0);
 }
@@ -61,9 +56,8 @@ vec2 ScreenPoint(vec3 p, mat4 m, int vp[4], float *zscreen) {
 }
 
 vec2 ScreenPoint(vec3 p, mat4 m, float *zscreen) {
-	int vp[4];
-	glGetIntegerv(GL_VIEWPORT, vp);
-	return ScreenPoint(p, m, vp, zscreen);
+	int4 vp = VPi();
+	return ScreenPoint(p, m, (int *) &vp, zscreen);
 }
 
 bool IsVisible(vec3 p, mat4 fullview, vec2 *screenA, int *w, int *h, float fudge) {
@@ -140,8 +134,6 @@ void UnProjectInv(float xscreen, float yscreen, float zscreen, mat4 &inv, vec3 &
 
 void ScreenRay(float xscreen, float yscreen, mat4 modelview, mat4 persp, vec3 &p, vec3 &v) {
 	// compute ray from p in direction v; p is transformed eyepoint, xscreen, yscreen determine v
-	int vp[4];
-	glGetIntegerv(GL_VIEWPORT, vp);
 	// origin of ray is always eye (translated origin)
 	p = vec3(modelview[0][3], modelview[1][3], modelview[2][3]);
 	mat4 fullview = persp*modelview;
@@ -213,14 +205,17 @@ const char *drawVShader = R"(
 	#version 410 core
 	in vec3 position;
 	in vec3 color;
+	in float dash;
 	out vec3 vColor;
 	out vec2 vUv;
+	noperspective out float vDash;
 	uniform mat4 view;
 	void main() {
 		vec2 uvs[] = vec2[4](vec2(0,0), vec2(0,1), vec2(1,1), vec2(1,0));
 		vUv = uvs[gl_VertexID];
 		gl_Position = view*vec4(position, 1);
 		vColor = color;
+		vDash = dash;
 	}
 )";
 #else
@@ -228,14 +223,17 @@ const char *drawVShader = R"(
 	#version 130
 	in vec3 position;
 	in vec3 color;
+	in float dash;
 	out vec3 vColor;
 	out vec2 vUv;
+	noperspective out float vDash;
 	uniform mat4 view;
 	void main() {
 		vec2 uvs[] = vec2[4](vec2(0,0), vec2(0,1), vec2(1,1), vec2(1,0));
 		vUv = uvs[gl_VertexID];
 		gl_Position = view*vec4(position, 1);
 		vColor = color;
+		vDash = dash;
 	}
 )";
 #endif
@@ -245,8 +243,10 @@ const char *drawPShader = R"(
 	#version 410 core
 	in vec3 vColor;
 	in vec2 vUv;
+	noperspective in float vDash;
 	out vec4 pColor;
 	uniform float opacity = 1;
+	uniform float dashFraction = 1;
 	uniform bool fadeToCenter = false;
 	uniform bool ring = false;
 	uniform bool useTexture = false;
@@ -272,6 +272,8 @@ const char *drawPShader = R"(
 	void main() {
 		// GL_POINT_SMOOTH deprecated, so calc here
 		// needs GL_POINT_SPRITE or 0x8861 enabled
+		if (fract(vDash) > dashFraction)
+			discard;									// gap between dashes
 		float o = opacity;
 		if (fadeToCenter)
 			o *= Fade(DistanceToCenter());
@@ -285,8 +287,10 @@ const char *drawPShader = R"(
 	#version 130
 	in vec3 vColor;
 	in vec2 vUv;
+	noperspective in float vDash;
 	out vec4 pColor;
 	uniform float opacity = 1;
+	uniform float dashFraction = 1;
 	uniform bool fadeToCenter = false;
 	uniform bool ring = false;
 	uniform bool useTexture = false;
@@ -313,6 +317,8 @@ const char *drawPShader = R"(
 	void main() {
 		// GL_POINT_SMOOTH deprecated, so calc here
 		// needs GL_POINT_SPRITE or 0x8861 enabled
+		if (fract(vDash) > dashFraction)
+			discard;									// gap between dashes
 		if (opacity < 1 && gl_Color.a < 1)
 			discard;									// in effect, transparent
 		float o = opacity;
@@ -334,12 +340,13 @@ const char *drawPShader = R"(
 )";
 #endif
 
+static bool drawRegistered = RegisterProgram("Draw", &drawVShader, &drawPShader);
+
 mat4 GetDrawView() { return drawView; }
 void SetDrawView(mat4 m) { drawView = m; }
 
 GLuint UseDrawShader() {
-	int was = 0;
-	glGetIntegerv(GL_CURRENT_PROGRAM, &was);
+	int was = ShadowedProgram();
 	bool init = !drawShader;
 	if (init) drawShader = LinkProgramViaCode(&drawVShader, &drawPShader);
 	glUseProgram(drawShader);
@@ -355,39 +362,139 @@ GLuint UseDrawShader(mat4 viewMatrix) {
 	return was;
 }
 
-// Disks
+// Batching
 
-GLuint diskVBO = 0, diskVAO = 0;
+mat4 triView;								// set by UseTriangleShader(view), recorded by Triangle
+std::vector<DrawList *> drawListStack;
 
-void Disk(vec2 p, float diameter, vec3 color, float opacity, bool ring) {
-	Disk(vec3(p), diameter, color, opacity, ring);
+DrawList &ImplicitDrawList() {
+	static DrawList *list = new DrawList();	// never destroyed, so no GL calls after context is gone
+	return *list;
 }
 
-void Disk(vec3 p, float diameter, vec3 color, float opacity, bool ring) {
-	// diameter should be >= 0, <= 20
-	UseDrawShader();
-	// create buffer for single vertex (x,y,z,r,g,b)
-	if (!diskVBO) {
-		glGenVertexArrays(1, &diskVAO);
-		glGenBuffers(1, &diskVBO);
-		glBindVertexArray(diskVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, diskVBO);
-		glBufferData(GL_ARRAY_BUFFER, 2*sizeof(vec3), NULL, GL_STATIC_DRAW);
-	}
-	glBindVertexArray(diskVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, diskVBO); // set active buffer
-	// allocate buffer memory and load location and color data
-	glBufferSubData(GL_ARRAY_BUFFER, 0, 3*sizeof(float), &p.x);
-	glBufferSubData(GL_ARRAY_BUFFER, 3*sizeof(float), 3*sizeof(float), &color.x);
-	// connect shader inputs
-	VertexAttribPointer(drawShader, "position", 3, 0, (void *) 0);
-	VertexAttribPointer(drawShader, "color", 3, 0, (void *) sizeof(vec3));
-	// draw
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	SetUniform(drawShader, "opacity", opacity);
-	SetUniform(drawShader, "ring", ring);
-	glPointSize(diameter);
+DrawList &CurrentDrawList() {
+	return drawListStack.empty()? ImplicitDrawList() : *drawListStack.back();
+}
+
+void FlushIfImmediate() {
+	if (drawListStack.empty())
+		ImplicitDrawList().Flush();
+}
+
+void FlushDrawList() { CurrentDrawList().Flush(); }
+
+void BeginDrawList(DrawList *list) {
+	drawListStack.push_back(list? list : &CurrentDrawList());
+}
+
+void EndDrawList() {
+	if (drawListStack.empty())
+		return;
+	DrawList *list = drawListStack.back();
+	drawListStack.pop_back();
+	if (std::find(drawListStack.begin(), drawListStack.end(), list) == drawListStack.end())
+		list->Flush();
+}
+
+bool DrawList::State::operator==(const State &s) const {
+	return mode == s.mode && triangleShader == s.triangleShader && opacity == s.opacity && size == s.size &&
+		   ring == s.ring && dashFraction == s.dashFraction && outline == s.outline && outlineWidth == s.outlineWidth && transition == s.transition &&
+		   !memcmp(&view, &s.view, sizeof(mat4)) && !memcmp(&outlineColor, &s.outlineColor, sizeof(vec4));
+}
+
+DrawList::Vertex *DrawList::Add(const State &s, int nVertices) {
+	if (groups.empty() || !(groups.back().state == s)) {
+		groups.push_back(Group());
+		groups.back().state = s;
+		groups.back().start = vertices.size();
+	}
+	groups.back().count += nVertices;
+	vertices.resize(vertices.size()+nVertices);
+	return &vertices[vertices.size()-nVertices];
+}
+
+void DrawList::Disk(vec3 p, float diameter, vec3 color, float opacity, bool ring) {
+	State s;
+	s.mode = GL_POINTS;
+	s.view = drawView;
+	s.opacity = opacity;
+	s.size = diameter;
+	s.ring = ring;
+	*Add(s, 1) = { p, color };
+}
+
+void DrawList::Line(vec3 p1, vec3 p2, float width, vec3 col1, vec3 col2, float opacity) {
+	State s;
+	s.view = drawView;
+	s.opacity = opacity;
+	s.size = width;
+	Vertex *v = Add(s, 2);
+	v[0] = { p1, col1 };
+	v[1] = { p2, col2 };
+}
+
+void DrawList::LineDash(vec3 p1, vec3 p2, float width, vec3 col1, vec3 col2, float opacity, float dashLen, float percentDash) {
+	State s;
+	s.view = drawView;
+	s.opacity = opacity;
+	s.size = width;
+	s.dashFraction = percentDash;
+	float totalLen = length(ScreenPoint(p2, drawView)-ScreenPoint(p1, drawView));
+	Vertex *v = Add(s, 2);
+	v[0] = { p1, col1, 0 };
+	v[1] = { p2, col2, dashLen > 0? totalLen/dashLen : 0 };
+}
+
+void DrawList::LineDot(vec3 p1, vec3 p2, float width, vec3 col, float opacity, int pixelSpacing) {
+	State s;
+	s.mode = GL_POINTS;
+	s.view = drawView;
+	s.opacity = opacity;
+	s.size = width;
+	float totalLen = length(ScreenPoint(p2, drawView)-ScreenPoint(p1, drawView));
+	int nDots = pixelSpacing > 0? (int) (totalLen/(float)pixelSpacing) : 0;
+	if (nDots < 1)
+		return;
+	vec3 d = (p2-p1)/(float)nDots;
+	Vertex *v = Add(s, nDots);
+	for (int i = 0; i < nDots; i++)
+		v[i] = { p1+(float)i*d, col };
+}
+
+void DrawList::Quad(vec3 p1, vec3 p2, vec3 p3, vec3 p4, bool solid, vec3 col, float opacity, float lineWidth) {
+	State s;
+	s.mode = solid? GL_TRIANGLES : GL_LINES;
+	s.view = drawView;
+	s.opacity = opacity;
+	s.size = lineWidth;
+	vec3 p[] = { p1, p2, p3, p1, p3, p4 }, e[] = { p1, p2, p2, p3, p3, p4, p4, p1 };
+	int n = solid? 6 : 8;
+	Vertex *v = Add(s, n);
+	for (int i = 0; i < n; i++)
+		v[i] = { solid? p[i] : e[i], col };
+}
+
+void DrawList::Triangle(vec3 p1, vec3 p2, vec3 p3, vec3 c1, vec3 c2, vec3 c3,
+						float opacity, bool outline, vec4 outlineCol, float outlineWidth, float transition) {
+	State s;
+	s.mode = GL_TRIANGLES;
+	s.triangleShader = true;
+	s.view = triView;
+	s.opacity = opacity;
+	if (outline) {
+		s.outline = true;
+		s.outlineColor = outlineCol;
+		s.outlineWidth = outlineWidth;
+		s.transition = transition;
+	}
+	Vertex *v = Add(s, 3);
+	v[0] = { p1, c1 };
+	v[1] = { p2, c2 };
+	v[2] = { p3, c3 };
+}
+
+bool EnablePointSmooth() {
+	// return true if draw shader must fade points itself
 #ifdef GL_POINT_SMOOTH
 	glEnable(GL_POINT_SMOOTH);
 #endif
@@ -396,41 +503,124 @@ void Disk(vec3 p, float diameter, vec3 color, float opacity, bool ring) {
 #endif
 #if !defined(GL_POINT_SMOOTH) && !defined(GL_POINT_SPRITE)
 	glEnable(0x8861); // same as GL_POINT_SMOOTH [this is a 4.5 core bug]
-	SetUniform(drawShader, "fadeToCenter", true); // needed if GL_POINT_SMOOTH and GL_POINT_SPRITE fail
+	return true;      // needed if GL_POINT_SMOOTH and GL_POINT_SPRITE fail
+#endif
+	return false;
+}
+
+void DrawList::Flush() {
+	if (groups.empty())
+		return;
+	if (!vbo) {
+		glGenVertexArrays(1, &vao);
+		glGenBuffers(1, &vbo);
+	}
+	// detach the recorded primitives, so nothing drawn below can alter them mid-loop
+	std::vector<Vertex> drawVertices;
+	std::vector<Group> drawGroups;
+	drawVertices.swap(vertices);
+	drawGroups.swap(groups);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	// one upload, orphaning the previous store
+	int nBytes = drawVertices.size()*sizeof(Vertex);
+	if (nBytes > capacity)
+		capacity = std::max(nBytes+nBytes/2, 1024*(int) sizeof(Vertex));
+	glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, nBytes, drawVertices.data());
+	GLuint program = 0;
+	for (Group &g : drawGroups) {
+		State &s = g.state;
+#ifndef __APPLE__
+		if (s.mode == GL_LINES && !s.triangleShader && s.size > 1 && s.dashFraction >= 1 && PolylineAvailable()) {
+			// glLineWidth is often limited to one pixel, so draw wide lines as polyline segments
+			static Polyline *wide = new Polyline();	// never destroyed, as for ImplicitDrawList
+			wide->Clear();
+			wide->cap = LineCap::Butt;
+			for (int v = g.start; v < g.start+g.count; v += 2) {
+				PolylineVertex ends[] = { PolylineVertex(drawVertices[v].point, s.size, vec4(drawVertices[v].color, s.opacity)),
+										  PolylineVertex(drawVertices[v+1].point, s.size, vec4(drawVertices[v+1].color, s.opacity)) };
+				wide->AddStrip(ends, 2);
+			}
+			wide->Draw(s.view);
+			glBindVertexArray(vao);
+			glBindBuffer(GL_ARRAY_BUFFER, vbo);
+			program = 0;
+			continue;
+		}
 #endif
-	glDrawArrays(GL_POINTS, 0, 1);
+		GLuint shader = s.triangleShader? GetTriangleShader() : GetDrawShader();
+		if (shader != program) {
+			program = shader;
+			glUseProgram(program);
+			VertexAttribPointer(program, s.triangleShader? "point" : "position", 3, sizeof(Vertex), (void *) 0);
+			VertexAttribPointer(program, "color", 3, sizeof(Vertex), (void *) sizeof(vec3));
+			if (!s.triangleShader)
+				VertexAttribPointer(program, "dash", 1, sizeof(Vertex), (void *) (2*sizeof(vec3)));
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			if (s.triangleShader) {
+				glEnable(GL_LINE_SMOOTH);
+				SetUniform(program, "viewptM", Viewport());
+			}
+		}
+		SetUniform(program, "view", s.view);
+		SetUniform(program, "opacity", s.opacity);
+		if (s.triangleShader) {
+			SetUniform(program, "outlineOn", s.outline? 1 : 0);
+			SetUniform(program, "outlineColor", s.outlineColor);
+			SetUniform(program, "outlineWidth", s.outlineWidth);
+			SetUniform(program, "transition", s.transition);
+		}
+		else {
+			bool points = s.mode == GL_POINTS, fade = points && EnablePointSmooth();
+			SetUniform(program, "fadeToCenter", fade);
+			SetUniform(program, "ring", points && s.ring);
+			SetUniform(program, "useTexture", false);
+			SetUniform(program, "dashFraction", s.dashFraction);
+			if (points)
+				glPointSize(s.size);
+			if (s.mode == GL_LINES)
+				glLineWidth(s.size);
+		}
+		glDrawArrays(s.mode, g.start, g.count);
+	}
+	if (program == (GLuint) drawShader)
+		SetUniform(program, "view", drawView);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	if (groups.empty()) {
+		// reattach the (emptied) storage, keeping its capacity
+		drawVertices.resize(0);
+		drawGroups.resize(0);
+		vertices.swap(drawVertices);
+		groups.swap(drawGroups);
+	}
 }
 
-// Lines
+void DrawList::Release() {
+	if (vbo) glDeleteBuffers(1, &vbo);
+	if (vao) glDeleteVertexArrays(1, &vao);
+	vbo = vao = 0;
+	capacity = 0;
+}
+
+// Disks
+
+void Disk(vec2 p, float diameter, vec3 color, float opacity, bool ring) {
+	Disk(vec3(p), diameter, color, opacity, ring);
+}
 
-GLuint lineVBO = 0, lineVAO = 0;
+void Disk(vec3 p, float diameter, vec3 color, float opacity, bool ring) {
+	// diameter should be >= 0, <= 20
+	CurrentDrawList().Disk(p, diameter, color, opacity, ring);
+	FlushIfImmediate();
+}
+
+// Lines
 
 void Line(vec3 p1, vec3 p2, float width, vec3 col1, vec3 col2, float opacity) {
-	UseDrawShader();
-	// create a vertex buffer for the array
-	vec3 data[] = {p1, p2, col1, col2};
-	if (!lineVBO) {
-		glGenVertexArrays(1, &lineVAO);
-		glGenBuffers(1, &lineVBO);
-		glBindVertexArray(lineVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, lineVBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(data), NULL, GL_STATIC_DRAW);
-	}
-	// set active vertex buffer, load location and color data
-	glBindVertexArray(lineVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, lineVBO);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(data), (void *) data);
-	// connect shader inputs, set uniforms
-	VertexAttribPointer(drawShader, "position", 3, 0, (void *) 0);
-	VertexAttribPointer(drawShader, "color", 3, 0, (void *) (2*sizeof(vec3)));
-	SetUniform(drawShader, "fadeToCenter", false);  // gl_PointCoord fails for lines (instead, use GL_LINE_SMOOTH)
-	SetUniform(drawShader, "opacity", opacity);
-	// draw
-	glLineWidth(width);
-	glDrawArrays(GL_LINES, 0, 2);
-	// cleanup
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	CurrentDrawList().Line(p1, p2, width, col1, col2, opacity);
+	FlushIfImmediate();
 }
 
 void Line(vec3 p1, vec3 p2, float width, vec3 col, float opacity) {
@@ -454,46 +644,260 @@ void Line(int x1, int y1, int x2, int y2, float width, vec3 col, float opacity)
 // LineDash and LineDot
 
 void LineDash(vec3 p1, vec3 p2, float width, vec3 col1, vec3 col2, float opacity, float dashLen, float percentDash) {
-	float totalLen = length(ScreenPoint(p2, drawView)-ScreenPoint(p1, drawView));
-	float nDashes = totalLen/dashLen;
-	vec3 seg = (p2-p1)/nDashes, dash = percentDash*seg;
-	for (int i = 0; i < (int) nDashes; i++) {
-		vec3 start = p1+(float)i*seg;
-		Line(start, start+dash, width, col1, col2, opacity);
-	}
+	CurrentDrawList().LineDash(p1, p2, width, col1, col2, opacity, dashLen, percentDash);
+	FlushIfImmediate();
+}
+
+void LineDot(vec3 p1, vec3 p2, float width, vec3 col, float opacity, int pixelSpacing) {
+	CurrentDrawList().LineDot(p1, p2, width, col, opacity, pixelSpacing);
+	FlushIfImmediate();
 }
 
 void LineDot(vec3 p1, vec3 p2, mat4 view, float width, vec3 col, float opacity, int pixelSpacing) {
 	UseDrawShader(view);
-	float totalLen = length(ScreenPoint(p2, view)-ScreenPoint(p1, view));
-	int nDots = (int) (totalLen/(float)pixelSpacing);
-	vec3 d = (p2-p1)/(float)nDots;
-	for (int i = 0; i < nDots; i++)
-		Disk(p1+(float)i*d, width, col);
+	LineDot(p1, p2, width, col, opacity, pixelSpacing);
 }
 
-GLuint lineStripVBO = 0, lineStripVAO = 0;
-
 void LineStrip(int nPoints, vec3 *points, vec3 &color, float opacity, float width) {
-	int pSize = nPoints*sizeof(vec3);
-	if (!lineStripVBO) {
-		glGenVertexArrays(1, &lineStripVAO);
-		glGenBuffers(1, &lineStripVBO);
-		glBindVertexArray(lineStripVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, lineStripVBO);
-		glBufferData(GL_ARRAY_BUFFER, 2*pSize, NULL, GL_STATIC_DRAW);
-	}
-	glBindVertexArray(lineStripVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, lineStripVBO);
-	std::vector<vec3> colors(nPoints, color);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, pSize, points);
-	glBufferSubData(GL_ARRAY_BUFFER, pSize, pSize, colors.data());
-	VertexAttribPointer(drawShader, "position", 3, 0, (void *) 0);
-	VertexAttribPointer(drawShader, "color", 3, 0, (void *) pSize);
-	SetUniform(drawShader, "fadeToCenter", false);
-	SetUniform(drawShader, "opacity", opacity);
-	glLineWidth(width);
-	glDrawArrays(GL_LINE_STRIP, 0, nPoints);
+#ifdef __APPLE__
+	// no storage buffers in OpenGL 4.1
+	BeginDrawList();
+	for (int i = 0; i < nPoints-1; i++)
+		Line(points[i], points[i+1], width, color, opacity);
+	EndDrawList();
+#else
+	static Polyline *strip = new Polyline();	// never destroyed, so no GL calls after context is gone
+	FlushDrawList();
+	strip->Clear();
+	strip->AddStrip(points, nPoints, width, vec4(color, opacity));
+	strip->Draw(drawView);
+#endif
+}
+
+// Polylines
+
+GLuint polylineShader = 0;
+
+const char *polylineVShader = R"(
+	#version 430 core
+	struct Vertex { vec4 pointWidth; vec4 color; };
+	layout (std430, binding = 12) readonly buffer Vertices { Vertex vertices[]; };
+	layout (std430, binding = 13) readonly buffer Segments { uint segments[]; };
+	uniform mat4 view;
+	uniform vec2 viewportSize;
+	uniform int join = 1;				// 0: miter, 1: round
+	uniform int cap = 2;				// 0: butt, 1: square, 2: round
+	uniform float miterLimit = 4;
+	noperspective out vec2 vPixel;
+	flat out vec2 vA, vB;				// segment ends, in pixels
+	flat out float vRa, vRb;			// half widths
+	flat out vec4 vColorA, vColorB;
+	flat out int vEnds;					// bit 0: a ends strip, bit 1: b ends strip
+	vec4 Clip(int i) { return view*vec4(vertices[i].pointWidth.xyz, 1); }
+	vec2 Pixel(vec4 c) { return (c.xy/c.w*.5+.5)*viewportSize; }
+	void main() {
+		// six vertices (two triangles) per segment; corner is (end, side)
+		int ends[6] = int[6](0, 1, 1, 0, 1, 0);
+		float sides[6] = float[6](-1, -1, 1, -1, 1, 1);
+		int corner = gl_VertexID%6, e = ends[corner];
+		uint s = segments[gl_VertexID/6];
+		int i = int(s & 0x3fffffffu);
+		bool startEnd = (s & 0x40000000u) != 0, endEnd = (s & 0x80000000u) != 0;
+		vec4 ca = Clip(i), cb = Clip(i+1);
+		vec2 a = Pixel(ca), b = Pixel(cb), t = b-a;
+		float len = length(t);
+		t = len > 0? t/len : vec2(1, 0);
+		vec2 n = vec2(-t.y, t.x);
+		float ra = .5*vertices[i].pointWidth.w, rb = .5*vertices[i+1].pointWidth.w, r = e == 0? ra : rb;
+		bool isEnd = e == 0? startEnd : endEnd;
+		vec2 offset;
+		if (isEnd || join == 1) {
+			// extend past the end for cap or round join, plus a pixel for anti-aliasing
+			float extend = isEnd && cap == 0? 1 : r+1;
+			offset = (e == 0? -extend : extend)*t+sides[corner]*(r+1)*n;
+		}
+		else {
+			// miter: offset along bisector of this and the neighboring segment's normals
+			vec2 q = Pixel(Clip(e == 0? i-1 : i+2)), t2 = e == 0? a-q : q-b;
+			t2 = length(t2) > 0? normalize(t2) : t;
+			vec2 m = n+vec2(-t2.y, t2.x);
+			m = length(m) > 1e-4? normalize(m) : n;
+			offset = sides[corner]*(r+1)/max(dot(m, n), 1/miterLimit)*m;
+		}
+		vec4 c = e == 0? ca : cb;
+		vPixel = (e == 0? a : b)+offset;
+		gl_Position = vec4((vPixel/viewportSize*2-1)*c.w, c.z, c.w);
+		vA = a;
+		vB = b;
+		vRa = ra;
+		vRb = rb;
+		vColorA = vertices[i].color;
+		vColorB = vertices[i+1].color;
+		vEnds = (startEnd? 1 : 0) | (endEnd? 2 : 0);
+	}
+)";
+
+const char *polylinePShader = R"(
+	#version 430 core
+	noperspective in vec2 vPixel;
+	flat in vec2 vA, vB;
+	flat in float vRa, vRb;
+	flat in vec4 vColorA, vColorB;
+	flat in int vEnds;
+	uniform int join = 1;
+	uniform int cap = 2;
+	out vec4 pColor;
+	void main() {
+		// signed distance (pixels) inside the stroke gives coverage
+		vec2 ab = vB-vA, ap = vPixel-vA;
+		float len = length(ab);
+		vec2 dir = len > 0? ab/len : vec2(1, 0);
+		float s = dot(ap, dir), u = len > 0? clamp(s/len, 0, 1) : 0;
+		float r = mix(vRa, vRb, u), inside = r-abs(dir.x*ap.y-dir.y*ap.x);
+		bool beforeA = s < 0, afterB = s > len;
+		if (beforeA || afterB) {
+			bool isEnd = (vEnds & (beforeA? 1 : 2)) != 0;
+			if (isEnd? cap == 2 : join == 1)
+				inside = r-length(vPixel-(beforeA? vA : vB));
+			else if (isEnd)
+				inside = min(inside, (cap == 1? r : 0)-(beforeA? -s : s-len));
+			// else within miter, where distance to the line suffices
+		}
+		float coverage = clamp(inside+.5, 0, 1);
+		if (coverage <= 0)
+			discard;
+		vec4 color = mix(vColorA, vColorB, u);
+		pColor = vec4(color.rgb, color.a*coverage);
+	}
+)";
+
+static bool polylineRegistered = RegisterProgram("Polyline", &polylineVShader, &polylinePShader);
+
+void Polyline::AddStrip(const vec3 *points, int nPoints, float width, vec4 color) {
+	int start = vertices.size();
+	vertices.resize(start+nPoints);
+	for (int i = 0; i < nPoints; i++)
+		vertices[start+i] = PolylineVertex(points[i], width, color);
+	AddSegments(start, nPoints);
+}
+
+void Polyline::AddStrip(const PolylineVertex *strip, int nVertices) {
+	int start = vertices.size();
+	vertices.insert(vertices.end(), strip, strip+nVertices);
+	AddSegments(start, nVertices);
+}
+
+void Polyline::AddSegments(int start, int n) {
+	for (int i = 0; i < n-1; i++)
+		segments.push_back((GLuint) (start+i) | (i == 0? 0x40000000u : 0) | (i == n-2? 0x80000000u : 0));
+	dirty = true;
+}
+
+void UploadStorage(GLuint &buffer, int &capacity, const void *data, int nBytes) {
+	if (!buffer)
+		glGenBuffers(1, &buffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	if (nBytes > capacity) {
+		capacity = nBytes+nBytes/2;
+		glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, NULL, GL_DYNAMIC_DRAW);
+	}
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, nBytes, data);
+}
+
+bool PolylineAvailable() {
+	static bool tried = false;
+	if (!polylineShader && !tried) {
+		tried = true;
+		polylineShader = LinkProgramViaCode(&polylineVShader, &polylinePShader);
+		if (!polylineShader)
+			printf("Polyline: shader unavailable (needs OpenGL 4.3), drawing as GL_LINES\n");
+	}
+	return polylineShader != 0;
+}
+
+GLuint polylineFallbackVao = 0, polylineFallbackVbo = 0;
+
+void PolylineFallback(const std::vector<PolylineVertex> &vertices, const std::vector<GLuint> &segments, mat4 view) {
+	// without the storage-buffer shader, draw segments as GL_LINES (no joins or caps, width per glLineWidth)
+	// drawn directly, not through a DrawList, since DrawList::Flush may be the caller
+	std::vector<DrawList::Vertex> lines(2*segments.size());
+	for (size_t i = 0; i < segments.size(); i++)
+		for (int k = 0; k < 2; k++) {
+			const PolylineVertex &v = vertices[(segments[i]&0x3FFFFFFF)+k];
+			lines[2*i+k].point = v.point;
+			lines[2*i+k].color = Vec3(v.color);
+		}
+	if (!polylineFallbackVbo) {
+		glGenVertexArrays(1, &polylineFallbackVao);
+		glGenBuffers(1, &polylineFallbackVbo);
+	}
+	glBindVertexArray(polylineFallbackVao);
+	glBindBuffer(GL_ARRAY_BUFFER, polylineFallbackVbo);
+	glBufferData(GL_ARRAY_BUFFER, lines.size()*sizeof(DrawList::Vertex), lines.data(), GL_STREAM_DRAW);
+	GLuint program = GetDrawShader();
+	glUseProgram(program);
+	VertexAttribPointer(program, "position", 3, sizeof(DrawList::Vertex), (void *) 0);
+	VertexAttribPointer(program, "color", 3, sizeof(DrawList::Vertex), (void *) sizeof(vec3));
+	VertexAttribPointer(program, "dash", 1, sizeof(DrawList::Vertex), (void *) (2*sizeof(vec3)));
+	SetUniform(program, "view", view);
+	SetUniform(program, "fadeToCenter", false);
+	SetUniform(program, "ring", false);
+	SetUniform(program, "useTexture", false);
+	SetUniform(program, "dashFraction", 1.f);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	// one draw per run of segments with equal width and opacity (taken from each segment's first vertex)
+	for (size_t i = 0, n = 1; i < segments.size(); i += n, n = 1) {
+		const PolylineVertex &v = vertices[segments[i]&0x3FFFFFFF];
+		while (i+n < segments.size()) {
+			const PolylineVertex &w = vertices[segments[i+n]&0x3FFFFFFF];
+			if (w.width != v.width || w.color.w != v.color.w)
+				break;
+			n++;
+		}
+		SetUniform(program, "opacity", v.color.w);
+		glLineWidth(v.width);
+		glDrawArrays(GL_LINES, 2*i, 2*n);
+	}
+	SetUniform(program, "view", drawView);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Polyline::Draw(mat4 view) {
+	if (segments.empty())
+		return;
+	if (!PolylineAvailable()) {
+		PolylineFallback(vertices, segments, view);
+		return;
+	}
+	if (!vao)
+		glGenVertexArrays(1, &vao);			// no attributes, but core profile draws need a vertex array
+	if (dirty) {
+		UploadStorage(vertexBuffer, vertexCapacity, vertices.data(), vertices.size()*sizeof(PolylineVertex));
+		UploadStorage(segmentBuffer, segmentCapacity, segments.data(), segments.size()*sizeof(GLuint));
+		dirty = false;
+	}
+	vec4 vp = VP();
+	glUseProgram(polylineShader);
+	glBindVertexArray(vao);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, vertexBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, segmentBuffer);
+	SetUniform(polylineShader, "view", view);
+	SetUniform(polylineShader, "viewportSize", vec2(vp[2], vp[3]));
+	SetUniform(polylineShader, "join", join == LineJoin::Round? 1 : 0);
+	SetUniform(polylineShader, "cap", (int) cap);
+	SetUniform(polylineShader, "miterLimit", miterLimit);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDrawArrays(GL_TRIANGLES, 0, 6*segments.size());
+}
+
+void Polyline::Release() {
+	if (vertexBuffer) glDeleteBuffers(1, &vertexBuffer);
+	if (segmentBuffer) glDeleteBuffers(1, &segmentBuffer);
+	if (vao) glDeleteVertexArrays(1, &vao);
+	vertexBuffer = segmentBuffer = vao = 0;
+	vertexCapacity = segmentCapacity = 0;
 }
 
 // Quads
@@ -538,19 +942,21 @@ void QuadInner(vec3 p1, vec3 p2, vec3 p3, vec3 p4, bool solid, vec3 col, float o
 }
 
 void Quad(vec3 p1, vec3 p2, vec3 p3, vec3 p4, bool solid, vec3 col, float opacity, float lineWidth) {
-	QuadInner(p1, p2, p3, p4, solid, col, opacity, lineWidth, false);
+	CurrentDrawList().Quad(p1, p2, p3, p4, solid, col, opacity, lineWidth);
+	FlushIfImmediate();
 }
 
 void Quad(vec3 p1, vec3 p2, vec3 p3, vec3 p4, GLuint textureName, int textureUnit, int nChannels) {
+	FlushDrawList();
 	QuadInner(p1, p2, p3, p4, true, vec3(0,0,0), 1, 1, true, textureName, textureUnit, nChannels);
 }
 
 void Quad(int x1, int y1, int x2, int y2, int x3, int y3, int x4, int y4, bool solid, vec3 color, float opacity, float lineWidth) {
-	QuadInner(vec3((float)x1,(float)y1,0), vec3((float)x2,(float)y2,0), vec3((float)x3,(float)y3,0), vec3((float)x4,(float)y4,0), solid, color, opacity, lineWidth);
+	Quad(vec3((float)x1,(float)y1,0), vec3((float)x2,(float)y2,0), vec3((float)x3,(float)y3,0), vec3((float)x4,(float)y4,0), solid, color, opacity, lineWidth);
 }
 
 void Quad(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4, bool solid, vec3 color, float opacity, float lineWidth) {
-	QuadInner(vec3(x1,y1,0), vec3(x2,y2,0), vec3(x3,y3,0), vec3(x4,y4,0), solid, color, opacity, lineWidth);
+	Quad(vec3(x1,y1,0), vec3(x2,y2,0), vec3(x3,y3,0), vec3(x4,y4,0), solid, color, opacity, lineWidth);
 }
 
 // Star
@@ -559,6 +965,7 @@ void Star(vec3 p, float size, vec3 color) {
 	mat4 mSave = drawView;
 	vec2 s = ScreenPoint(p, drawView);
 	UseDrawShader(ScreenMode());
+	BeginDrawList();
 	Disk(s, size, color);
 	for (int i = 0, nRays = 8; i < nRays; i++) {
 		float a = 3.1415f*(float)i/nRays;
@@ -568,6 +975,7 @@ void Star(vec3 p, float size, vec3 color) {
 		Line(s+r1*d, s+r2*d, w, c);
 		Line(s-r1*d, s-r2*d, w, c);
 	}
+	EndDrawList();
 	UseDrawShader(mSave);
 }
 
@@ -578,6 +986,7 @@ void Star(vec3 p, float size, vec3 colorVisible, vec3 colorHidden) {
 // Arrows
 
 void Arrow(vec2 base, vec2 head, vec3 col, float lineWidth, double headSize) {
+	BeginDrawList();
 	Line(base, head, lineWidth, col);
 	if (headSize > 0) {
 		vec2 v1 = (float)headSize*normalize(head-base), v2(v1.y/2.f, -v1.x/2.f);
@@ -585,6 +994,7 @@ void Arrow(vec2 base, vec2 head, vec3 col, float lineWidth, double headSize) {
 		Line(head, head1, lineWidth, col);
 		Line(head, head2, lineWidth, col);
 	}
+	EndDrawList();
 }
 
 vec3 ProjectToLine(vec3 p, vec3 p1, vec3 p2) {
@@ -613,26 +1023,58 @@ void ArrowV(vec3 base, vec3 v, mat4 modelview, mat4 persp, vec3 col, float lineW
 	// col = zbase > zhead? vec3(0,1,0) : vec3(0,0,1);
 	// could draw in screen mode, using base2, head2, h1, & h2, but prefer draw in 3D (allows for depth test)
 	UseDrawShader(m);
+	BeginDrawList();
 	Line(base, head, lineWidth, col);
 	PointScreen(head, h1, modelview, persp, lineWidth, col);
 	PointScreen(head, h2, modelview, persp, lineWidth, col);
+	EndDrawList();
 }
 
 // Cylinders
+// one patch per instance; endpoints, radii, and color are per-instance attributes
 
 const char *cylVShader = R"(
 	#version 410 core
-	void main() { gl_Position = vec4(0); }
+	in vec4 end1, end2;					// xyz: endpoint, w: radius
+	in vec4 color;
+	out vec4 vEnd1, vEnd2, vColor;
+	void main() {
+		vEnd1 = end1;
+		vEnd2 = end2;
+		vColor = color;
+		gl_Position = vec4(0);
+	}
 )";
 
 const char *cylTCShader = R"(
 	#version 410 core
 	layout (vertices = 4) out;
+	in vec4 vEnd1[], vEnd2[], vColor[];
+	patch out vec4 tcEnd1, tcEnd2, tcColor;
+	uniform mat4 modelview;
+	uniform mat4 persp;
+	uniform float viewportHeight = 600;
+	uniform float pixelsPerSide = 4;
+	uniform float maxSides = 48;
 	void main() {
 		if (gl_InvocationID == 0) {
+			tcEnd1 = vEnd1[0];
+			tcEnd2 = vEnd2[0];
+			tcColor = vColor[0];
+			// sides around from screen-space radius at nearer end; a patch with outer level 0 is culled
+			float w1 = (persp*modelview*vec4(vEnd1[0].xyz, 1)).w;
+			float w2 = (persp*modelview*vec4(vEnd2[0].xyz, 1)).w;
+			float sides = maxSides;
+			if (w1 <= 0 && w2 <= 0)
+				sides = 0;
+			else if (w1 > 0 && w2 > 0) {
+				float r = max(vEnd1[0].w, vEnd2[0].w)*persp[1][1]*viewportHeight/(2*min(w1, w2));
+				sides = clamp(6.2832*r/pixelsPerSide, 4., maxSides);
+			}
 			gl_TessLevelOuter[0] = gl_TessLevelOuter[2] = 1;
-			gl_TessLevelOuter[1] = gl_TessLevelOuter[3] = 24;
-			gl_TessLevelInner[0] = gl_TessLevelInner[1] = 24;
+			gl_TessLevelOuter[1] = gl_TessLevelOuter[3] = sides;
+			gl_TessLevelInner[0] = sides;
+			gl_TessLevelInner[1] = 1;
 		}
 	}
 )";
@@ -640,25 +1082,26 @@ const char *cylTCShader = R"(
 const char *cylTEShader = R"(
 	#version 410 core
 	layout (quads, equal_spacing, ccw) in;
-	uniform vec3 p1;
-	uniform vec3 p2;
-	uniform float r1;
-	uniform float r2;
+	patch in vec4 tcEnd1, tcEnd2, tcColor;
 	uniform mat4 modelview;
 	uniform mat4 persp;
 	out vec3 tePoint;
 	out vec3 teNormal;
+	out vec4 teColor;
 	void main() {
 		vec2 uv = gl_TessCoord.st;
 		float c = cos(2*3.1415*uv.s), s = sin(2*3.1415*uv.s);
-		vec3 dp = p2-p1;
-		vec3 crosser = dp.x < dp.y? (dp.x < dp.z? vec3(1,0,0) : vec3(0,0,1)) : (dp.y < dp.z? vec3(0,1,0) : vec3(0,0,1));
+		vec3 p1 = tcEnd1.xyz, p2 = tcEnd2.xyz, dp = p2-p1, a = abs(dp);
+		float r1 = tcEnd1.w, r2 = tcEnd2.w, len = max(length(dp), 1e-6);
+		vec3 crosser = a.x < a.y? (a.x < a.z? vec3(1,0,0) : vec3(0,0,1)) : (a.y < a.z? vec3(0,1,0) : vec3(0,0,1));
 		vec3 xcross = normalize(cross(crosser, dp));
 		vec3 ycross = normalize(cross(xcross, dp));
 		vec3 n = c*xcross+s*ycross;
 		vec3 p = mix(p1, p2, uv.t)+mix(r1, r2, uv.t)*n;
+		vec3 normal = len*n+(r1-r2)*dp/len;	// tilted for cones
 		tePoint = (modelview*vec4(p, 1)).xyz;
-		teNormal = (modelview*vec4(n, 0)).xyz;
+		teNormal = (modelview*vec4(normal, 0)).xyz;
+		teColor = tcColor;
 		gl_Position = persp*vec4(tePoint, 1);
 	}
 )";
@@ -667,8 +1110,8 @@ const char *cylPShader = R"(
 	#version 410 core //130
 	in vec3 tePoint;
 	in vec3 teNormal;
+	in vec4 teColor;
 	out vec4 pColor;
-	uniform vec4 color;
 	uniform vec3 light;
 	void main() {
 		vec3 N = normalize(teNormal);      // surface normal
@@ -678,31 +1121,74 @@ const char *cylPShader = R"(
 		float d = abs(dot(N, L));          // two-sided diffuse
 		float s = abs(dot(R, E));          // two-sided specular
 		float intensity = clamp(d+pow(s, 50), 0, 1);
-		pColor = intensity*color;
+		pColor = vec4(intensity*teColor.rgb, teColor.a);
 	}
 )";
 
-GLuint cylinderShader = 0;
-
-void Cylinder(vec3 p1, vec3 p2, float r1, float r2, mat4 modelview, mat4 persp, vec4 color) {
-	if (!cylinderShader)
-		cylinderShader = LinkProgramViaCode(&cylVShader, &cylTCShader, &cylTEShader, NULL, &cylPShader);
-	//	cylinderShader = LinkProgramViaCode(&vShader, NULL, &teShader, NULL, &pShader);
-	glUseProgram(cylinderShader);
-	SetUniform(cylinderShader, "modelview", modelview);
-	SetUniform(cylinderShader, "persp", persp);
-	SetUniform(cylinderShader, "color", color);
-	SetUniform(cylinderShader, "p1", p1);
-	SetUniform(cylinderShader, "p2", p2);
-	SetUniform(cylinderShader, "r1", r1);
-	SetUniform(cylinderShader, "r2", r2);
-	// float r = 24, outerLevels[] = {1, r, 1, r}, innerLevels[] = {r, r};
-	// glPatchParameteri(GL_PATCH_VERTICES, 4);
-	// glPatchParameterfv(GL_PATCH_DEFAULT_OUTER_LEVEL, outerLevels);
-	// glPatchParameterfv(GL_PATCH_DEFAULT_INNER_LEVEL, innerLevels);
+static bool cylinderRegistered = RegisterProgram("Cylinders", &cylVShader, &cylTCShader, &cylTEShader, NULL, &cylPShader);
+
+GLuint cylinderShader = 0, cylinderVao = 0, cylinderBuffer = 0;
+int cylinderCapacity = 0;							// bytes allocated in cylinderBuffer
+
+void Cylinders(const CylinderInstance *instances, int nInstances, mat4 modelview, mat4 persp) {
+	FlushDrawList();
+	if (nInstances <= 0)
+		return;
+	GLuint program = GetCylinderShader();
+	if (!cylinderVao) {
+		glGenVertexArrays(1, &cylinderVao);
+		glGenBuffers(1, &cylinderBuffer);
+		glBindVertexArray(cylinderVao);
+		glBindBuffer(GL_ARRAY_BUFFER, cylinderBuffer);
+		const char *names[] = { "end1", "end2", "color" };
+		for (int i = 0; i < 3; i++) {
+			VertexAttribPointer(program, names[i], 4, sizeof(CylinderInstance), (void *) (i*sizeof(vec4)));
+			GLint id = glGetAttribLocation(program, names[i]);
+			if (id >= 0)
+				glVertexAttribDivisor(id, 1);
+		}
+	}
+	glBindVertexArray(cylinderVao);
+	glBindBuffer(GL_ARRAY_BUFFER, cylinderBuffer);
+	int nBytes = nInstances*sizeof(CylinderInstance);
+	if (nBytes > cylinderCapacity)
+		cylinderCapacity = std::max(nBytes+nBytes/2, 256*(int) sizeof(CylinderInstance));
+	glBufferData(GL_ARRAY_BUFFER, cylinderCapacity, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, nBytes, instances);
+	glUseProgram(program);
+	SetUniform(program, "modelview", modelview);
+	SetUniform(program, "persp", persp);
+	SetUniform(program, "viewportHeight", (float) VPh());
 #ifdef GL_PATCHES
-	glDrawArrays(GL_PATCHES, 0, 4);
+	glPatchParameteri(GL_PATCH_VERTICES, 4);
+	glDrawArraysInstanced(GL_PATCHES, 0, 4, nInstances);
 #endif
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Cylinder(vec3 p1, vec3 p2, float r1, float r2, mat4 modelview, mat4 persp, vec4 color) {
+	CylinderInstance c(p1, p2, r1, r2, color);
+	Cylinders(&c, 1, modelview, persp);
+}
+
+void Arrows(const ArrowInstance *arrows, int nArrows, mat4 modelview, mat4 persp, float headLength, float headRadius) {
+	static std::vector<CylinderInstance> cylinders;	// reused, to avoid allocation per call
+	cylinders.resize(0);
+	for (int i = 0; i < nArrows; i++) {
+		const ArrowInstance &a = arrows[i];
+		vec3 neck = a.head+headLength*(a.base-a.head);
+		cylinders.push_back(CylinderInstance(a.base, neck, a.radius, a.radius, a.color));
+		cylinders.push_back(CylinderInstance(neck, a.head, headRadius*a.radius, 0, a.color));
+	}
+	Cylinders(cylinders.data(), (int) cylinders.size(), modelview, persp);
+}
+
+void Cylinders(const std::vector<CylinderInstance> &instances, mat4 modelview, mat4 persp) {
+	Cylinders(instances.data(), (int) instances.size(), modelview, persp);
+}
+
+void Arrows(const std::vector<ArrowInstance> &arrows, mat4 modelview, mat4 persp, float headLength, float headRadius) {
+	Arrows(arrows.data(), (int) arrows.size(), modelview, persp, headLength, headRadius);
 }
 
 GLuint GetCylinderShader() {
@@ -719,7 +1205,7 @@ GLuint GetDrawShader() {
 
 // Triangles with optional outline
 
-GLuint triShader = 0, triVBO = 0, triVAO = 0;
+GLuint triShader = 0;
 
 // vertex shader
 const char *triVShaderCode = R"(
@@ -791,6 +1277,8 @@ const char *triPShaderCode = R"(
 	}
 )";
 
+static bool triRegistered = RegisterProgram("Triangles", &triVShaderCode, NULL, NULL, &triGShaderCode, &triPShaderCode);
+
 GLuint GetTriangleShader() {
 	if (!triShader)
 		triShader = LinkProgramViaCode(&triVShaderCode, NULL, NULL, &triGShaderCode, &triPShaderCode);
@@ -812,40 +1300,22 @@ GLuint UseTriangleShader() {
 
 GLuint UseTriangleShader(mat4 view) {
 	GLuint s = UseTriangleShader();
+	triView = view;
 	SetUniform(triShader, "view", view);
 	return s;
 }
 
 void Triangle(vec3 p1, vec3 p2, vec3 p3, vec3 c1, vec3 c2, vec3 c3,
 			  float opacity, bool outline, vec4 outlineCol, float outlineWidth, float transition) {
-	vec3 data[] = { p1, p2, p3, c1, c2, c3 };
-	UseTriangleShader();
-	if (triVBO == 0) {
-		glGenVertexArrays(1, &triVAO);
-		glGenBuffers(1, &triVBO);
-		glBindVertexArray(triVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, triVBO);
-		glBufferData(GL_ARRAY_BUFFER, 3*sizeof(vec3), NULL, GL_STATIC_DRAW);
-	}
-	glBindVertexArray(triVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, triVBO);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, 3*sizeof(vec3), data);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(data), data, GL_STATIC_DRAW);
-	VertexAttribPointer(triShader, "point", 3, 0, (void *) 0);
-	VertexAttribPointer(triShader, "color", 3, 0, (void *) (3*sizeof(vec3)));
-	SetUniform(triShader, "viewptM", Viewport()); // **** ????
-	SetUniform(triShader, "opacity", opacity);
-	SetUniform(triShader, "outlineOn", outline? 1 : 0);
-	SetUniform(triShader, "outlineColor", outlineCol);
-	SetUniform(triShader, "outlineWidth", outlineWidth);
-	SetUniform(triShader, "transition", transition);
-	glDrawArrays(GL_TRIANGLES, 0, 3);
+	CurrentDrawList().Triangle(p1, p2, p3, c1, c2, c3, opacity, outline, outlineCol, outlineWidth, transition);
+	FlushIfImmediate();
 }
 
 // Boxes
 
 void Box(vec3 a, vec3 b, float width, vec3 col) {
 	float x1=a.x, x2=b.x, y1=a.y, y2=b.y, z1=a.z, z2=b.z;
+	BeginDrawList();
 	// left-right
 	Line(vec3(x1,y1,z1), vec3(x2,y1,z1), width, col);
 	Line(vec3(x1,y2,z1), vec3(x2,y2,z1), width, col);
@@ -861,4 +1331,5 @@ void Box(vec3 a, vec3 b, float width, vec3 col) {
 	Line(vec3(x1,y2,z1), vec3(x1,y2,z2), width, col);
 	Line(vec3(x2,y1,z1), vec3(x2,y1,z2), width, col);
 	Line(vec3(x2,y2,z1), vec3(x2,y2,z2), width, col);
+	EndDrawList();
 }
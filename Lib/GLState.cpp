@@ -0,0 +1,310 @@
+// GLState.cpp - shadow of frequently set OpenGL state: skip redundant changes, answer queries locally
+
+#include <stdio.h>
+#include "GLState.h"
+
+namespace {
+
+const int Unknown = -1;
+
+// Statistics
+
+enum Category { ProgramCategory, VertexArrayCategory, BufferCategory, TextureCategory,
+				EnableCategory, BlendCategory, ViewportCategory, QueryCategory, nCategories };
+const char *categoryNames[] = { "program", "vertex array", "buffer", "texture", "enable", "blend", "viewport", "query" };
+GLStateCount counts[nCategories];
+
+bool Redundant(Category c, bool same) {
+	counts[c].calls++;
+	if (same)
+		counts[c].redundant++;
+	return same;
+}
+
+// Driver Entry Points (as loaded by glad)
+
+struct {
+	PFNGLUSEPROGRAMPROC UseProgram;
+	PFNGLDELETEPROGRAMPROC DeleteProgram;
+	PFNGLBINDVERTEXARRAYPROC BindVertexArray;
+	PFNGLDELETEVERTEXARRAYSPROC DeleteVertexArrays;
+	PFNGLBINDBUFFERPROC BindBuffer;
+	PFNGLBINDBUFFERBASEPROC BindBufferBase;
+	PFNGLBINDBUFFERRANGEPROC BindBufferRange;
+	PFNGLDELETEBUFFERSPROC DeleteBuffers;
+	PFNGLACTIVETEXTUREPROC ActiveTexture;
+	PFNGLBINDTEXTUREPROC BindTexture;
+	PFNGLDELETETEXTURESPROC DeleteTextures;
+	PFNGLENABLEPROC Enable;
+	PFNGLDISABLEPROC Disable;
+	PFNGLISENABLEDPROC IsEnabled;
+	PFNGLBLENDFUNCPROC BlendFunc;
+	PFNGLVIEWPORTPROC Viewport;
+} driver;
+
+// Cached State (Unknown until set or queried)
+
+GLenum bufferTargets[] = { GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER,
+	GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_DRAW_INDIRECT_BUFFER,
+	GL_DISPATCH_INDIRECT_BUFFER, GL_TEXTURE_BUFFER, GL_ATOMIC_COUNTER_BUFFER, GL_TRANSFORM_FEEDBACK_BUFFER };
+GLenum textureTargets[] = { GL_TEXTURE_1D, GL_TEXTURE_2D, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_1D_ARRAY,
+	GL_TEXTURE_2D_ARRAY, GL_TEXTURE_RECTANGLE, GL_TEXTURE_BUFFER, GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_CUBE_MAP_ARRAY };
+GLenum capabilities[] = { GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST, GL_STENCIL_TEST, GL_MULTISAMPLE,
+	GL_LINE_SMOOTH, GL_POLYGON_SMOOTH, GL_POLYGON_OFFSET_FILL, GL_PROGRAM_POINT_SIZE, GL_PRIMITIVE_RESTART,
+	GL_FRAMEBUFFER_SRGB, GL_TEXTURE_CUBE_MAP_SEAMLESS };
+const int nBufferTargets = sizeof(bufferTargets)/sizeof(GLenum);
+const int nTextureTargets = sizeof(textureTargets)/sizeof(GLenum);
+const int nCapabilities = sizeof(capabilities)/sizeof(GLenum);
+const int nTextureUnits = 32;				// units above this are passed through
+const int elementBuffer = 1;				// index of GL_ELEMENT_ARRAY_BUFFER (part of vertex array state)
+
+int program, vertexArray, activeUnit, blendSrc, blendDst;
+int buffers[nBufferTargets];
+int textures[nTextureUnits][nTextureTargets];
+int enabled[nCapabilities];
+int4 viewport;
+bool viewportKnown = false;
+
+int Find(GLenum *list, int n, GLenum e) {
+	for (int i = 0; i < n; i++)
+		if (list[i] == e)
+			return i;
+	return -1;
+}
+
+// Shadowed Calls
+
+void APIENTRY ShadowUseProgram(GLuint p) {
+	if (Redundant(ProgramCategory, program == (int) p))
+		return;
+	program = p;
+	driver.UseProgram(p);
+}
+
+void APIENTRY ShadowDeleteProgram(GLuint p) {
+	if (program == (int) p)
+		program = Unknown;					// remains in use until replaced
+	driver.DeleteProgram(p);
+}
+
+void APIENTRY ShadowBindVertexArray(GLuint v) {
+	if (Redundant(VertexArrayCategory, vertexArray == (int) v))
+		return;
+	vertexArray = v;
+	buffers[elementBuffer] = Unknown;
+	driver.BindVertexArray(v);
+}
+
+void APIENTRY ShadowDeleteVertexArrays(GLsizei n, const GLuint *names) {
+	for (int i = 0; i < n; i++)
+		if (vertexArray == (int) names[i]) {
+			vertexArray = 0;
+			buffers[elementBuffer] = Unknown;
+		}
+	driver.DeleteVertexArrays(n, names);
+}
+
+void APIENTRY ShadowBindBuffer(GLenum target, GLuint b) {
+	int t = Find(bufferTargets, nBufferTargets, target);
+	if (t >= 0 && Redundant(BufferCategory, buffers[t] == (int) b))
+		return;
+	if (t >= 0)
+		buffers[t] = b;
+	driver.BindBuffer(target, b);
+}
+
+void APIENTRY ShadowBindBufferBase(GLenum target, GLuint index, GLuint b) {
+	// also binds the generic target
+	int t = Find(bufferTargets, nBufferTargets, target);
+	if (t >= 0)
+		buffers[t] = b;
+	driver.BindBufferBase(target, index, b);
+}
+
+void APIENTRY ShadowBindBufferRange(GLenum target, GLuint index, GLuint b, GLintptr offset, GLsizeiptr size) {
+	int t = Find(bufferTargets, nBufferTargets, target);
+	if (t >= 0)
+		buffers[t] = b;
+	driver.BindBufferRange(target, index, b, offset, size);
+}
+
+void APIENTRY ShadowDeleteBuffers(GLsizei n, const GLuint *names) {
+	// bindings to deleted buffers revert to 0
+	for (int i = 0; i < n; i++)
+		for (int t = 0; t < nBufferTargets; t++)
+			if (buffers[t] == (int) names[i])
+				buffers[t] = 0;
+	driver.DeleteBuffers(n, names);
+}
+
+void APIENTRY ShadowActiveTexture(GLenum unit) {
+	int u = unit-GL_TEXTURE0;
+	if (Redundant(TextureCategory, activeUnit == u))
+		return;
+	activeUnit = u;
+	driver.ActiveTexture(unit);
+}
+
+void APIENTRY ShadowBindTexture(GLenum target, GLuint texture) {
+	if (activeUnit == Unknown) {
+		GLint unit = GL_TEXTURE0;
+		glGetIntegerv(GL_ACTIVE_TEXTURE, &unit);
+		activeUnit = unit-GL_TEXTURE0;
+	}
+	int t = Find(textureTargets, nTextureTargets, target);
+	bool cached = t >= 0 && activeUnit < nTextureUnits;
+	if (cached && Redundant(TextureCategory, textures[activeUnit][t] == (int) texture))
+		return;
+	if (cached)
+		textures[activeUnit][t] = texture;
+	driver.BindTexture(target, texture);
+}
+
+void APIENTRY ShadowDeleteTextures(GLsizei n, const GLuint *names) {
+	for (int i = 0; i < n; i++)
+		for (int u = 0; u < nTextureUnits; u++)
+			for (int t = 0; t < nTextureTargets; t++)
+				if (textures[u][t] == (int) names[i])
+					textures[u][t] = 0;
+	driver.DeleteTextures(n, names);
+}
+
+void APIENTRY ShadowEnable(GLenum cap) {
+	int c = Find(capabilities, nCapabilities, cap);
+	if (c >= 0 && Redundant(EnableCategory, enabled[c] == 1))
+		return;
+	if (c >= 0)
+		enabled[c] = 1;
+	driver.Enable(cap);
+}
+
+void APIENTRY ShadowDisable(GLenum cap) {
+	int c = Find(capabilities, nCapabilities, cap);
+	if (c >= 0 && Redundant(EnableCategory, enabled[c] == 0))
+		return;
+	if (c >= 0)
+		enabled[c] = 0;
+	driver.Disable(cap);
+}
+
+GLboolean APIENTRY ShadowIsEnabled(GLenum cap) {
+	int c = Find(capabilities, nCapabilities, cap);
+	if (c < 0)
+		return driver.IsEnabled(cap);
+	if (!Redundant(QueryCategory, enabled[c] != Unknown))
+		enabled[c] = driver.IsEnabled(cap)? 1 : 0;
+	return enabled[c] == 1;
+}
+
+void APIENTRY ShadowBlendFunc(GLenum src, GLenum dst) {
+	if (Redundant(BlendCategory, blendSrc == (int) src && blendDst == (int) dst))
+		return;
+	blendSrc = src;
+	blendDst = dst;
+	driver.BlendFunc(src, dst);
+}
+
+void APIENTRY ShadowViewport(GLint x, GLint y, GLsizei w, GLsizei h) {
+	if (Redundant(ViewportCategory, viewportKnown && viewport == int4(x, y, w, h)))
+		return;
+	viewport = int4(x, y, w, h);
+	viewportKnown = true;
+	driver.Viewport(x, y, w, h);
+}
+
+bool Shadowing() { return glad_glUseProgram == ShadowUseProgram; }
+
+} // end namespace
+
+// Installation
+
+void InvalidateGLState() {
+	program = vertexArray = activeUnit = blendSrc = blendDst = Unknown;
+	for (int t = 0; t < nBufferTargets; t++)
+		buffers[t] = Unknown;
+	for (int u = 0; u < nTextureUnits; u++)
+		for (int t = 0; t < nTextureTargets; t++)
+			textures[u][t] = Unknown;
+	for (int c = 0; c < nCapabilities; c++)
+		enabled[c] = Unknown;
+	viewportKnown = false;
+}
+
+#define SHADOW(name) driver.name = glad_gl##name; glad_gl##name = Shadow##name;
+#define RESTORE(name) glad_gl##name = driver.name;
+
+void ShadowGLState(bool on) {
+	// if glad has (re)loaded since the last call, its entry points are the driver's
+	if (on && !Shadowing()) {
+		SHADOW(UseProgram) SHADOW(DeleteProgram) SHADOW(BindVertexArray) SHADOW(DeleteVertexArrays)
+		SHADOW(BindBuffer) SHADOW(BindBufferBase) SHADOW(BindBufferRange) SHADOW(DeleteBuffers)
+		SHADOW(ActiveTexture) SHADOW(BindTexture) SHADOW(DeleteTextures)
+		SHADOW(Enable) SHADOW(Disable) SHADOW(IsEnabled) SHADOW(BlendFunc) SHADOW(Viewport)
+		InvalidateGLState();
+	}
+	if (!on && Shadowing()) {
+		RESTORE(UseProgram) RESTORE(DeleteProgram) RESTORE(BindVertexArray) RESTORE(DeleteVertexArrays)
+		RESTORE(BindBuffer) RESTORE(BindBufferBase) RESTORE(BindBufferRange) RESTORE(DeleteBuffers)
+		RESTORE(ActiveTexture) RESTORE(BindTexture) RESTORE(DeleteTextures)
+		RESTORE(Enable) RESTORE(Disable) RESTORE(IsEnabled) RESTORE(BlendFunc) RESTORE(Viewport)
+	}
+}
+
+// Queries
+
+int4 ShadowedViewport() {
+	if (Shadowing() && Redundant(QueryCategory, viewportKnown))
+		return viewport;
+	int4 vp;
+	glGetIntegerv(GL_VIEWPORT, (int *) &vp);
+	if (Shadowing()) {
+		viewport = vp;
+		viewportKnown = true;
+	}
+	return vp;
+}
+
+GLuint ShadowedProgram() {
+	if (Shadowing() && Redundant(QueryCategory, program != Unknown))
+		return program;
+	int p = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &p);
+	if (Shadowing())
+		program = p;
+	return p;
+}
+
+GLuint ShadowedVertexArray() {
+	if (Shadowing() && Redundant(QueryCategory, vertexArray != Unknown))
+		return vertexArray;
+	int v = 0;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &v);
+	if (Shadowing())
+		vertexArray = v;
+	return v;
+}
+
+// Statistics
+
+GLStateCount GLStateCounts() {
+	GLStateCount total;
+	for (int c = 0; c < nCategories; c++) {
+		total.calls += counts[c].calls;
+		total.redundant += counts[c].redundant;
+	}
+	return total;
+}
+
+void ResetGLStateCounts() {
+	for (int c = 0; c < nCategories; c++)
+		counts[c] = GLStateCount();
+}
+
+void PrintGLStateCounts() {
+	GLStateCount total = GLStateCounts();
+	printf("GL state: %i calls, %i redundant (%i%%)\n", total.calls, total.redundant,
+		   total.calls? (100*total.redundant)/total.calls : 0);
+	for (int c = 0; c < nCategories; c++)
+		if (counts[c].calls)
+			printf("  %s: %i calls, %i redundant\n", categoryNames[c], counts[c].calls, counts[c].redundant);
+}
@@ -1,10 +1,19 @@
 // GLXtras.cpp - GLSL support (c) 2019-2022 Jules Bloomenthal
 
 #include <glad.h>
+#include "GLState.h"
 #include "GLXtras.h"
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
 #include <vector>
+#ifdef _WIN32
+	#include <direct.h>
+#else
+	#include <sys/stat.h>
+#endif
 
 namespace {
 
@@ -76,6 +85,7 @@ GLFWwindow *InitGLFW(int x, int y, int width, int height, const char *title, boo
 		glfwMakeContextCurrent(w);
 		glfwSwapInterval(1);
 		gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
+		ShadowGLState();
 	}
 	return w;
 }
@@ -279,17 +289,396 @@ GLuint CompileShaderViaCode(const char **code, GLint type) {
 	return shader;
 }
 
+// Program Cache
+
+namespace {
+
+std::string cacheDirectory = "ShaderCache";
+bool cacheEnabled = true, cacheChecked = false;
+ProgramCacheCount cacheCounts;
+
+bool CacheAvailable() {
+	if (cacheEnabled && !cacheChecked) {
+		// driver must support at least one binary format
+		GLint nFormats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nFormats);
+		if (nFormats < 1)
+			cacheEnabled = false;
+		else {
+#ifdef _WIN32
+			_mkdir(cacheDirectory.c_str());
+#else
+			mkdir(cacheDirectory.c_str(), 0755);
+#endif
+		}
+		cacheChecked = true;
+	}
+	return cacheEnabled;
+}
+
+void Hash(unsigned long long &h, const char *s) {
+	// FNV-1a, including terminator so that concatenations differ
+	for (const char *c = s? s : ""; ; c++) {
+		h = (h^(unsigned char) *c)*1099511628211ull;
+		if (!*c)
+			break;
+	}
+}
+
+std::string CacheFile(const char **stages[], int nStages) {
+	// key: stage sources (null stages included) and driver identification
+	unsigned long long h = 14695981039346656037ull;
+	Hash(h, (const char *) glGetString(GL_VENDOR));
+	Hash(h, (const char *) glGetString(GL_RENDERER));
+	Hash(h, (const char *) glGetString(GL_VERSION));
+	for (int i = 0; i < nStages; i++)
+		Hash(h, stages[i]? *stages[i] : NULL);
+	char name[40];
+	snprintf(name, 40, "/%016llx.bin", h);
+	return cacheDirectory+name;
+}
+
+} // end namespace
+
+void SetProgramCache(const char *directory, bool enable) {
+	cacheDirectory = directory? directory : "ShaderCache";
+	cacheEnabled = enable;
+	cacheChecked = false;
+}
+
+ProgramCacheCount ProgramCacheCounts() { return cacheCounts; }
+
+void PrintProgramCacheCounts() {
+	printf("program cache (%s): %i loaded, %i compiled", cacheDirectory.c_str(), cacheCounts.hits, cacheCounts.misses);
+	if (cacheCounts.rejected)
+		printf(" (%i stale binaries)", cacheCounts.rejected);
+	printf("\n");
+}
+
+// Program Builds
+// a build is submitted (binary loaded, or shaders compiled and program linked) without querying
+// status; status is queried when the program is claimed by LinkProgramViaCode, or polled by
+// ShadersReady, so that, with parallel compilation, the driver works while the application continues
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+typedef void (APIENTRY *MaxShaderCompilerThreadsProc)(GLuint count);
+const GLenum completionStatus = 0x91B1;				// GL_COMPLETION_STATUS_KHR (and _ARB)
+bool parallelChecked = false, parallelCompile = false;
+
+bool ParallelCompile() {
+	// GL_KHR_parallel_shader_compile (or ARB) is not in glad, so its entry point is loaded here
+	if (!parallelChecked) {
+		parallelChecked = true;
+		const char *proc = NULL;
+		GLint n = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+		for (int i = 0; i < n && !proc; i++) {
+			const char *e = (const char *) glGetStringi(GL_EXTENSIONS, i);
+			if (e && !strcmp(e, "GL_KHR_parallel_shader_compile")) proc = "glMaxShaderCompilerThreadsKHR";
+			if (e && !strcmp(e, "GL_ARB_parallel_shader_compile")) proc = "glMaxShaderCompilerThreadsARB";
+		}
+		MaxShaderCompilerThreadsProc maxThreads = proc? (MaxShaderCompilerThreadsProc) glfwGetProcAddress(proc) : NULL;
+		if (maxThreads) {
+			maxThreads(0xFFFFFFFF);						// as many threads as the driver likes
+			parallelCompile = true;
+		}
+	}
+	return parallelCompile;
+}
+
+const int nStages = 5;								// vertex, tess control, tess eval, geometry, pixel
+
+struct ProgramBuild {
+	std::string name, file;							// file: program cache binary, if caching
+	const char **stages[nStages] = { NULL, NULL, NULL, NULL, NULL };
+	bool compute = false;							// if so, stages[0] is compute code
+	GLuint program = 0, shaders[nStages] = { 0, 0, 0, 0, 0 };
+	bool fromCache = false, finished = false;
+	Clock::time_point start;
+	float submitMs = 0;
+};
+
+struct Registration {
+	std::string name;
+	const char **stages[nStages];
+	bool compute, submitted;
+};
+
+struct ProgramTime {
+	std::string name;
+	bool fromCache;
+	float submit, finished, blocked;				// ms: in submit, from submit until finished, waiting
+		// finished when claimed by LinkProgramViaCode or found complete by ShadersReady, which may
+		// be well after the driver completed it
+};
+
+std::vector<Registration> &Registry() {
+	// constructed on first use: registration happens during static initialization
+	static std::vector<Registration> registry;
+	return registry;
+}
+
+std::vector<ProgramBuild> builds;					// submitted, not yet claimed
+std::vector<ProgramTime> programTimes;
+
+float Ms(Clock::time_point since) {
+	return std::chrono::duration<float, std::milli>(Clock::now()-since).count();
+}
+
+bool SameStages(const char **a[], const char **b[]) {
+	for (int i = 0; i < nStages; i++)
+		if (a[i] != b[i])
+			return false;
+	return true;
+}
+
+int GlslVersion(const char *code) {
+	// from #version directive, eg 430; 110 if none
+	const char *v = code? strstr(code, "#version") : NULL;
+	return v? atoi(v+8) : 110;
+}
+
+int ContextGlslVersion() {
+	static int version = 0;
+	if (!version) {
+		const char *s = (const char *) glGetString(GL_SHADING_LANGUAGE_VERSION);
+		int major = 0, minor = 0;
+		if (s && sscanf(s, "%d.%d", &major, &minor) == 2)
+			version = 100*major+minor;
+		else
+			version = 330;
+	}
+	return version;
+}
+
+void PrintShaderLog(GLuint shader) {
+	GLint logLen;
+	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLen);
+	if (logLen > 0) {
+		GLsizei written;
+		char *log = new char[logLen];
+		glGetShaderInfoLog(shader, logLen, &written, log);
+		printf("compilation failed: %s", log);
+		delete [] log;
+	}
+	else printf("shader compilation failed\n");
+}
+
+void SubmitCompile(ProgramBuild &b) {
+	static const GLenum types[] = { GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER };
+	b.program = glCreateProgram();
+	if (!b.file.empty())
+		glProgramParameteri(b.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	for (int i = 0; i < nStages; i++)
+		if (b.stages[i]) {
+			GLuint s = glCreateShader(b.compute? GL_COMPUTE_SHADER : types[i]);
+			glShaderSource(s, 1, b.stages[i], NULL);
+			glCompileShader(s);
+			glAttachShader(b.program, s);
+			b.shaders[i] = s;
+		}
+	glLinkProgram(b.program);
+	b.fromCache = false;
+}
+
+void Submit(ProgramBuild &b) {
+	b.start = Clock::now();
+	if (CacheAvailable()) {
+		b.file = CacheFile(b.stages, b.compute? 1 : nStages);
+		b.program = ReadProgramBinary(b.file.c_str());
+		b.fromCache = b.program != 0;
+	}
+	if (!b.program)
+		SubmitCompile(b);
+	b.submitMs = Ms(b.start);
+}
+
+bool Completed(ProgramBuild &b) {
+	// without parallel compilation there is no way to ask without waiting
+	GLint done = GL_TRUE;
+	if (ParallelCompile())
+		glGetProgramiv(b.program, completionStatus, &done);
+	return done == GL_TRUE;
+}
+
+GLuint Finish(ProgramBuild &b) {
+	// query status (waiting if incomplete), report errors, save binary; return program, 0 if compile failed
+	Clock::time_point t0 = Clock::now();
+	GLint status = GL_FALSE;
+	glGetProgramiv(b.program, GL_LINK_STATUS, &status);
+	if (b.fromCache && status == GL_FALSE) {
+		// binary from another driver build, or corrupt: compile instead (and overwrite)
+		while (glGetError() != GL_NO_ERROR)
+			;
+		glDeleteProgram(b.program);
+		cacheCounts.rejected++;
+		SubmitCompile(b);
+		glGetProgramiv(b.program, GL_LINK_STATUS, &status);
+	}
+	bool compiled = true;
+	for (int i = 0; i < nStages; i++)
+		if (GLuint s = b.shaders[i]) {
+			if (status == GL_FALSE) {
+				GLint result;
+				glGetShaderiv(s, GL_COMPILE_STATUS, &result);
+				if (result == GL_FALSE) {
+					printf("%s: ", b.name.c_str());
+					PrintShaderLog(s);
+					compiled = false;
+				}
+			}
+			glDetachShader(b.program, s);
+			glDeleteShader(s);
+			b.shaders[i] = 0;
+		}
+	if (status == GL_FALSE && compiled)
+		PrintProgramLog(b.program);
+	if (b.fromCache)
+		cacheCounts.hits++;
+	else if (!b.file.empty()) {
+		if (status == GL_TRUE)
+			WriteProgramBinary(b.program, b.file.c_str());
+		cacheCounts.misses++;
+	}
+	ProgramTime t = { b.name, b.fromCache, b.submitMs, Ms(b.start), Ms(t0) };
+	programTimes.push_back(t);
+	if (!compiled) {
+		glDeleteProgram(b.program);
+		b.program = 0;
+	}
+	b.finished = true;
+	return b.program;
+}
+
+std::string RegisteredName(const char **stages[], bool compute) {
+	for (Registration &r : Registry())
+		if (r.compute == compute && SameStages(r.stages, stages)) {
+			r.submitted = true;
+			return r.name;
+		}
+	return "unregistered";
+}
+
+GLuint Claim(const char **stages[], bool compute) {
+	// return submitted program for stages (finishing it if need be), else build it now
+	for (size_t i = 0; i < builds.size(); i++)
+		if (builds[i].compute == compute && SameStages(builds[i].stages, stages)) {
+			ProgramBuild b = builds[i];
+			builds.erase(builds.begin()+i);
+			return b.finished? b.program : Finish(b);
+		}
+	ProgramBuild b;
+	b.name = RegisteredName(stages, compute);
+	b.compute = compute;
+	for (int i = 0; i < nStages; i++)
+		b.stages[i] = stages[i];
+	Submit(b);
+	return Finish(b);
+}
+
+} // end namespace
+
+bool RegisterProgram(const char *name, const char **vertexCode, const char **pixelCode) {
+	return RegisterProgram(name, vertexCode, NULL, NULL, NULL, pixelCode);
+}
+
+bool RegisterProgram(const char *name,
+					 const char **vertexCode,
+					 const char **tessellationControlCode,
+					 const char **tessellationEvalCode,
+					 const char **geometryCode,
+					 const char **pixelCode) {
+	Registration r = { name, { vertexCode, tessellationControlCode, tessellationEvalCode, geometryCode, pixelCode }, false, false };
+	Registry().push_back(r);
+	return true;
+}
+
+bool RegisterProgram(const char *name, const char **computeCode) {
+	Registration r = { name, { computeCode, NULL, NULL, NULL, NULL }, true, false };
+	Registry().push_back(r);
+	return true;
+}
+
+static bool Listed(const std::string &name, const std::vector<const char *> &names) {
+	for (const char *n : names)
+		if (name == n)
+			return true;
+	return false;
+}
+
+void WarmUpShaders(std::vector<const char *> names, bool wait) {
+	ParallelCompile();
+	int glsl = ContextGlslVersion();
+	for (Registration &r : Registry()) {
+		if (r.submitted || (!names.empty() && !Listed(r.name, names)))
+			continue;
+		int version = 0;
+		for (int i = 0; i < nStages; i++)
+			if (r.stages[i])
+				version = std::max(version, GlslVersion(*r.stages[i]));
+		if (version > glsl)
+			continue;									// not supported by context: leave to first use
+		ProgramBuild b;
+		b.name = r.name;
+		b.compute = r.compute;
+		for (int i = 0; i < nStages; i++)
+			b.stages[i] = r.stages[i];
+		Submit(b);
+		builds.push_back(b);
+		r.submitted = true;
+	}
+	if (wait)
+		for (ProgramBuild &b : builds)
+			if (!b.finished)
+				Finish(b);
+}
+
+bool ShadersReady() {
+	bool ready = true;
+	for (ProgramBuild &b : builds)
+		if (!b.finished) {
+			if (Completed(b))
+				Finish(b);
+			else
+				ready = false;
+		}
+	return ready;
+}
+
+void ReleaseUnclaimedShaders() {
+	for (ProgramBuild &b : builds)
+		if (b.finished)
+			glDeleteProgram(b.program);
+		else {
+			for (int i = 0; i < nStages; i++)
+				if (b.shaders[i]) {
+					glDetachShader(b.program, b.shaders[i]);
+					glDeleteShader(b.shaders[i]);
+				}
+			glDeleteProgram(b.program);
+		}
+	builds.resize(0);
+}
+
+void PrintShaderTimes() {
+	float submit = 0, blocked = 0;
+	printf("shader programs (%s compilation):\n", parallelCompile? "parallel" : "serial");
+	for (ProgramTime &t : programTimes) {
+		printf("  %-20s %s submit %5.1f, finished %6.1f, blocked %5.1f ms\n",
+			t.name.c_str(), t.fromCache? "binary  " : "compiled", t.submit, t.finished, t.blocked);
+		submit += t.submit;
+		blocked += t.blocked;
+	}
+	printf("  total submit %.1f ms, blocked %.1f ms\n", submit, blocked);
+}
+
 // Linking
 
 GLuint LinkProgramViaCode(const char **vertexCode, const char **pixelCode) {
-	GLuint vshader = CompileShaderViaCode(vertexCode, GL_VERTEX_SHADER);
-	GLuint pshader = CompileShaderViaCode(pixelCode, GL_FRAGMENT_SHADER);
-	GLuint p = LinkProgram(vshader, pshader);
-	glDetachShader(p, vshader);
-	glDetachShader(p, pshader);
-	glDeleteShader(vshader);
-	glDeleteShader(pshader);
-	return p;
+	return LinkProgramViaCode(vertexCode, NULL, NULL, NULL, pixelCode);
 }
 
 GLuint LinkProgramViaCode(const char **vertexCode,
@@ -297,18 +686,8 @@ GLuint LinkProgramViaCode(const char **vertexCode,
 						  const char **tessellationEvalCode,
 						  const char **geometryCode,
 						  const char **pixelCode) {
-	GLuint vshader = CompileShaderViaCode(vertexCode, GL_VERTEX_SHADER);
-	GLuint tcshader = 0;
-	GLuint teshader = 0;
-#ifdef GL_TESS_EVALUATION_SHADER
-	if (tessellationControlCode)
-		tcshader = CompileShaderViaCode(tessellationControlCode, GL_TESS_CONTROL_SHADER);
-	if (tessellationEvalCode)
-		teshader = CompileShaderViaCode(tessellationEvalCode, GL_TESS_EVALUATION_SHADER);
-#endif
-	GLuint gshader = geometryCode? CompileShaderViaCode(geometryCode, GL_GEOMETRY_SHADER) : 0;
-	GLuint pshader = CompileShaderViaCode(pixelCode, GL_FRAGMENT_SHADER);
-	return LinkProgram(vshader, tcshader, teshader, gshader, pshader);
+	const char **stages[] = { vertexCode, tessellationControlCode, tessellationEvalCode, geometryCode, pixelCode };
+	return Claim(stages, false);
 }
 
 #ifndef __APPLE_
@@ -326,9 +705,8 @@ void LinkProgramViaCode(GLuint computeProgram, const char **computeCode) {
 }
 
 GLuint LinkProgramViaCode(const char **computeCode) {
-	GLuint computeProgram = glCreateProgram();
-	LinkProgramViaCode(computeProgram, computeCode);
-	return computeProgram;
+	const char **stages[] = { computeCode, NULL, NULL, NULL, NULL };
+	return Claim(stages, true);
 }
 
 GLuint LinkProgramViaFile(const char *computeShaderFile) {
@@ -350,9 +728,15 @@ void WriteProgramBinary(GLuint program, const char *filename) {
 	GLenum binaryFormat = 0;
 	GLsizei sizeBinary = 0, sizeEnum = sizeof(GLenum);
 	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &sizeBinary);
+	if (sizeBinary <= 0)
+		return;
 	std::vector<unsigned char> data(sizeBinary); //	std::vector<std::byte>
 	glGetProgramBinary(program, sizeBinary, NULL, &binaryFormat, &data[0]);
 	FILE *out = fopen(filename, "wb");
+	if (!out) {
+		printf("can't write %s\n", filename);
+		return;
+	}
 	fwrite(&binaryFormat, sizeEnum, 1, out);
 	fwrite(&data[0], 1, sizeBinary, out);
 	fclose(out);
@@ -364,6 +748,10 @@ bool ReadProgramBinary(GLuint program, const char *filename) {
 		fseek(in, 0, SEEK_END);
 		long filesize = ftell(in);
 		int sizeEnum = sizeof(GLenum), sizeBinary = filesize-sizeEnum;
+		if (sizeBinary <= 0) {
+			fclose(in);
+			return false;
+		}
 		std::vector<unsigned char> data(sizeBinary);
 		GLenum binaryFormat;
 		fseek(in, 0, 0);
@@ -396,6 +784,8 @@ GLuint LinkProgram(GLuint vshader, GLuint tcshader, GLuint teshader, GLuint gsha
 	if (vshader && pshader)
 		program = glCreateProgram();
 	if (program > 0) {
+		if (cacheEnabled)
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 		// attach shaders to program
 		glAttachShader(program, vshader);
 		if (tcshader > 0) glAttachShader(program, tcshader);
@@ -420,9 +810,7 @@ GLuint LinkProgramViaFile(const char *vertexShaderFile, const char *pixelShaderF
 // Miscellany
 
 int CurrentProgram() {
-	int program = 0;
-	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
-	return program;
+	return ShadowedProgram();
 }
 
 void DeleteProgram(int program) {
@@ -435,6 +823,112 @@ void DeleteProgram(int program) {
 	glDeleteProgram(program);
 }
 
+// Buffer Uploads
+
+namespace {
+
+struct UploadRing {
+	GLuint buffer = 0;
+	char *mapped = NULL;
+	int size = 8 << 20, head = 0, fenceStart = 0;
+	bool failed = false;
+	struct Fence { int start, end; GLsync sync; };
+	std::vector<Fence> fences;					// oldest first
+	bool Init() {
+		if (buffer || failed)
+			return buffer != 0;
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glBufferStorage(GL_COPY_READ_BUFFER, size, NULL, flags);
+		mapped = (char *) glMapBufferRange(GL_COPY_READ_BUFFER, 0, size, flags);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		if (!mapped) {
+			printf("UploadBuffer: can't map staging ring, using glBufferSubData\n");
+			glDeleteBuffers(1, &buffer);
+			buffer = 0;
+			failed = true;
+		}
+		return buffer != 0;
+	}
+	void Release() {
+		for (size_t i = 0; i < fences.size(); i++)
+			glDeleteSync(fences[i].sync);
+		fences.resize(0);
+		if (buffer) {
+			glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+			glUnmapBuffer(GL_COPY_READ_BUFFER);
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+			glDeleteBuffers(1, &buffer);
+		}
+		buffer = 0;
+		mapped = NULL;
+		head = fenceStart = 0;
+	}
+	void FencePending() {
+		if (head > fenceStart)
+			fences.push_back({fenceStart, head, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+		fenceStart = head;
+	}
+	int Allocate(int n) {
+		// return offset of n bytes in ring, waiting on GPU if region still in use; -1 if too big or wait fails
+		n = (n+15) & ~15;
+		if (n > size)
+			return -1;
+		if (head+n > size) {
+			FencePending();
+			head = fenceStart = 0;
+		}
+		// fences pass in order, so waiting on the newest that overlaps [head, head+n) retires it and all
+		// older ones (including any stale, non-overlapping fence from the end of the previous lap)
+		int last = -1;
+		for (int i = 0; i < (int) fences.size(); i++)
+			if (fences[i].start < head+n && fences[i].end > head)
+				last = i;
+		if (last >= 0) {
+			GLenum status = glClientWaitSync(fences[last].sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);	// at most 1 sec
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				return -1;								// region may still be read: caller uses glBufferSubData
+			for (int i = 0; i <= last; i++)
+				glDeleteSync(fences[i].sync);
+			fences.erase(fences.begin(), fences.begin()+last+1);
+		}
+		int offset = head;
+		head += n;
+		return offset;
+	}
+} uploadRing;
+
+} // end namespace
+
+bool UploadBuffer(GLuint buffer, int offset, int nBytes, const void *data, bool persistent) {
+	if (nBytes <= 0)
+		return false;
+	int ringOffset = persistent && uploadRing.Init()? uploadRing.Allocate(nBytes) : -1;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (ringOffset >= 0) {
+		memcpy(uploadRing.mapped+ringOffset, data, nBytes);
+		glBindBuffer(GL_COPY_READ_BUFFER, uploadRing.buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, ringOffset, offset, nBytes);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	}
+	else
+		glBufferSubData(GL_COPY_WRITE_BUFFER, offset, nBytes, data);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	return true;
+}
+
+void FenceUploads() {
+	if (uploadRing.buffer)
+		uploadRing.FencePending();
+}
+
+void SetUploadRingSize(int nBytes) {
+	uploadRing.Release();
+	uploadRing.size = nBytes;
+	uploadRing.failed = false;
+}
+
 // Uniform Access
 
 bool squawk = false;
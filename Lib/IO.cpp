@@ -2,6 +2,7 @@
 
 #include "Draw.h"
 #include "IO.h"
+#include "Normals.h"
 #include <fstream>
 #include <string.h>
 
@@ -150,20 +151,8 @@ int ReadGIF(const char *filename, vector<GLuint> &textureNames, int *nChannels,
 // Normals
 
 void SetVertexNormals(vector<vec3> &points, vector<int3> &triangles, vector<vec3> &normals) {
-	// size normals array and initialize to zero
-	int nverts = (int) points.size();
-	normals.resize(nverts, vec3(0, 0, 0));
-	// accumulate each triangle normal into its three vertex normals
-	for (int i = 0; i < (int) triangles.size(); i++) {
-		int3 &t = triangles[i];
-		vec3 &p1 = points[t.i1], &p2 = points[t.i2], &p3 = points[t.i3];
-		vec3 n(normalize(cross(p2-p1, p3-p2)));
-		normals[t.i1] += n;
-		normals[t.i2] += n;
-		normals[t.i3] += n;
-	}
-	for (int i = 0; i < nverts; i++)
-		normals[i] = normalize(normals[i]);
+	// average of unit normals of triangles at each vertex (see Normals.h for other weightings)
+	ComputeVertexNormals(points, triangles, normals, NormalWeight::Equal);
 }
 
 // Standardize
@@ -4,14 +4,15 @@
 #include <glad.h>
 #include "Draw.h"
 #include "GLXtras.h"
-#include "IO.h"
 #include "Letters.h"
 #include <stdio.h>
+#include <string.h>
+#include <vector>
 
 namespace {
 
 // images are 13 lines, each with 284 grayscale values; a value is represented as two hexadecimal characters
-const char *lowerCaseImage = "\
+constexpr char lowerCaseImage[] = "\
 FFFFFFFFFFFFFFFFFFD8000000D8FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF3B00007AFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFB90000000000FFFFFFFFFFFFFFFFFFFFFFFF3B00005CFFFFFFFFFFFFFFFFFFFFFF0000D8FFFFFFFFFFFFFFFFD80000D8FFFFFF9B000000FFFFFFFFFFFFFFFFD8000000009BFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF5C1DFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF\
 FFFFFFFFFFFFFFFFFFD8000000D8FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF3B00007AFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFD8000000000000B9FFFFFFFFFFFFFFFFFFFFFF3B00005CFFFFFFFFFFFFFFFFFFFFFF0000D8FFFFFFFFFFFFFFFFD80000D8FFFFFF9B000000FFFFFFFFFFFFFFFFD8000000009BFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF1D00FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF\
 FFFFFFFFFFFFFFFFFFFFFF3B00D8FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF9B007AFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF9B007AFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFB9005CFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF1D00FFFFFFFFFFFFFFFFFFFFFF7A009BFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF1D00FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF\
@@ -26,7 +27,7 @@ FF1D000000B90000009D000000D800000000D8FFFFFFFFFF1D000000001DFFFFFFFF9B000000009B
 FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF1D00D8FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF1D00B9FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF3B00D8FFFFFFFFFFFFFFFFFFFFFFFFFFFF9B007AFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF9B003BFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF\
 FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF7A00000000003BFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF9B00000000001DFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFD800000000009BFFFFFFFFFFFFFFFFFFFF7A0000000000FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF5C00000000005CFFFFFFFFFFFFFFFFFFFFFFFFFFFF";
 
-const char *upperCaseImage = "\
+constexpr char upperCaseImage[] = "\
 FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF\
 7A000000009BFFFFFFFF3B00000000000000FFFFFFFFFFFF5C0000009B5C1DFF1D000000000000B9FFFFFF3B00000000000000005CFFD80000000000000000009BFFFFFF5C0000009B5C3BFFB90000001DFF00000000B9FF7A00000000000000B9FFFFFFFF9B000000000000005C000000B9FF7A0000003B9B00000000001DFFFFFFD8000000D8FFFFFF9B0000000000009BFFD8000000005CFFFFFF5C0000007AFFFFFFFF1D0000000000005CFFFFFFFFFF5C0000007AFFFFFF3B0000000000001DFFFFFFFFFFFF3B000000B900B9FFB9000000000000000000D81D00003BFFFFFF0000000000000000B9FF9B00000000000000007AFF5C000000003B0000007AFF5C0000005C3B0000009BFF9B0000005CFF9B00000000000000B9\
 7A000000001DFFFFFFFF3B0000000000000000D8FFFFFF0000000000000000FF1D000000000000007AFFFF3B00000000000000005CFFD80000000000000000009BFFFF1D00000000000000FFB90000001DFF00000000B9FF7A00000000000000B9FFFFFFFF9B000000000000005C000000B9FF7A0000003B9B00000000001DFFFFFFD80000005CFFFFFF3B00000000000000FFD8000000005CFFFF0000000000001DFFFFFF1D000000000000003BFFFFFF0000000000001DFFFF3B0000000000000000FFFFFFFF1D0000000000009BFFB9000000000000000000D81D00003BFFFFFF0000000000000000B9FF9B00000000000000007AFF5C000000003B0000007AFF5C0000005C3B0000007AFF9B0000005CFF9B00000000000000B9\
@@ -42,7 +43,7 @@ D80000000000001DFFFFFFB9005CFFFFFFB90000D8B9007AFFFFFFFFFFFFFFFFFF3B00D8FFFFFFFF
 FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF1D000000D8D800B9FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF";
 
 // next 10 lines each with 82 grayscale values, each value represented as two hexadecimal characters
-const char *numberImage = "\
+constexpr char numberImage[] = "\
 FFEC7A110034C3FFFFDD98340047FFFFFFFFA723002389FFFFFF000000117AFFFFFFFFFFC3000089FFFF890000000000FFFFFFFFA734000089FF89000000000000C3FFDD57000023A7FFFFEC69110034B5FF\
 FF470000000011DDFF5700000047FFFFFF980000000000B5FFFF000000000098FFFFFFFF23000089FFFF890000000000FFFFFF690000000089FF89000000000000C3FF340000000000D0FF470000000000DD\
 D00011DDFF690069FF987AB50047FFFFFFEC47DDFF89007AFFFFFFFFFF980047FFFFFF89007A0089FFFF8900C3FFFFFFFFFFC30023B5FFFFFFFFFFFFFFFFEC1123FFFF0034ECFFA700C3DD0023DDFF890089\
@@ -54,95 +55,157 @@ B50034DDEC57007AFFFFFFC30047FFFFFFFF690089FFFFFFFFFFFFFFFFDD2300DD47000000000000
 FF340000000011DDFF47000000000047FF98000000000000FFC3000000000047FFFFFFFFFFC30089FFFF470000000011DDFFDD000000000047FFFFEC1111ECFFFFFFEC110000000000C3FF470000000069FF\
 FFEC69000057D0FFFF47000000000047FF89000000000000FFC30000003489ECFFFFFFFFFFC30089FFFF4700001169DDFFFFFFB534001169ECFFFF890089FFFFFFFFFFC334000034B5FFFF4700003498FFFF";
 
+// Atlas
+// the three images, a disk (for periods), and a solid block (for strokes) are decoded at compile time,
+// a row at a time, so that no one constant expression nears compilers' default evaluation
+// limits (eg, MSVC /constexpr:steps 100000); the pieces are placed into one grayscale texture, where
+// 255 is background (transparent), 0 is ink (opaque)
+
+constexpr int letterWidth = 284, letterHeight = 13, numberWidth = 82, numberHeight = 10;
+constexpr int upperY = letterHeight+1, numberY = 2*(letterHeight+1);		// a blank row between images
+constexpr int diskX = numberWidth+4, diskSize = 12, solidX = diskX+diskSize+4, solidSize = 4;
+constexpr int atlasWidth = letterWidth, atlasHeight = numberY+diskSize+1;
+
+static_assert(sizeof(lowerCaseImage) == 2*letterWidth*letterHeight+1, "bad lower-case image");
+static_assert(sizeof(upperCaseImage) == 2*letterWidth*letterHeight+1, "bad upper-case image");
+static_assert(sizeof(numberImage) == 2*numberWidth*numberHeight+1, "bad number image");
+
+template <int width, int height>
+struct Image {
+	unsigned char pixels[width*height];
+};
+
+constexpr int Hex(char c) { return c < 58? c-'0' : 10+c-'A'; }
+
+template <int width>
+constexpr Image<width, 1> DecodeRow(const char *hex, int row) {
+	Image<width, 1> image = {};
+	hex += 2*row*width;
+	for (int i = 0; i < width; i++)
+		image.pixels[i] = (unsigned char) (16*Hex(hex[2*i])+Hex(hex[2*i+1]));
+	return image;
+}
+
+constexpr Image<diskSize, 1> DiskRow(int j) {
+	// 4x4 supersampled
+	Image<diskSize, 1> image = {};
+	float r = diskSize/2.f-.5f;
+	for (int i = 0; i < diskSize; i++) {
+		int inside = 0;
+		for (int sj = 0; sj < 4; sj++)
+			for (int si = 0; si < 4; si++) {
+				float dx = i+(si+.5f)/4-diskSize/2.f, dy = j+(sj+.5f)/4-diskSize/2.f;
+				inside += dx*dx+dy*dy <= r*r? 1 : 0;
+			}
+		image.pixels[i] = (unsigned char) (255-(255*inside)/16);
+	}
+	return image;
+}
+
+// each row its own constant
+template <int row> constexpr Image<letterWidth, 1> lowerRow = DecodeRow<letterWidth>(lowerCaseImage, row);
+template <int row> constexpr Image<letterWidth, 1> upperRow = DecodeRow<letterWidth>(upperCaseImage, row);
+template <int row> constexpr Image<numberWidth, 1> numberRow = DecodeRow<numberWidth>(numberImage, row);
+template <int row> constexpr Image<diskSize, 1> diskRow = DiskRow(row);
+constexpr Image<solidSize, solidSize> solid = {};							// all ink
+
 // transform 2D vertex by view, separate uv from vec4
 const char *vertexShader = R"(
-	#version 130
+	#version 330 core
 	in vec4 point;
+	in vec3 color;
 	out vec2 vUv;
+	out vec3 vColor;
 	uniform mat4 view;
 	void main() {
 		gl_Position = view*vec4(point.xy, 0, 1);
 		vUv = point.zw;
+		vColor = color;
 	}
 )";
 
 // opacity depends on darkness of texture map
 const char *pixelShader = R"(
-	#version 130
+	#version 330 core
 	in vec2 vUv;
+	in vec3 vColor;
 	out vec4 pColor;
 	uniform sampler2D textureImage;
-	uniform vec3 color;
 	void main() {
 		float a = texture(textureImage, vUv).r;
-		pColor = vec4(color, 1-a);
+		pColor = vec4(vColor, 1-a);
 	}
 )";
 
-GLuint shaderProgram = 0, vBufferId = 0;
-GLuint textureNameLower = 0, textureNameUpper = 0, textureNameNumber = 0;
-int textureUnitLower = 2, textureUnitUpper = 3, textureUnitNumber = 4; // this dies if GLUint?!
+static bool lettersRegistered = RegisterProgram("Letters", &vertexShader, &pixelShader);
 
-} // end namespace
+GLuint shaderProgram = 0, vArrayId = 0, vBufferId = 0, textureName = 0;
+int textureUnit = 2, capacity = 0;
 
-int MakeLetterTexture(unsigned char *image) {//, int textureUnit) {
-	// create and load texture raster
-	int nchars = (int) strlen(lowerCaseImage), npixels = nchars/2, height = 13, width = npixels/height;
-	unsigned char *pixels = new unsigned char[3*npixels], *p = pixels, *n = (unsigned char *) image;
-	for (int i = 0; i < npixels; i++) {
-		char c1 = *n++, c2 = *n++;
-		int k1 = c1 < 58? c1-'0' : 10+c1-'A', k2 = c2 < 58? c2-'0' : 10+c2-'A', b = 16*k1+k2;
-		for (int k = 0; k < 3; k++)
-			*p++ = (unsigned char) b;
-	}
-	int textureName = LoadTexture(pixels, width, height, 3);//, textureUnit);
-	delete [] pixels;
-	return textureName;
-}
-
-int MakeNumberTexture(unsigned char *image) {//, int textureUnit) {
-	// create and load texture raster
-	int nchars = (int) strlen(numberImage), npixels = nchars/2, height = 10, width = npixels/height;
-	unsigned char *pixels = new unsigned char[3*npixels], *p = pixels, *n = (unsigned char *) image;
-	for (int i = 0; i < npixels; i++) {
-		char c1 = *n++, c2 = *n++;
-		int k1 = c1 < 58? c1-'0' : 10+c1-'A', k2 = c2 < 58? c2-'0' : 10+c2-'A', b = 16*k1+k2;
-		for (int k = 0; k < 3; k++)
-			*p++ = (unsigned char) b;
-	}
-	int textureName = LoadTexture(pixels, width, height, 3);//, textureUnit);
-	delete [] pixels;
-	return textureName;
+// Batch
+
+std::vector<GlyphVertex> vertices;				// six per glyph or stroke
+int batchDepth = 0;
+
+vec2 AtlasUv(float x, float y) { return vec2(x/atlasWidth, y/atlasHeight); }
+
+void AddQuad(std::vector<GlyphVertex> &v, vec2 p0, vec2 p1, vec2 p2, vec2 p3, vec2 uv0, vec2 uv1, vec2 uv2, vec2 uv3, vec3 color) {
+	GlyphVertex v0(p0, uv0, color), v1(p1, uv1, color), v2(p2, uv2, color), v3(p3, uv3, color);
+	GlyphVertex quad[] = { v0, v1, v2, v0, v2, v3 };
+	v.insert(v.end(), quad, quad+6);
+}
+
+void AddRect(std::vector<GlyphVertex> &v, float x, float y, float w, float h, vec2 uvTopLeft, vec2 uvBottomRight, vec3 color) {
+	vec2 &t = uvTopLeft, &b = uvBottomRight;
+	AddQuad(v, vec2(x, y), vec2(x+w, y), vec2(x+w, y+h), vec2(x, y+h), vec2(t.x, b.y), b, vec2(b.x, t.y), t, color);
+}
+
+void AddStroke(std::vector<GlyphVertex> &v, vec2 a, vec2 b, float width, vec3 color) {
+	// a line as a quad sampling the solid block
+	vec2 d = b-a;
+	float len = length(d);
+	d = len > 0? d/len : vec2(1, 0);
+	vec2 n = (width/2)*vec2(-d.y, d.x), uv = AtlasUv(solidX+solidSize/2.f, numberY+solidSize/2.f);
+	AddQuad(v, a-n, b-n, b+n, a+n, uv, uv, uv, uv, color);
+}
+
+void AddStroke(std::vector<GlyphVertex> &v, int x1, int y1, int x2, int y2, float width, vec3 color) {
+	AddStroke(v, vec2((float) x1, (float) y1), vec2((float) x2, (float) y2), width, color);
 }
 
-void Letter(int x, int y, char c, vec3 color, float ptSize) {
+void AddDisk(std::vector<GlyphVertex> &v, vec2 center, float diameter, vec3 color) {
+	float r = diameter/2;
+	AddRect(v, center.x-r, center.y-r, diameter, diameter, AtlasUv(diskX, numberY), AtlasUv(diskX+diskSize, numberY+diskSize), color);
+}
+
+} // end namespace
+
+void LetterQuads(int x, int y, char c, vec3 color, float ptSize, std::vector<GlyphVertex> &v) {
 	if (c < 48 || c == 61 || c == 94) { // 32(space), 40((), 41()), 43(+), 45(-), 46(.), 47(/), 61(=), 94(^)
-//		if (true) return;
 		float lineWidth = ptSize/3; // = 2;
-		UseDrawShader(ScreenMode());
-		int size = (int) ptSize, h = (int)(ptSize*.5f), hh = (int)(ptSize*.75f);
+		int size = (int) ptSize, h = (int)(ptSize*.5f);
 		if (c == 40) {
 			vec2 p1(x+h, y+size+1), p2(x+2, y+(int)(.75f*ptSize)), p3(x+2, y+(int)(.25f*ptSize)), p4(x+h, y-1);
-			Line(p1, p2, lineWidth, color); Line(p2, p3, lineWidth, color); Line(p3, p4, lineWidth, color);
+			AddStroke(v, p1, p2, lineWidth, color); AddStroke(v, p2, p3, lineWidth, color); AddStroke(v, p3, p4, lineWidth, color);
 		}
 		if (c == 41) {
 			vec2 p1(x+h, y+size+1), p2(x+size-2, y+(int)(.75f*ptSize)), p3(x+size-2, y+(int)(.25f*ptSize)), p4(x+h, y-1);
-			Line(p1, p2, lineWidth, color); Line(p2, p3, lineWidth, color); Line(p3, p4, lineWidth, color);
+			AddStroke(v, p1, p2, lineWidth, color); AddStroke(v, p2, p3, lineWidth, color); AddStroke(v, p3, p4, lineWidth, color);
 		}
 		if (c == 61) {
-			Line(x+1, y+h+3, x+h+6, y+h+3, lineWidth, color);
-			Line(x+1, y+h-3, x+h+6, y+h-3, lineWidth, color);
+			AddStroke(v, x+1, y+h+3, x+h+6, y+h+3, lineWidth, color);
+			AddStroke(v, x+1, y+h-3, x+h+6, y+h-3, lineWidth, color);
 		}
 		if (c == 43) {
-			Line(x+1, y+h+1, x+h+6, y+h+1, lineWidth, color);
-			Line(x+h, y+2, x+h, y+h+6, lineWidth, color);
+			AddStroke(v, x+1, y+h+1, x+h+6, y+h+1, lineWidth, color);
+			AddStroke(v, x+h, y+2, x+h, y+h+6, lineWidth, color);
 		}
-		if (c == 45) Line(x+1, y+h, x+h+3, y+h, lineWidth, color);
-		if (c == 46) Disk(vec2(x+h, y+3), ptSize/3, color);
-		if (c == 47) Line(x+1, y, x+size-1, y+size, lineWidth, color);
+		if (c == 45) AddStroke(v, x+1, y+h, x+h+3, y+h, lineWidth, color);
+		if (c == 46) AddDisk(v, vec2((float) (x+h), (float) (y+3)), ptSize/3, color);
+		if (c == 47) AddStroke(v, x+1, y, x+size-1, y+size, lineWidth, color);
 		if (c == 94) {
-			Line(x+1, y+2, x+h, y+h+4, lineWidth, color);
-			Line(x+h, y+h+4, x+size-2, y+2, lineWidth, color);
+			AddStroke(v, x+1, y+2, x+h, y+h+4, lineWidth, color);
+			AddStroke(v, x+h, y+h+4, x+size-2, y+2, lineWidth, color);
 		}
 		return;
 	}
@@ -153,87 +216,126 @@ void Letter(int x, int y, char c, vec3 color, float ptSize) {
 							 Unknown;
 	if (type == Unknown)
 		return;
-	if (!textureNameLower)
-		textureNameLower = MakeLetterTexture((unsigned char *) lowerCaseImage);//, textureUnitLower);
-	if (!textureNameUpper)
-		textureNameUpper = MakeLetterTexture((unsigned char *) upperCaseImage);//, textureUnitUpper);
-	if (!textureNameNumber)
-		textureNameNumber = MakeNumberTexture((unsigned char *) numberImage);//, textureUnitNumber);
-	if (!textureNameLower || !textureNameUpper || !textureNameNumber)
-		printf("can't make texture maps\n");
+	// glyph column range within its image; image row 0 is the top of the glyph
+	float w = .8f*ptSize, h = ptSize;
+	if (type == Number) {
+		float dx = numberWidth/10.f, x0 = (c-'0')*dx;
+		AddRect(v, (float) x, (float) y, w, h, AtlasUv(x0, numberY), AtlasUv(x0+dx, numberY+numberHeight), color);
+	}
+	else {
+		int letterID = type == Upper? c-'A' : c-'a', y0 = type == Upper? upperY : 0;
+		float dx = letterWidth/26.f, x0 = letterID*dx;
+		AddRect(v, (float) x, (float) y, w, h, AtlasUv(x0, (float) y0), AtlasUv(x0+dx, (float) (y0+letterHeight)), color);
+	}
+}
+
+template <int width, int height>
+void PlaceImage(int x, int y, const Image<width, height> &image) {
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RED, GL_UNSIGNED_BYTE, image.pixels);
+}
+
+template <int row>
+void PlaceLetterRows() {
+	// rows 0 through row of both letter images
+	PlaceLetterRows<row-1>();
+	PlaceImage(0, row, lowerRow<row>);
+	PlaceImage(0, upperY+row, upperRow<row>);
+}
+
+template <> void PlaceLetterRows<-1>() { }
+
+template <int row>
+void PlaceNumberRows() {
+	PlaceNumberRows<row-1>();
+	PlaceImage(0, numberY+row, numberRow<row>);
+}
+
+template <> void PlaceNumberRows<-1>() { }
+
+template <int row>
+void PlaceDiskRows() {
+	PlaceDiskRows<row-1>();
+	PlaceImage(diskX, numberY+row, diskRow<row>);
+}
+
+template <> void PlaceDiskRows<-1>() { }
+
+GLuint UseLettersShader(mat4 view) {
+	int was = CurrentProgram();
 	if (!shaderProgram)
 		shaderProgram = LinkProgramViaCode(&vertexShader, &pixelShader);
 	glUseProgram(shaderProgram);
-	if (!vBufferId) {
-		glGenBuffers(1, &vBufferId);
-		glBindBuffer(GL_ARRAY_BUFFER, vBufferId);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(float)*4*6, NULL, GL_DYNAMIC_DRAW);
-			// need 4 vertices for quad, but 6 if triangles
+	if (!textureName) {
+		glGenTextures(1, &textureName);
+		glBindTexture(GL_TEXTURE_2D, textureName);
+		std::vector<unsigned char> background(atlasWidth*atlasHeight, 255);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasWidth, atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, background.data());
+		PlaceLetterRows<letterHeight-1>();
+		PlaceNumberRows<numberHeight-1>();
+		PlaceDiskRows<diskSize-1>();
+		PlaceImage(solidX, numberY, solid);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	}
-	glBindBuffer(GL_ARRAY_BUFFER, vBufferId);
-	VertexAttribPointer(shaderProgram, "point", 4, 4*sizeof(float), 0);
-		// each vertex is 4 floats, stride is 4 floats
-	int texUnit = type == Upper? textureUnitUpper : type == Lower? textureUnitLower : textureUnitNumber;
-	GLuint texName = type == Upper? textureNameUpper : type == Lower? textureNameLower : textureNameNumber;
-	glActiveTexture(GL_TEXTURE0+texUnit);
-	glBindTexture(GL_TEXTURE_2D, texName);
-	// set screen-mode
-	SetUniform(shaderProgram, "view", ScreenMode());
-	// set text color and texture map, activate texture
-	SetUniform(shaderProgram, "color", color);
-	SetUniform(shaderProgram, "textureImage", texUnit);
+	glActiveTexture(GL_TEXTURE0+textureUnit);
+	glBindTexture(GL_TEXTURE_2D, textureName);
+	glActiveTexture(GL_TEXTURE0);
+	SetUniform(shaderProgram, "view", view);
+	SetUniform(shaderProgram, "textureImage", textureUnit);
 	// enable blended overwrite of color buffer
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	// display character c, value determines horizontal position along texture
-	float w = .8f*ptSize, h = ptSize, xx = (float) x, yy = (float) y;
-	float t = 0, dt = 0;
-	if (type == Number) {
-		int value = c-'0';
-		dt = 1.f/10.f; t = (float) value*dt;
-		float vertices[][4] = { {xx, yy, t, 1}, {xx+w, yy, t+dt, 1}, {xx+w, yy+h, t+dt, 0}, {xx, yy+h, t, 0} };
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-	}
-	else {
-		int letterID = type == Upper? c-'A' : type == Lower? c-'a' : c-'0';
-		dt = 1.f/26.f; t = (float)letterID*dt;
-	//	float vertices[][4] = { {xx, yy+h, t, 1}, {xx+w, yy+h, t+dt, 1}, {xx+w, yy, t+dt, 0}, {xx, yy, t, 0} };
-		float vertices[][4] = { {xx, yy, t, 1}, {xx+w, yy, t+dt, 1}, {xx+w, yy+h, t+dt, 0}, {xx, yy+h, t, 0} };
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+	return was;
+}
+
+void FlushLetters() {
+	if (vertices.empty())
+		return;
+	FlushDrawList();								// keep draw order with batched lines, disks, etc.
+	int was = UseLettersShader(ScreenMode());
+	if (!vArrayId) {
+		glGenVertexArrays(1, &vArrayId);
+		glGenBuffers(1, &vBufferId);
+		glBindVertexArray(vArrayId);
+		glBindBuffer(GL_ARRAY_BUFFER, vBufferId);
+		VertexAttribPointer(shaderProgram, "point", 4, sizeof(GlyphVertex), 0);
+		VertexAttribPointer(shaderProgram, "color", 3, sizeof(GlyphVertex), (void *) (2*sizeof(vec2)));
 	}
-	// display as one quad or two triangles, mapped to 1/26 width of texture map
-#ifdef GL_QUADS
-	glDrawArrays(GL_QUADS, 0, 4);
-#else
-	float vertices[][4] = {{xx, yy, t, 1}, {xx+w, yy, t+dt, 1},   {xx+w, yy+h, t+dt, 0},
-					       {xx, yy, t, 1}, {xx+w, yy+h, t+dt, 0}, {xx, yy+h, t, 0}};
-	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-	glDrawArrays(GL_TRIANGLES, 0, 6);
-#endif
+	glBindVertexArray(vArrayId);
+	glBindBuffer(GL_ARRAY_BUFFER, vBufferId);
+	int nBytes = vertices.size()*sizeof(GlyphVertex);
+	if (nBytes > capacity)
+		capacity = nBytes+nBytes/2;
+	glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, nBytes, vertices.data());
+	glDrawArrays(GL_TRIANGLES, 0, (int) vertices.size());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(was);
+	vertices.resize(0);
+}
+
+void BeginLetters() { batchDepth++; }
+
+void EndLetters() {
+	if (batchDepth > 0 && --batchDepth == 0)
+		FlushLetters();
 }
 
 void Letters(int x, int y, const char *letters, vec3 color, float ptSize) {
-	int was = 0;
-	mat4 drawView = GetDrawView();
-	glGetIntegerv(GL_CURRENT_PROGRAM, &was);
-	for (int i = 0; i < (int) strlen(letters); i++)
-		Letter((int) (x+i*ptSize), y, letters[i], color, ptSize);
-	glUseProgram(was);
-	SetDrawView(drawView);
+	for (int i = 0; letters[i]; i++)
+		LetterQuads((int) (x+i*ptSize), y, letters[i], color, ptSize, vertices);
+	if (!batchDepth)
+		FlushLetters();
 }
 
 void Letters(vec3 p, mat4 m, const char *letters, vec3 color, float ptSize) {
-	int was = 0;
-	mat4 drawView = GetDrawView();
-	glGetIntegerv(GL_CURRENT_PROGRAM, &was);
 	vec2 pp = ScreenPoint(p, m);
-	for (int i = 0; i < (int) strlen(letters); i++)
-	//	Letter((int) (pp.x+i*10.9f), (int) pp.y, letters[i], color, ptSize);
-		Letter((int) (pp.x+i*ptSize), (int) pp.y, letters[i], color, ptSize);
-	glUseProgram(was);
-	SetDrawView(drawView);
+	Letters((int) pp.x, (int) pp.y, letters, color, ptSize);
 }
 
 /*	// method to convert image to hexadecimal data
@@ -3,6 +3,10 @@
 #include "GLXtras.h"
 #include "Draw.h"
 #include "Mesh.h"
+#include "MeshOptimize.h"
+#include "Normals.h"
+#include "Simplify.h"
+#include <algorithm>
 
 // Shaders
 
@@ -18,21 +22,29 @@ const char *meshVertexShader = R"(
 	layout (location = 2) in vec2 uv;
 	layout (location = 3) in mat4 instance; // for use with glDrawArrays/ElementsInstanced
 											// uses locations 3,4,5,6 for 4 vec4s = mat4
-	layout (location = 7) in vec3 color;	// for instanced color (vec4?)
+	layout (location = 7) in vec3 instanceColor;	// for instanced color (vec4?)
 	out vec3 vPoint;
 	out vec3 vNormal;
 	out vec2 vUv;
+	flat out vec3 vInstanceColor;
 	uniform mat4 modelview;
 	uniform mat4 persp;
 	uniform bool useInstance = false;
 	uniform bool useNormalMatrix = false;
+	uniform bool useInstanceNormalMatrix = false;	// for instances with non-uniform scale
 	uniform mat3 normalMatrix;
+	mat3 Cofactor(mat3 m) {
+		// inverse transpose of m, up to scale (normals are normalized in pixel shader)
+		return mat3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1]));
+	}
 	void main() {
 		mat4 m = useInstance? modelview*instance : modelview;
 		vPoint = (m*vec4(point, 1)).xyz;
-		vNormal = useNormalMatrix? normalMatrix*normal : (m*vec4(normal, 0)).xyz;
+		vNormal = useNormalMatrix? normalMatrix*normal :
+				  useInstance && useInstanceNormalMatrix? Cofactor(mat3(m))*normal : (m*vec4(normal, 0)).xyz;
 		gl_Position = persp*vec4(vPoint, 1);
 		vUv = uv;
+		vInstanceColor = instanceColor;
 	}
 )";
 
@@ -43,8 +55,10 @@ const char *meshGeometryShader = R"(
 	layout (triangle_strip, max_vertices = 3) out;
 	in vec3 vPoint[], vNormal[];
 	in vec2 vUv[];
+	flat in vec3 vInstanceColor[];
 	out vec3 gPoint, gNormal;
 	out vec2 gUv;
+	flat out vec3 gInstanceColor;
 	noperspective out vec3 gEdgeDistance;
 	uniform mat4 vp;
 	vec3 ViewPoint(int i) { return vec3(vp*(gl_in[i].gl_Position/gl_in[i].gl_Position.w)); }
@@ -65,6 +79,7 @@ const char *meshGeometryShader = R"(
 			gPoint = vPoint[i];
 			gNormal = vNormal[i];
 			gUv = vUv[i];
+			gInstanceColor = vInstanceColor[i];
 			gl_Position = gl_in[i].gl_Position;
 			EmitVertex();
 		}
@@ -77,12 +92,14 @@ const char *meshPixelShaderLines = R"(
 	#version 410 core
 	in vec3 gPoint, gNormal;
 	in vec2 gUv;
+	flat in vec3 gInstanceColor;
 	noperspective in vec3 gEdgeDistance;
 	uniform sampler2D textureImage;
 	uniform int nLights = 0;
 	uniform vec3 lights[20];
 	uniform vec3 defaultLight = vec3(1, 1, 1);
 	uniform vec3 color = vec3(1, 0, 1);
+	uniform bool useInstanceColor = false;
 	uniform float opacity = 1;
 	uniform float ambient = .2;
 	uniform bool useLight = true;
@@ -102,6 +119,7 @@ const char *meshPixelShaderLines = R"(
 		return clamp(d+pow(s, 50), 0, 1);
 	}
 	void main() {
+		vec3 baseColor = useInstanceColor? gInstanceColor : color;
 		vec3 N = normalize(facetedShading? cross(dFdx(gPoint), dFdy(gPoint)) : gNormal);
 		if (fwdFacingOnly && N.z < 0)
 			discard;
@@ -118,13 +136,13 @@ const char *meshPixelShaderLines = R"(
 		if (useTexture) {
 			pColor = vec4(intensity*texture(textureImage, gUv).rgb, opacity);
 			if (useTint) {
-				pColor.r *= color.r;
-				pColor.g *= color.g;
-				pColor.b *= color.b;
+				pColor.r *= baseColor.r;
+				pColor.g *= baseColor.g;
+				pColor.b *= baseColor.b;
 			}
 		}
 		else
-			pColor = vec4(intensity*color, opacity);
+			pColor = vec4(intensity*baseColor, opacity);
 		float minDist = min(gEdgeDistance.x, gEdgeDistance.y);
 		minDist = min(minDist, gEdgeDistance.z);
 		float t = smoothstep(outlineWidth-outlineTransition, outlineWidth+outlineTransition, minDist);
@@ -137,11 +155,13 @@ const char *meshPixelShaderNoLines = R"(
 	#version 410 core
 	in vec3 vPoint, vNormal;
 	in vec2 vUv;
+	flat in vec3 vInstanceColor;
 	uniform sampler2D textureImage;
 	uniform int nLights = 0;
 	uniform vec3 lights[20];
 	uniform vec3 defaultLight = vec3(1, 1, 1);
 	uniform vec3 color = vec3(1, 0, 1);
+	uniform bool useInstanceColor = false;
 	uniform float opacity = 1;
 	uniform bool useLight = true;
 	uniform bool useTexture = true;
@@ -169,6 +189,7 @@ const char *meshPixelShaderNoLines = R"(
 		}
 	}
 	void main() {
+		vec3 baseColor = useInstanceColor? vInstanceColor : color;
 		N = normalize(facetedShading? cross(dFdx(vPoint), dFdy(vPoint)) : vNormal);
 		if (fwdFacingOnly && N.z < 0)
 			discard;
@@ -189,16 +210,19 @@ const char *meshPixelShaderNoLines = R"(
 		else if (useTexture) {
 			pColor = vec4(ads*texture(textureImage, vUv).rgb, opacity);
 			if (useTint) {
-				pColor.r *= color.r;
-				pColor.g *= color.g;
-				pColor.b *= color.b;
+				pColor.r *= baseColor.r;
+				pColor.g *= baseColor.g;
+				pColor.b *= baseColor.b;
 			}
 		}
 		else
-			pColor = vec4(ads*color, opacity);
+			pColor = vec4(ads*baseColor, opacity);
 	}
 )";
 
+static bool meshLinesRegistered = RegisterProgram("Mesh lines", &meshVertexShader, NULL, NULL, &meshGeometryShader, &meshPixelShaderLines);
+static bool meshRegistered = RegisterProgram("Mesh", &meshVertexShader, &meshPixelShaderNoLines);
+
 } // end namespace
 
 const char *GetMeshPixelShaderNoLines() { return meshPixelShaderNoLines; }
@@ -278,32 +302,260 @@ void TranslateTransform(Mesh *m, vec3 pDif) {
 }
 */
 
+// Bounding Volumes and Culling
+
+BoundingVolume::BoundingVolume(vector<vec3> &pts) {
+	if (pts.size()) {
+		Bounds(pts.data(), pts.size(), min, max);
+		center = .5f*(min+max);
+		for (size_t i = 0; i < pts.size(); i++) {
+			vec3 d = pts[i]-center;
+			radius = std::max(radius, dot(d, d));
+		}
+		radius = sqrt(radius);
+	}
+}
+
+BoundingVolume::BoundingVolume(vector<vec3> &pts, vector<int3> &tris, int start, int n) {
+	if (n <= 0)
+		return;
+	min = vec3(FLT_MAX);
+	max = -min;
+	for (int t = start; t < start+n; t++)
+		for (int k = 0; k < 3; k++) {
+			vec3 &p = pts[tris[t][k]];
+			for (int j = 0; j < 3; j++) {
+				if (p[j] < min[j]) min[j] = p[j];
+				if (p[j] > max[j]) max[j] = p[j];
+			}
+		}
+	center = .5f*(min+max);
+	for (int t = start; t < start+n; t++)
+		for (int k = 0; k < 3; k++) {
+			vec3 d = pts[tris[t][k]]-center;
+			radius = std::max(radius, dot(d, d));
+		}
+	radius = sqrt(radius);
+}
+
+bool BoundingVolume::Visible(const Frustum &f, const mat4 &m) const {
+	// transform sphere to world, radius scaled by largest axis scale of m
+	vec4 c = m*vec4(center, 1);
+	float s = 0;
+	for (int j = 0; j < 3; j++)
+		s = std::max(s, m[0][j]*m[0][j]+m[1][j]*m[1][j]+m[2][j]*m[2][j]);
+	float r = radius*sqrt(s);
+	bool straddle = false;
+	for (int i = 0; i < 6; i++) {
+		const vec4 &p = f.planes[i];
+		float d = p.x*c.x+p.y*c.y+p.z*c.z+p.w;
+		if (d < -r)
+			return false;
+		if (d < r)
+			straddle = true;
+	}
+	// sphere crosses a plane: box is tighter
+	return !straddle || f.BoxVisible(min, max, m);
+}
+
+void Mesh::SetBoundingVolumes(vector<vec3> &pts) {
+	boundingVolume = BoundingVolume(pts);
+	int nGroups = triangleGroups.size();
+	groupVolumes.resize(nGroups);
+	for (int i = 0; i < nGroups; i++)
+		groupVolumes[i] = BoundingVolume(pts, triangles, triangleGroups[i].startTriangle, triangleGroups[i].nTriangles);
+}
+
+bool Mesh::Cull(const Frustum &f, CullStats *stats) {
+	int nGroups = triangleGroups.size();
+	if ((int) groupVolumes.size() != nGroups || (boundingVolume.radius == 0 && points.size()))
+		SetBoundingVolumes();
+	culled = !boundingVolume.Visible(f, toWorld);
+	groupCulled.assign(nGroups, culled);
+	if (!culled)
+		for (int i = 0; i < nGroups; i++)
+			groupCulled[i] = !groupVolumes[i].Visible(f, toWorld);
+	if (stats) {
+		stats->nMeshes++;
+		stats->nGroups += nGroups;
+		if (culled)
+			stats->nMeshesCulled++;
+		for (int i = 0; i < nGroups; i++)
+			if (groupCulled[i])
+				stats->nGroupsCulled++;
+	}
+	return !culled;
+}
+
+void CullRecurse(Mesh *m, const Frustum &f, CullStats &stats, bool recurse) {
+	m->Cull(f, &stats);
+	if (recurse)
+		for (size_t i = 0; i < m->children.size(); i++)
+			CullRecurse(m->children[i], f, stats, recurse);
+}
+
+CullStats Cull(vector<Mesh *> &meshes, const Frustum &frustum, bool recurse) {
+	CullStats stats;
+	for (size_t i = 0; i < meshes.size(); i++)
+		CullRecurse(meshes[i], frustum, stats, recurse);
+	return stats;
+}
+
+// Reordering
+
+void Mesh::Optimize(bool overdraw) {
+	float acmrBefore = 0, acmrAfter = 0;
+	OptimizeMesh(points, normals, uvs, triangles, quads, triangleGroups, triangleMtls, overdraw, &acmrBefore, &acmrAfter);
+	printf("Mesh.Optimize: %s ACMR %3.2f -> %3.2f\n", objFilename.c_str(), acmrBefore, acmrAfter);
+	if (triInfos.size())
+		BuildInfos();
+	if (lods.size())
+		BuildLods(lodLevels, lodRatio, lodMaxError);
+	if (meshlets.size())
+		BuildMeshlets(meshletMaxVertices, meshletMaxTriangles);
+	if (vbo)
+		Buffer();
+}
+
+// Levels of Detail
+
+int Mesh::BuildLods(int nLevels, float ratio, float maxError) {
+	if (dynamic) {
+		printf("Mesh.BuildLods: levels of detail not kept for dynamic mesh\n");
+		return 0;
+	}
+	lodTriangles.resize(0);
+	lods.resize(0);
+	lodLevels = nLevels;
+	lodRatio = ratio;
+	lodMaxError = maxError;
+	vector<int3> src = triangles, dst;
+	vector<Group> srcGroups = triangleGroups, dstGroups;
+	int nTriangles = triangles.size();
+	for (int level = 1; level <= nLevels; level++) {
+		MeshLod l;
+		int target = (int) (ratio*src.size());
+		int n = Simplify(points, src, dst, target, maxError, &srcGroups, &dstGroups, &l.error);
+		if (n == 0 || n >= (int) src.size())
+			break;
+		l.startTriangle = nTriangles+lodTriangles.size();
+		l.nTriangles = n;
+		l.groups = dstGroups;
+		for (size_t i = 0; i < l.groups.size(); i++)
+			l.groups[i].startTriangle += l.startTriangle;
+		if (lods.size() && l.error < lods.back().error)
+			l.error = lods.back().error;
+		lodTriangles.insert(lodTriangles.end(), dst.begin(), dst.end());
+		lods.push_back(l);
+		src = dst;
+		srcGroups = dstGroups;
+	}
+	if (ebo)
+		BufferTriangles();
+	lod = 0;
+	return lods.size();
+}
+
+int Mesh::SelectLod(const Camera &camera) {
+	int level = 0;
+	if (lods.size()) {
+		// object-to-world scale: largest axis length of toWorld
+		float scale = 0;
+		for (int j = 0; j < 3; j++)
+			scale = std::max(scale, length(vec3(toWorld[0][j], toWorld[1][j], toWorld[2][j])));
+		vec4 c = camera.modelview*toWorld*vec4(boundingVolume.center, 1);
+		float distance = length(vec3(c.x, c.y, c.z)), radius = scale*boundingVolume.radius;
+		if (distance > radius) {
+			// error in fraction of viewport half-height, given perspective focal length persp[1][1]
+			float toScreen = scale*camera.persp[1][1]/distance;
+			while (level < (int) lods.size() && lods[level].error*toScreen < lodTolerance)
+				level++;
+		}
+	}
+	return level;
+}
+
+// Meshlets
+
+int Mesh::BuildMeshlets(int maxVertices, int maxTriangles) {
+	meshlets.resize(0);
+	if (dynamic) {
+		printf("Mesh.BuildMeshlets: meshlets not kept for dynamic mesh\n");
+		return 0;
+	}
+	meshletMaxVertices = maxVertices;
+	meshletMaxTriangles = maxTriangles;
+	::BuildMeshlets(points, triangles, triangleGroups, triangleMtls, meshlets, maxVertices, maxTriangles);
+	if (triInfos.size())
+		BuildInfos();
+	if (ebo) {
+		BufferTriangles();
+		meshletCuller.Upload(meshlets);
+	}
+	return meshlets.size();
+}
+
+// Signed Distance
+
+bool Mesh::BakeSDF(int resolution, float padding) {
+	if (!::BakeSDF(points, triangles, sdf, resolution, padding)) {
+		printf("Mesh.BakeSDF: no triangles\n");
+		return false;
+	}
+	if (vao)
+		sdf.Upload();
+	return true;
+}
+
 // Display
 
-// void Display(Camera camera, bool lines = false, bool useGroupColor = false);
-// void Display(Camera camera, vec3 color, bool lines = false);
-// void Display(Camera camera, int textureUnit, bool lines = false, bool useGroupColor = false);
+// void Display(const Camera &camera, bool lines = false, bool useGroupColor = false);
+// void Display(const Camera &camera, vec3 color, bool lines = false);
+// void Display(const Camera &camera, int textureUnit, bool lines = false, bool useGroupColor = false);
 
-void Mesh::Display(Camera camera, bool lines, bool useGroupColor) {
+void Mesh::Display(const Camera &camera, bool lines, bool useGroupColor) {
 	Display(camera, -1, lines, useGroupColor);
 }
 
-void Mesh::Display(Camera camera, vec3 c, bool lines) {
+void Mesh::Display(const Camera &camera, vec3 c, bool lines) {
 	vec3 save = color;
 	color = c;
 	Display(camera, -1, lines);
 	color = save;
 }
 
-void Mesh::Display(Camera camera, vec3 c, int textureUnit, bool lines) {
+void Mesh::Display(const Camera &camera, vec3 c, int textureUnit, bool lines) {
 	vec3 save = color;
 	color = c;
 	Display(camera, textureUnit, lines);
 	color = save;
 }
 
-void Mesh::Display(Camera camera, int textureUnit, bool lines, bool useGroupColor) {
-	int nTris = triangles.size(), nQuads = quads.size();
+static void DrawTriangles(int start, int n) {
+	if (n > 0)
+		glDrawElements(GL_TRIANGLES, 3*n, GL_UNSIGNED_INT, (void *) (3*start*sizeof(int)));
+}
+
+void Mesh::Display(const Camera &camera, int textureUnit, bool lines, bool useGroupColor) {
+	if (culled)
+		return;
+	if (!dirtyPoints.Empty() || !dirtyNormals.Empty() || !dirtyUvs.Empty() || !dirtyTriangles.Empty())
+		UpdateBuffer();
+	lod = SelectLod(camera);
+	vector<Group> &groups = lod? lods[lod-1].groups : triangleGroups;
+	int first = lod? lods[lod-1].startTriangle : 0, nTris = lod? lods[lod-1].nTriangles : triangles.size();
+	int nQuads = quads.size(), nGroups = groups.size();
+	int nUngrouped = nGroups? groups[0].startTriangle-first : nTris;
+	bool someGroupsCulled = false;
+	for (int i = 0; i < (int) groupCulled.size(); i++)
+		someGroupsCulled = someGroupsCulled || groupCulled[i];
+	// meshlet culling (a compute pass) precedes the draw shader
+	bool drawMeshlets = useMeshlets && meshlets.size() && !lod && !useGroupColor;
+	if (drawMeshlets) {
+		if (meshletCuller.nMeshlets != (int) meshlets.size())
+			meshletCuller.Upload(meshlets);
+		meshletCuller.Cull(camera, toWorld);
+	}
 	// enable shader and vertex array object
 	int shader = UseMeshShader(lines);
 	glBindVertexArray(vao);
@@ -325,20 +577,36 @@ void Mesh::Display(Camera camera, int textureUnit, bool lines, bool useGroupColo
 		int textureSet = 0;
 		glGetUniformiv(shader, glGetUniformLocation(shader, "useTexture"), &textureSet);
 		// show ungrouped triangles without texture mapping
-		int nGroups = triangleGroups.size(), nUngrouped = nGroups? triangleGroups[0].startTriangle : nTris;
 		SetUniform(shader, "useTexture", false);
-		glDrawElements(GL_TRIANGLES, 3*nUngrouped, GL_UNSIGNED_INT, 0); // triangles.data());
+		DrawTriangles(first, nUngrouped);
 		// show grouped triangles with texture mapping
 		SetUniform(shader, "useTexture", textureSet == 1);
 		for (int i = 0; i < nGroups; i++) {
-			Group g = triangleGroups[i];
+			if (someGroupsCulled && groupCulled[i])
+				continue;
+			Group &g = groups[i];
 			SetUniform(shader, "color", g.color);
-			glDrawElements(GL_TRIANGLES, 3*g.nTriangles, GL_UNSIGNED_INT, (void *) (3*g.startTriangle*sizeof(int)));
+			DrawTriangles(g.startTriangle, g.nTriangles);
 		}
 	}
 	else {
 		SetUniform(shader, "color", color);
-		glDrawElements(GL_TRIANGLES, 3*nTris, GL_UNSIGNED_INT, 0);
+		if (drawMeshlets)
+			meshletCuller.Draw();
+		else if (!someGroupsCulled)
+			DrawTriangles(first, nTris);
+		else {
+			// ungrouped triangles, then each run of contiguous visible groups
+			DrawTriangles(first, nUngrouped);
+			for (int i = 0; i < nGroups; i++) {
+				if (groupCulled[i])
+					continue;
+				int start = groups[i].startTriangle, n = 0;
+				for (; i < nGroups && !groupCulled[i]; i++)
+					n += groups[i].nTriangles;
+				DrawTriangles(start, n);
+			}
+		}
 #ifdef GL_QUADS
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 		glDrawElements(GL_QUADS, 4*nQuads, GL_UNSIGNED_INT, quads.data());
@@ -348,6 +616,83 @@ void Mesh::Display(Camera camera, int textureUnit, bool lines, bool useGroupColo
 	glBindVertexArray(0);
 }
 
+// Instanced Display
+
+void Mesh::DisplayInstanced(const Camera &camera, vector<mat4> &instances, vector<vec3> *colors,
+							bool nonUniformScale, int textureUnit, bool lines) {
+	bool useColors = colors && colors->size() >= instances.size();
+	DisplayInstanced(camera, instances.data(), instances.size(), useColors? colors->data() : NULL, nonUniformScale, textureUnit, lines);
+}
+
+void Mesh::DisplayInstanced(const Camera &camera, const mat4 *instances, int nInstances, const vec3 *colors,
+							bool nonUniformScale, int textureUnit, bool lines) {
+	if (!vao || nInstances <= 0)
+		return;
+	if (!dirtyPoints.Empty() || !dirtyNormals.Empty() || !dirtyUvs.Empty() || !dirtyTriangles.Empty())
+		UpdateBuffer();
+	// instance buffer: matrices (transposed, as GLSL mat4 attributes are columns), then colors
+	int sizeMatrices = nInstances*sizeof(mat4), sizeColors = colors? nInstances*sizeof(vec3) : 0;
+	if (!instanceVbo)
+		glGenBuffers(1, &instanceVbo);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+	if (sizeMatrices+sizeColors > instanceBufferSize)
+		instanceBufferSize = 2*(sizeMatrices+sizeColors);
+	// orphan previous storage so the GPU may still read it while this is written
+	glBufferData(GL_ARRAY_BUFFER, instanceBufferSize, NULL, GL_STREAM_DRAW);
+	char *data = (char *) glMapBufferRange(GL_ARRAY_BUFFER, 0, sizeMatrices+sizeColors, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (!data) {
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return;
+	}
+	mat4 *m = (mat4 *) data;
+	for (int i = 0; i < nInstances; i++)
+		m[i] = Transpose(instances[i]);
+	if (colors)
+		memcpy(data+sizeMatrices, colors, sizeColors);
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+	// per-instance attributes: mat4 at locations 3-6, color at 7
+	glBindVertexArray(vao);
+	for (int i = 0; i < 4; i++) {
+		glEnableVertexAttribArray(3+i);
+		glVertexAttribPointer(3+i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void *) (i*sizeof(vec4)));
+		glVertexAttribDivisor(3+i, 1);
+	}
+	if (colors) {
+		glEnableVertexAttribArray(7);
+		glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void *) (size_t) sizeMatrices);
+		glVertexAttribDivisor(7, 1);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	// shader
+	int shader = UseMeshShader(lines);
+	bool useTexture = textureName > 0 && uvs.size() > 0 && textureUnit >= 0;
+	SetUniform(shader, "useTexture", useTexture);
+	if (useTexture) {
+		glActiveTexture(GL_TEXTURE0+textureUnit);
+		glBindTexture(GL_TEXTURE_2D, textureName);
+		SetUniform(shader, "textureImage", textureUnit);
+	}
+	SetUniform(shader, "modelview", camera.modelview);
+	SetUniform(shader, "persp", camera.persp);
+	if (lines)
+		SetUniform(shader, "vp", Viewport());
+	SetUniform(shader, "color", color);
+	SetUniform(shader, "useInstance", true);
+	SetUniform(shader, "useInstanceColor", colors != NULL);
+	SetUniform(shader, "useInstanceNormalMatrix", nonUniformScale);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glDrawElementsInstanced(GL_TRIANGLES, 3*triangles.size(), GL_UNSIGNED_INT, 0, nInstances);
+	// restore non-instanced state
+	SetUniform(shader, "useInstance", false);
+	SetUniform(shader, "useInstanceColor", false);
+	SetUniform(shader, "useInstanceNormalMatrix", false);
+	for (int i = 3; i <= 7; i++) {
+		glDisableVertexAttribArray(i);
+		glVertexAttribDivisor(i, 0);
+	}
+	glBindVertexArray(0);
+}
+
 // Buffering
 
 void Enable(int id, int ncomps, int offset) {
@@ -358,32 +703,102 @@ void Enable(int id, int ncomps, int offset) {
 void Mesh::Buffer(vector<vec3> &pts, vector<vec3> *nrms, vector<vec2> *tex) {
 	size_t nPts = pts.size(), nNrms = nrms? nrms->size() : 0, nUvs = tex? tex->size() : 0;
 	if (!nPts) { printf("Buffer: no points!\n"); return; }
-	// create vertex buffer
+	// create vertex buffer (once)
 	if (!vbo)
 		glGenBuffers(1, &vbo);
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	// allocate GPU memory for vertex position, texture, normals
-	size_t sizePoints = nPts*sizeof(vec3), sizeNormals = nNrms*sizeof(vec3), sizeUvs = nUvs*sizeof(vec2);
+	// allocate GPU memory for vertex position, texture, normals; dynamic meshes allocate with headroom
+	vertexCapacity = dynamic? std::max((int) nPts, (int) (headroom*nPts)) : (int) nPts;
+	size_t sizePoints = vertexCapacity*sizeof(vec3);
+	size_t sizeNormals = nNrms? vertexCapacity*sizeof(vec3) : 0, sizeUvs = nUvs? vertexCapacity*sizeof(vec2) : 0;
 	int bufferSize = sizePoints+sizeUvs+sizeNormals;
-	glBufferData(GL_ARRAY_BUFFER, bufferSize, NULL, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, bufferSize, NULL, dynamic? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+	normalsOffset = nNrms? sizePoints : 0;
+	uvsOffset = nUvs? sizePoints+sizeNormals : 0;
 	// load vertex buffer
-	if (nPts) glBufferSubData(GL_ARRAY_BUFFER, 0, sizePoints, pts.data());
-	if (nNrms) glBufferSubData(GL_ARRAY_BUFFER, sizePoints, sizeNormals, nrms->data());
-	if (nUvs) glBufferSubData(GL_ARRAY_BUFFER, sizePoints+sizeNormals, sizeUvs, tex->data());
-	// create and load element buffer for triangles
-	size_t sizeTriangles = sizeof(int3)*triangles.size();
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeTriangles, triangles.data(), GL_STATIC_DRAW);
-	// create vertex array object for mesh
-	glGenVertexArrays(1, &vao);
+	if (nPts) glBufferSubData(GL_ARRAY_BUFFER, 0, nPts*sizeof(vec3), pts.data());
+	if (nNrms) glBufferSubData(GL_ARRAY_BUFFER, normalsOffset, nNrms*sizeof(vec3), nrms->data());
+	if (nUvs) glBufferSubData(GL_ARRAY_BUFFER, uvsOffset, nUvs*sizeof(vec2), tex->data());
+	// create (once) and load element buffer for triangles
+	if (!ebo)
+		glGenBuffers(1, &ebo);
+	BufferTriangles();
+	// create vertex array object for mesh (once)
+	if (!vao)
+		glGenVertexArrays(1, &vao);
 	glBindVertexArray(vao);
 	// enable attributes
 	if (nPts) Enable(0, 3, 0);						// VertexAttribPointer(shader, "point", 3, 0, (void *) 0);
-	if (nNrms) Enable(1, 3, sizePoints);			// VertexAttribPointer(shader, "normal", 3, 0, (void *) sizePoints);
-	if (nUvs) Enable(2, 2, sizePoints+sizeNormals); // VertexAttribPointer(shader, "uv", 2, 0, (void *) (sizePoints+sizeNormals));
+	if (nNrms) Enable(1, 3, normalsOffset);			// VertexAttribPointer(shader, "normal", 3, 0, (void *) sizePoints);
+	else glDisableVertexAttribArray(1);
+	if (nUvs) Enable(2, 2, uvsOffset);				// VertexAttribPointer(shader, "uv", 2, 0, (void *) (sizePoints+sizeNormals));
+	else glDisableVertexAttribArray(2);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
+	dirtyPoints.Clear();
+	dirtyNormals.Clear();
+	dirtyUvs.Clear();
+	dirtyTriangles.Clear();
+	SetBoundingVolumes(pts);
+}
+
+void Mesh::BufferTriangles() {
+	int nTriangles = triangles.size();
+	triangleCapacity = dynamic? std::max(nTriangles, (int) (headroom*nTriangles)) : nTriangles;
+	size_t sizeTriangles = sizeof(int3)*triangleCapacity, sizeLods = sizeof(int3)*lodTriangles.size();
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeTriangles+sizeLods, NULL, dynamic? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(int3)*nTriangles, triangles.data());
+	if (sizeLods)
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeTriangles, sizeLods, lodTriangles.data());
+}
+
+// Dynamic Buffering
+
+void Mesh::SetDynamic(bool d, bool persistent, float h) {
+	dynamic = d;
+	persistentUpload = persistent;
+	headroom = h < 1? 1 : h;
+	if (dynamic) {
+		lodTriangles.resize(0);
+		lods.resize(0);
+		meshlets.resize(0);
+	}
+	if (vbo)
+		Buffer();
+}
+
+void Mesh::MarkDirty(MeshData data, int start, int count) {
+	DirtyRange &r = data == MeshData::Points? dirtyPoints : data == MeshData::Normals? dirtyNormals :
+					data == MeshData::Uvs? dirtyUvs : dirtyTriangles;
+	int size = data == MeshData::Points? points.size() : data == MeshData::Normals? normals.size() :
+			   data == MeshData::Uvs? uvs.size() : triangles.size();
+	r.Mark(start, count < 0? size-start : count);
+}
+
+static void UploadRange(GLuint buffer, DirtyRange &r, int offset, int elementSize, const void *data, int n, bool persistent) {
+	int end = std::min(r.end, n);
+	if (end > r.begin)
+		UploadBuffer(buffer, offset+r.begin*elementSize, (end-r.begin)*elementSize, (char *) data+r.begin*elementSize, persistent);
+	r.Clear();
+}
+
+void Mesh::UpdateBuffer() {
+	// reallocate if arrays outgrew buffers, or normals or uvs were added or removed
+	if (!vbo || (int) points.size() > vertexCapacity || (int) triangles.size() > triangleCapacity ||
+		(normals.size() > 0) != (normalsOffset > 0) || (uvs.size() > 0) != (uvsOffset > 0)) {
+		Buffer();
+		return;
+	}
+	bool reshaped = !dirtyPoints.Empty() || !dirtyTriangles.Empty();
+	UploadRange(vbo, dirtyPoints, 0, sizeof(vec3), points.data(), points.size(), persistentUpload);
+	UploadRange(vbo, dirtyNormals, normalsOffset, sizeof(vec3), normals.data(), normals.size(), persistentUpload);
+	UploadRange(vbo, dirtyUvs, uvsOffset, sizeof(vec2), uvs.data(), uvs.size(), persistentUpload);
+	UploadRange(ebo, dirtyTriangles, 0, sizeof(int3), triangles.data(), triangles.size(), persistentUpload);
+	if (persistentUpload)
+		FenceUploads();
+	if (reshaped)
+		SetBoundingVolumes();
 }
 
 void Mesh::Clear() {
@@ -394,6 +809,11 @@ void Mesh::Clear() {
 	quads.resize(0);
 	triangleGroups.resize(0);
 	triangleMtls.resize(0);
+	lodTriangles.resize(0);
+	lods.resize(0);
+	meshlets.resize(0);
+	sdf.values.resize(0);
+	sdf.Release();
 }
 
 void Mesh::Buffer() { Buffer(points, normals.size()? &normals : NULL, uvs.size()? &uvs : NULL); }
@@ -422,9 +842,10 @@ bool Mesh::Read(string objFile, mat4 *m, bool standardize, bool buffer, bool for
 	objFilename = objFile;
 	if (standardize) {
 		Standardize(points.data(), points.size(), 1);
-		for (size_t i = 0; i < normals.size(); i++)
-			normals[i] = normalize(normals[i]);
+		NormalizeVectors(normals.data(), normals.size());
 	}
+	if (optimize)
+		Optimize(optimizeOverdraw);
 	if (buffer)
 		Buffer();
 	if (m)
@@ -0,0 +1,422 @@
+// MeshBatch.cpp - draw many meshes and triangle groups with a single glMultiDrawElementsIndirect
+
+#include "GLXtras.h"
+#include "MeshBatch.h"
+
+// Shader
+
+namespace {
+
+GLuint meshBatchShader = 0;
+
+// draw index arrives as a per-instance attribute (divisor 1) sourced from an identity buffer:
+// command baseInstance = draw index, so drawID selects this command's DrawData
+// (equivalent to gl_DrawID, which requires GLSL 4.6 or ARB_shader_draw_parameters)
+const char *meshBatchVertexShader = R"(
+	#version 430 core
+	layout (location = 0) in vec3 point;
+	layout (location = 1) in vec3 normal;
+	layout (location = 2) in vec2 uv;
+	layout (location = 3) in uint drawID;
+	struct DrawData {
+		layout (row_major) mat4 toWorld;
+		vec4 color;
+		vec4 material;
+	};
+	layout (std430, binding = 13) buffer Draws { DrawData draws[]; };
+	out vec3 vPoint;
+	out vec3 vNormal;
+	out vec2 vUv;
+	flat out vec4 vColor;
+	flat out vec3 vMaterial;
+	uniform mat4 modelview;
+	uniform mat4 persp;
+	void main() {
+		DrawData d = draws[drawID];
+		mat4 m = modelview*d.toWorld;
+		vPoint = (m*vec4(point, 1)).xyz;
+		vNormal = (m*vec4(normal, 0)).xyz;
+		vUv = uv;
+		vColor = d.color;
+		vMaterial = d.material.xyz;
+		gl_Position = persp*vec4(vPoint, 1);
+	}
+)";
+
+// as meshPixelShaderNoLines, but color, opacity and material per draw
+const char *meshBatchPixelShader = R"(
+	#version 430 core
+	in vec3 vPoint, vNormal;
+	in vec2 vUv;
+	flat in vec4 vColor;
+	flat in vec3 vMaterial;						// ambient, diffuse, specular
+	uniform int nLights = 0;
+	uniform vec3 lights[20];
+	uniform vec3 defaultLight = vec3(1, 1, 1);
+	uniform bool useLight = true;
+	uniform bool twoSidedShading = false;
+	uniform bool facetedShading = false;
+	out vec4 pColor;
+	float d = 0, s = 0;							// diffuse, specular terms
+	vec3 N, E;
+	void Intensity(vec3 light) {
+		vec3 L = normalize(light-vPoint);
+		float dd = dot(L, N);
+		bool sideLight = dd > 0;
+		bool sideViewer = gl_FrontFacing;
+		if (twoSidedShading || sideLight == sideViewer) {
+			d += abs(dd);
+			vec3 R = reflect(L, N);				// highlight vector
+			float h = max(0, dot(R, E));		// highlight term
+			s += pow(h, 50);					// specular term
+		}
+	}
+	void main() {
+		N = normalize(facetedShading? cross(dFdx(vPoint), dFdy(vPoint)) : vNormal);
+		E = normalize(vPoint);					// eye vector
+		float ads = 1;
+		if (useLight) {
+			if (nLights == 0)
+				Intensity(defaultLight);
+			else
+				for (int i = 0; i < nLights; i++)
+					Intensity(lights[i]);
+			ads = clamp(vMaterial.x+vMaterial.y*d, 0, 1)+vMaterial.z*s;
+		}
+		pColor = vec4(ads*vColor.rgb, vColor.a);
+	}
+)";
+
+static bool meshBatchRegistered = RegisterProgram("MeshBatch", &meshBatchVertexShader, &meshBatchPixelShader);
+
+struct BatchVertex {
+	vec3 point, normal;
+	vec2 uv;
+};
+
+const int drawDataBinding = 13;
+
+} // end namespace
+
+GLuint GetMeshBatchShader() {
+	if (!meshBatchShader)
+		meshBatchShader = LinkProgramViaCode(&meshBatchVertexShader, &meshBatchPixelShader);
+	return meshBatchShader;
+}
+
+// Range Allocation
+
+int RangeAllocator::Allocate(int count) {
+	for (size_t i = 0; i < free.size(); i++) {
+		Range &r = free[i];
+		if (r.count >= count) {
+			int start = r.start;
+			r.start += count;
+			r.count -= count;
+			if (!r.count)
+				free.erase(free.begin()+i);
+			return start;
+		}
+	}
+	return -1;
+}
+
+void RangeAllocator::Free(int start, int count) {
+	if (count <= 0)
+		return;
+	size_t i = 0;
+	while (i < free.size() && free[i].start < start)
+		i++;
+	free.insert(free.begin()+i, Range(start, count));
+	// coalesce with next, then previous
+	if (i+1 < free.size() && free[i].start+free[i].count == free[i+1].start) {
+		free[i].count += free[i+1].count;
+		free.erase(free.begin()+i+1);
+	}
+	if (i > 0 && free[i-1].start+free[i-1].count == free[i].start) {
+		free[i-1].count += free[i].count;
+		free.erase(free.begin()+i);
+	}
+}
+
+void RangeAllocator::Grow(int newCapacity) {
+	if (newCapacity > capacity) {
+		Free(capacity, newCapacity-capacity);
+		capacity = newCapacity;
+	}
+}
+
+// Shared Geometry Buffer
+
+MeshPool::MeshPool(int vertexCapacity, int indexCapacity) {
+	initialVertices = vertexCapacity;
+	initialIndices = indexCapacity;
+}
+
+void MeshPool::Init() {
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &ebo);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, initialVertices*sizeof(BatchVertex), NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, initialIndices*sizeof(int), NULL, GL_STATIC_DRAW);
+	vertices.Grow(initialVertices);
+	indices.Grow(initialIndices);
+	// interleaved attributes at mesh shader locations
+	int stride = sizeof(BatchVertex);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *) 0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *) sizeof(vec3));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void *) (2*sizeof(vec3)));
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+static GLuint GrowBuffer(GLuint buffer, int oldSize, int newSize) {
+	// return new buffer with contents of old; old is deleted
+	GLuint newBuffer = 0;
+	glGenBuffers(1, &newBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, newSize, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &buffer);
+	return newBuffer;
+}
+
+void MeshPool::GrowVertices(int minCapacity) {
+	int capacity = vertices.capacity;
+	while (capacity < minCapacity)
+		capacity *= 2;
+	vbo = GrowBuffer(vbo, vertices.capacity*sizeof(BatchVertex), capacity*sizeof(BatchVertex));
+	// re-point attributes to new buffer
+	int stride = sizeof(BatchVertex);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *) 0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *) sizeof(vec3));
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void *) (2*sizeof(vec3)));
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	vertices.Grow(capacity);
+}
+
+void MeshPool::GrowIndices(int minCapacity) {
+	int capacity = indices.capacity;
+	while (capacity < minCapacity)
+		capacity *= 2;
+	ebo = GrowBuffer(ebo, indices.capacity*sizeof(int), capacity*sizeof(int));
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBindVertexArray(0);
+	indices.Grow(capacity);
+}
+
+MeshAllocation *MeshPool::Find(Mesh *m) {
+	std::map<Mesh *, MeshAllocation>::iterator it = allocations.find(m);
+	return it == allocations.end()? NULL : &it->second;
+}
+
+bool MeshPool::Add(Mesh *m) {
+	int nVertices = m->points.size(), nIndices = 3*m->triangles.size();
+	if (!nVertices || !nIndices) { printf("MeshPool::Add: no points or triangles!\n"); return false; }
+	if (Find(m))
+		return Update(m);
+	if (!vao)
+		Init();
+	MeshAllocation a;
+	a.nVertices = nVertices;
+	a.nIndices = nIndices;
+	if ((a.firstVertex = vertices.Allocate(nVertices)) < 0) {
+		GrowVertices(vertices.capacity+nVertices);
+		a.firstVertex = vertices.Allocate(nVertices);
+	}
+	if ((a.firstIndex = indices.Allocate(nIndices)) < 0) {
+		GrowIndices(indices.capacity+nIndices);
+		a.firstIndex = indices.Allocate(nIndices);
+	}
+	// interleave and upload; triangle ids remain relative to mesh (command baseVertex = firstVertex)
+	bool hasNormals = m->normals.size() == (size_t) nVertices, hasUvs = m->uvs.size() == (size_t) nVertices;
+	vector<BatchVertex> v(nVertices);
+	for (int i = 0; i < nVertices; i++) {
+		v[i].point = m->points[i];
+		v[i].normal = hasNormals? m->normals[i] : vec3(0, 0, 1);
+		v[i].uv = hasUvs? m->uvs[i] : vec2(0, 0);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferSubData(GL_ARRAY_BUFFER, a.firstVertex*sizeof(BatchVertex), nVertices*sizeof(BatchVertex), v.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, a.firstIndex*sizeof(int), nIndices*sizeof(int), m->triangles.data());
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	allocations[m] = a;
+	return true;
+}
+
+bool MeshPool::Update(Mesh *m) {
+	Remove(m);
+	return Add(m);
+}
+
+void MeshPool::Remove(Mesh *m) {
+	MeshAllocation *a = Find(m);
+	if (a) {
+		vertices.Free(a->firstVertex, a->nVertices);
+		indices.Free(a->firstIndex, a->nIndices);
+		allocations.erase(m);
+	}
+}
+
+void MeshPool::Release() {
+	if (vbo) glDeleteBuffers(1, &vbo);
+	if (ebo) glDeleteBuffers(1, &ebo);
+	if (vao) glDeleteVertexArrays(1, &vao);
+	vao = vbo = ebo = 0;
+	vertices = RangeAllocator();
+	indices = RangeAllocator();
+	allocations.clear();
+}
+
+// Per-Frame Batch
+
+bool MeshBatch::Add(Mesh *m, vec4 material) {
+	if (!pool.Add(m))
+		return false;
+	for (size_t i = 0; i < entries.size(); i++)
+		if (entries[i].mesh == m) {
+			entries[i].material = material;
+			return true;
+		}
+	entries.push_back({m, material});
+	return true;
+}
+
+bool MeshBatch::Update(Mesh *m) {
+	return pool.Update(m);
+}
+
+void MeshBatch::Remove(Mesh *m) {
+	pool.Remove(m);
+	for (size_t i = 0; i < entries.size(); i++)
+		if (entries[i].mesh == m) {
+			entries.erase(entries.begin()+i);
+			break;
+		}
+}
+
+void MeshBatch::Reserve(int n) {
+	// size indirect, draw data, and draw id buffers for at least n draws
+	if (n <= drawCapacity)
+		return;
+	int capacity = drawCapacity? drawCapacity : 64;
+	while (capacity < n)
+		capacity *= 2;
+	if (!indirectBuffer) {
+		glGenBuffers(1, &indirectBuffer);
+		glGenBuffers(1, &drawBuffer);
+		glGenBuffers(1, &drawIdBuffer);
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity*sizeof(DrawElementsIndirectCommand), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, capacity*sizeof(DrawData), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	// identity draw ids, per-instance attribute at location 3
+	vector<GLuint> ids(capacity);
+	for (int i = 0; i < capacity; i++)
+		ids[i] = i;
+	glBindVertexArray(pool.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+	glBufferData(GL_ARRAY_BUFFER, capacity*sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+	glEnableVertexAttribArray(3);
+	glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, 0, (void *) 0);
+	glVertexAttribDivisor(3, 1);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	drawCapacity = capacity;
+}
+
+void MeshBatch::Display(const Camera &camera, bool useGroupColor, float opacity) {
+	commands.resize(0);
+	drawData.resize(0);
+	nMeshesDrawn = 0;
+	auto AddCommand = [this](MeshAllocation *a, int startTriangle, int nTriangles, Entry &e, vec3 color, float opacity) {
+		if (nTriangles <= 0)
+			return;
+		GLuint id = drawData.size();
+		commands.push_back({(GLuint) (3*nTriangles), 1, (GLuint) (a->firstIndex+3*startTriangle), a->firstVertex, id});
+		drawData.push_back({e.mesh->toWorld, vec4(color, opacity), e.material});
+	};
+	for (size_t i = 0; i < entries.size(); i++) {
+		Entry &e = entries[i];
+		Mesh *m = e.mesh;
+		MeshAllocation *a = pool.Find(m);
+		if (!a || m->culled)
+			continue;
+		nMeshesDrawn++;
+		int nTris = m->triangles.size(), nGroups = m->triangleGroups.size();
+		int nUngrouped = nGroups? m->triangleGroups[0].startTriangle : nTris;
+		bool someGroupsCulled = false;
+		for (int k = 0; k < (int) m->groupCulled.size(); k++)
+			someGroupsCulled = someGroupsCulled || m->groupCulled[k];
+		if (useGroupColor) {
+			AddCommand(a, 0, nUngrouped, e, m->color, opacity);
+			for (int k = 0; k < nGroups; k++) {
+				if (someGroupsCulled && m->groupCulled[k])
+					continue;
+				Group &g = m->triangleGroups[k];
+				AddCommand(a, g.startTriangle, g.nTriangles, e, g.color, opacity);
+			}
+		}
+		else if (!someGroupsCulled)
+			AddCommand(a, 0, nTris, e, m->color, opacity);
+		else {
+			// ungrouped triangles, then each run of contiguous visible groups
+			AddCommand(a, 0, nUngrouped, e, m->color, opacity);
+			for (int k = 0; k < nGroups; k++) {
+				if (m->groupCulled[k])
+					continue;
+				int start = m->triangleGroups[k].startTriangle, n = 0;
+				for (; k < nGroups && !m->groupCulled[k]; k++)
+					n += m->triangleGroups[k].nTriangles;
+				AddCommand(a, start, n, e, m->color, opacity);
+			}
+		}
+	}
+	nDraws = commands.size();
+	if (!nDraws)
+		return;
+	Reserve(nDraws);
+	// upload commands and per-draw data
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, nDraws*sizeof(DrawElementsIndirectCommand), commands.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, nDraws*sizeof(DrawData), drawData.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, drawDataBinding, drawBuffer);
+	// draw
+	GLuint shader = GetMeshBatchShader();
+	glUseProgram(shader);
+	SetUniform(shader, "modelview", camera.modelview);
+	SetUniform(shader, "persp", camera.persp);
+	glBindVertexArray(pool.vao);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *) 0, nDraws, 0);
+	glBindVertexArray(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void MeshBatch::Release() {
+	if (indirectBuffer) glDeleteBuffers(1, &indirectBuffer);
+	if (drawBuffer) glDeleteBuffers(1, &drawBuffer);
+	if (drawIdBuffer) glDeleteBuffers(1, &drawIdBuffer);
+	indirectBuffer = drawBuffer = drawIdBuffer = 0;
+	drawCapacity = 0;
+	pool.Release();
+}
@@ -0,0 +1,269 @@
+// MeshOptimize.cpp - reorder triangles and vertices for post-transform cache, overdraw, and vertex fetch
+
+#include <algorithm>
+#include "MeshOptimize.h"
+
+namespace {
+
+const int maxCacheSize = 64;
+
+float VertexScore(int cachePosition, int nRemaining, int cacheSize) {
+	// Forsyth: recently used vertices score high (last triangle's three equally),
+	// vertices with few remaining triangles are boosted so they are finished off
+	if (nRemaining == 0)
+		return -1;
+	float score = 0;
+	if (cachePosition >= 0)
+		score = cachePosition < 3? .75f : pow(1-(float) (cachePosition-3)/(cacheSize-3), 1.5f);
+	return score+2*pow((float) nRemaining, -.5f);
+}
+
+struct FifoCache {
+	// vertex v is cached if fewer than size misses have occurred since v was loaded
+	vector<int> stamps;
+	int size, time;
+	FifoCache(int nVertices, int size) : stamps(nVertices, -maxCacheSize-size), size(size), time(0) { }
+	bool Miss(int v) {
+		if (time-stamps[v] < size)
+			return false;
+		stamps[v] = time++;
+		return true;
+	}
+};
+
+int MaxVertex(vector<int3> &triangles, int start, int n) {
+	int max = -1;
+	for (int t = start; t < start+n; t++)
+		max = std::max(max, std::max(triangles[t].i1, std::max(triangles[t].i2, triangles[t].i3)));
+	return max;
+}
+
+} // end namespace
+
+float ACMR(vector<int3> &triangles, int cacheSize) {
+	int nTriangles = triangles.size(), nMisses = 0;
+	if (!nTriangles)
+		return 0;
+	FifoCache cache(MaxVertex(triangles, 0, nTriangles)+1, cacheSize);
+	for (int t = 0; t < nTriangles; t++)
+		for (int k = 0; k < 3; k++)
+			nMisses += cache.Miss(triangles[t][k]);
+	return (float) nMisses/nTriangles;
+}
+
+// Vertex Cache
+
+void OptimizeVertexCache(vector<int3> &triangles, int start, int n, int cacheSize) {
+	if (n < 2)
+		return;
+	cacheSize = std::min(std::max(cacheSize, 4), maxCacheSize);
+	// local vertex ids
+	vector<int> vids(3*n);
+	for (int t = 0; t < n; t++)
+		for (int k = 0; k < 3; k++)
+			vids[3*t+k] = triangles[start+t][k];
+	std::sort(vids.begin(), vids.end());
+	vids.erase(std::unique(vids.begin(), vids.end()), vids.end());
+	int nVertices = vids.size();
+	vector<int3> tris(n);
+	for (int t = 0; t < n; t++)
+		for (int k = 0; k < 3; k++)
+			tris[t][k] = (int) (std::lower_bound(vids.begin(), vids.end(), triangles[start+t][k])-vids.begin());
+	// vertex-to-triangle adjacency: active triangles of v are adjacent[offsets[v]] to adjacent[offsets[v]+nRemaining[v]-1]
+	vector<int> offsets(nVertices+1, 0), nRemaining(nVertices, 0), adjacent(3*n);
+	for (int t = 0; t < n; t++)
+		for (int k = 0; k < 3; k++)
+			nRemaining[tris[t][k]]++;
+	for (int v = 0; v < nVertices; v++)
+		offsets[v+1] = offsets[v]+nRemaining[v];
+	vector<int> fill(offsets.begin(), offsets.end()-1);
+	for (int t = 0; t < n; t++)
+		for (int k = 0; k < 3; k++)
+			adjacent[fill[tris[t][k]]++] = t;
+	// scores
+	vector<int> cachePositions(nVertices, -1);
+	vector<float> vertexScores(nVertices), triangleScores(n);
+	vector<char> emitted(n, 0);
+	for (int v = 0; v < nVertices; v++)
+		vertexScores[v] = VertexScore(-1, nRemaining[v], cacheSize);
+	int best = -1;
+	for (int t = 0; t < n; t++) {
+		triangleScores[t] = vertexScores[tris[t].i1]+vertexScores[tris[t].i2]+vertexScores[tris[t].i3];
+		if (best < 0 || triangleScores[t] > triangleScores[best])
+			best = t;
+	}
+	vector<int> cache, newCache;
+	vector<int3> result;
+	result.reserve(n);
+	for (int cursor = 0; (int) result.size() < n; ) {
+		if (best < 0) {
+			// no cached vertex has remaining triangles: take next unemitted triangle
+			while (emitted[cursor])
+				cursor++;
+			best = cursor;
+		}
+		int3 &tri = tris[best];
+		result.push_back(tri);
+		emitted[best] = 1;
+		// remove best from adjacency of its vertices
+		for (int k = 0; k < 3; k++) {
+			int v = tri[k], *a = &adjacent[offsets[v]], &nr = nRemaining[v];
+			for (int i = 0; i < nr; i++)
+				if (a[i] == best) {
+					a[i] = a[--nr];
+					break;
+				}
+		}
+		// move triangle vertices to front of cache
+		newCache.assign(&tri.i1, &tri.i1+3);
+		for (size_t i = 0; i < cache.size(); i++)
+			if (cache[i] != tri.i1 && cache[i] != tri.i2 && cache[i] != tri.i3)
+				newCache.push_back(cache[i]);
+		cache.swap(newCache);
+		// update vertex scores, including vertices pushed out of cache
+		for (int i = 0; i < (int) cache.size(); i++) {
+			int v = cache[i];
+			cachePositions[v] = i < cacheSize? i : -1;
+			vertexScores[v] = VertexScore(cachePositions[v], nRemaining[v], cacheSize);
+		}
+		// update triangle scores near cache, find best
+		best = -1;
+		float bestScore = -1;
+		for (int i = 0; i < (int) cache.size(); i++) {
+			int v = cache[i];
+			for (int a = offsets[v]; a < offsets[v]+nRemaining[v]; a++) {
+				int t = adjacent[a];
+				float s = vertexScores[tris[t].i1]+vertexScores[tris[t].i2]+vertexScores[tris[t].i3];
+				triangleScores[t] = s;
+				if (s > bestScore) {
+					bestScore = s;
+					best = t;
+				}
+			}
+		}
+		if ((int) cache.size() > cacheSize)
+			cache.resize(cacheSize);
+	}
+	for (int t = 0; t < n; t++)
+		triangles[start+t] = int3(vids[result[t].i1], vids[result[t].i2], vids[result[t].i3]);
+}
+
+// Overdraw
+
+void OptimizeOverdraw(vector<vec3> &points, vector<int3> &triangles, int start, int n, int cacheSize, int minCluster) {
+	if (n < 2*minCluster)
+		return;
+	// split where all three vertices of a triangle miss the cache
+	vector<int> clusterStarts(1, start);
+	FifoCache cache(MaxVertex(triangles, start, n)+1, cacheSize);
+	for (int t = start; t < start+n; t++) {
+		int3 &tri = triangles[t];
+		int nMisses = cache.Miss(tri.i1)+cache.Miss(tri.i2)+cache.Miss(tri.i3);
+		if (nMisses == 3 && t-clusterStarts.back() >= minCluster)
+			clusterStarts.push_back(t);
+	}
+	int nClusters = clusterStarts.size();
+	if (nClusters < 2)
+		return;
+	clusterStarts.push_back(start+n);
+	// area-weighted centroid and normal of each cluster, and of range
+	vector<vec3> centroids(nClusters), normals(nClusters);
+	vec3 centroid;
+	float area = 0;
+	for (int c = 0; c < nClusters; c++) {
+		float clusterArea = 0;
+		for (int t = clusterStarts[c]; t < clusterStarts[c+1]; t++) {
+			vec3 p1 = points[triangles[t].i1], p2 = points[triangles[t].i2], p3 = points[triangles[t].i3];
+			vec3 nrm = cross(p2-p1, p3-p1);
+			float a = length(nrm);
+			centroids[c] += a*(p1+p2+p3)/3;
+			normals[c] += nrm;
+			clusterArea += a;
+		}
+		centroid += centroids[c];
+		area += clusterArea;
+		if (clusterArea > 0)
+			centroids[c] /= clusterArea;
+	}
+	if (area > 0)
+		centroid /= area;
+	// clusters facing away from the center (likely occluders) first
+	vector<float> keys(nClusters);
+	vector<int> order(nClusters);
+	for (int c = 0; c < nClusters; c++) {
+		float len = length(normals[c]);
+		keys[c] = len > 0? dot(centroids[c]-centroid, normals[c]/len) : 0;
+		order[c] = c;
+	}
+	std::stable_sort(order.begin(), order.end(), [&keys](int a, int b) { return keys[a] > keys[b]; });
+	vector<int3> copy(triangles.begin()+start, triangles.begin()+start+n);
+	int t = start;
+	for (int i = 0; i < nClusters; i++) {
+		int c = order[i];
+		for (int s = clusterStarts[c]; s < clusterStarts[c+1]; s++)
+			triangles[t++] = copy[s-start];
+	}
+}
+
+// Vertex Fetch
+
+void OptimizeVertexFetch(vector<int3> &triangles, int nVertices, vector<int> &remap, vector<int4> *quads) {
+	remap.assign(nVertices, -1);
+	int next = 0;
+	for (size_t t = 0; t < triangles.size(); t++)
+		for (int k = 0; k < 3; k++) {
+			int &v = triangles[t][k];
+			if (remap[v] < 0)
+				remap[v] = next++;
+			v = remap[v];
+		}
+	if (quads)
+		for (size_t q = 0; q < quads->size(); q++)
+			for (int k = 0; k < 4; k++) {
+				int &v = (*quads)[q][k];
+				if (remap[v] < 0)
+					remap[v] = next++;
+				v = remap[v];
+			}
+	for (int v = 0; v < nVertices; v++)
+		if (remap[v] < 0)
+			remap[v] = next++;
+}
+
+// Mesh
+
+void OptimizeMesh(vector<vec3> &points, vector<vec3> &normals, vector<vec2> &uvs,
+				  vector<int3> &triangles, vector<int4> &quads, vector<Group> &groups, vector<Mtl> &mtls,
+				  bool overdraw, float *acmrBefore, float *acmrAfter) {
+	int nTriangles = triangles.size();
+	if (acmrBefore)
+		*acmrBefore = ACMR(triangles);
+	// reorder only within ranges bounded by groups and materials
+	vector<int> bounds = { 0, nTriangles };
+	for (size_t i = 0; i < groups.size(); i++) {
+		bounds.push_back(groups[i].startTriangle);
+		bounds.push_back(groups[i].startTriangle+groups[i].nTriangles);
+	}
+	for (size_t i = 0; i < mtls.size(); i++)
+		if (mtls[i].startTriangle >= 0) {
+			bounds.push_back(mtls[i].startTriangle);
+			bounds.push_back(mtls[i].startTriangle+mtls[i].nTriangles);
+		}
+	std::sort(bounds.begin(), bounds.end());
+	bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+	for (size_t i = 0; i+1 < bounds.size(); i++) {
+		int start = bounds[i], n = std::min(bounds[i+1], nTriangles)-start;
+		if (start < 0 || n < 2)
+			continue;
+		OptimizeVertexCache(triangles, start, n);
+		if (overdraw)
+			OptimizeOverdraw(points, triangles, start, n);
+	}
+	vector<int> remap;
+	OptimizeVertexFetch(triangles, points.size(), remap, &quads);
+	Remap(points, remap);
+	Remap(normals, remap);
+	Remap(uvs, remap);
+	if (acmrAfter)
+		*acmrAfter = ACMR(triangles);
+}
@@ -0,0 +1,572 @@
+// MeshStream.cpp - out-of-core meshes: spatially chunked files, memory mapped, paged into a GPU pool
+
+#include <algorithm>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+#include "Draw.h"
+#include "GLXtras.h"
+#include "MeshStream.h"
+#include "Normals.h"
+
+// Chunk Writing
+
+namespace {
+
+const int chunkAlignment = 4096;			// chunk data starts on these boundaries in the file
+
+class ChunkWriter {
+public:
+	FILE *out = NULL;
+	ChunkFileHeader header;
+	vector<ChunkInfo> infos;
+	uint64_t offset = 0;
+	vector<int> vids;
+	vector<vec3> chunkPoints, chunkNormals;
+	vector<int3> chunkTriangles;
+	bool Begin(const char *filename) {
+		out = fopen(filename, "wb");
+		if (!out)
+			return false;
+		Write(&header, sizeof(header));
+		return true;
+	}
+	void Write(const void *data, uint64_t nBytes) {
+		fwrite(data, 1, (size_t) nBytes, out);
+		offset += nBytes;
+	}
+	void Pad() {
+		static char zeros[chunkAlignment] = { 0 };
+		int n = (int) (offset%chunkAlignment);
+		if (n)
+			Write(zeros, chunkAlignment-n);
+	}
+	void AddChunk(vector<vec3> &points, vector<vec3> &normals, vector<int3> &triangles, int *ids, int n) {
+		// write triangles ids[0] to ids[n-1] with chunk-local vertices
+		vids.resize(3*n);
+		for (int t = 0; t < n; t++)
+			for (int k = 0; k < 3; k++)
+				vids[3*t+k] = triangles[ids[t]][k];
+		std::sort(vids.begin(), vids.end());
+		vids.erase(std::unique(vids.begin(), vids.end()), vids.end());
+		int nVertices = vids.size();
+		chunkPoints.resize(nVertices);
+		chunkNormals.resize(nVertices);
+		for (int v = 0; v < nVertices; v++) {
+			chunkPoints[v] = points[vids[v]];
+			chunkNormals[v] = normals[vids[v]];
+		}
+		chunkTriangles.resize(n);
+		for (int t = 0; t < n; t++)
+			for (int k = 0; k < 3; k++)
+				chunkTriangles[t][k] = (int) (std::lower_bound(vids.begin(), vids.end(), triangles[ids[t]][k])-vids.begin());
+		ChunkInfo info;
+		Bounds(chunkPoints.data(), nVertices, info.min, info.max);
+		info.center = .5f*(info.min+info.max);
+		for (int v = 0; v < nVertices; v++)
+			info.radius = std::max(info.radius, length(chunkPoints[v]-info.center));
+		info.nVertices = nVertices;
+		info.nTriangles = n;
+		Pad();
+		info.offset = offset;
+		Write(chunkPoints.data(), nVertices*sizeof(vec3));
+		Write(chunkNormals.data(), nVertices*sizeof(vec3));
+		Write(chunkTriangles.data(), n*sizeof(int3));
+		infos.push_back(info);
+		header.maxVertices = std::max(header.maxVertices, nVertices);
+		header.maxTriangles = std::max(header.maxTriangles, n);
+	}
+	bool End(vec3 min, vec3 max) {
+		Pad();
+		header.nChunks = infos.size();
+		header.tableOffset = offset;
+		header.min = min;
+		header.max = max;
+		Write(infos.data(), infos.size()*sizeof(ChunkInfo));
+		fseek(out, 0, SEEK_SET);
+		fwrite(&header, sizeof(header), 1, out);
+		bool ok = !ferror(out);
+		fclose(out);
+		out = NULL;
+		return ok;
+	}
+};
+
+void SplitChunks(vector<vec3> &centroids, int *ids, int n, int maxTriangles, vector<int2> &leaves, int start = 0) {
+	// reorder ids so each leaf (start, count) of at most maxTriangles is spatially coherent
+	if (n <= maxTriangles) {
+		leaves.push_back(int2(start, n));
+		return;
+	}
+	vec3 min(FLT_MAX), max(-FLT_MAX);
+	for (int i = 0; i < n; i++) {
+		vec3 &c = centroids[ids[i]];
+		for (int k = 0; k < 3; k++) {
+			min[k] = std::min(min[k], c[k]);
+			max[k] = std::max(max[k], c[k]);
+		}
+	}
+	vec3 d = max-min;
+	int axis = d.x > d.y? (d.x > d.z? 0 : 2) : (d.y > d.z? 1 : 2), half = n/2;
+	std::nth_element(ids, ids+half, ids+n, [&centroids, axis](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+	SplitChunks(centroids, ids, half, maxTriangles, leaves, start);
+	SplitChunks(centroids, ids+half, n-half, maxTriangles, leaves, start+half);
+}
+
+void WriteChunks(ChunkWriter &writer, vector<vec3> &points, vector<vec3> &normals, vector<int3> &triangles, int maxTriangles) {
+	int n = triangles.size();
+	vector<vec3> centroids(n);
+	vector<int> ids(n);
+	for (int t = 0; t < n; t++) {
+		centroids[t] = (points[triangles[t].i1]+points[triangles[t].i2]+points[triangles[t].i3])/3;
+		ids[t] = t;
+	}
+	vector<int2> leaves;
+	SplitChunks(centroids, ids.data(), n, maxTriangles, leaves);
+	for (size_t i = 0; i < leaves.size(); i++)
+		writer.AddChunk(points, normals, triangles, ids.data()+leaves[i].i1, leaves[i].i2);
+}
+
+} // end namespace
+
+bool WriteChunkedMesh(const char *filename, vector<vec3> &points, vector<int3> &triangles, vector<vec3> *normals, int maxTriangles) {
+	if (!points.size() || !triangles.size()) { printf("WriteChunkedMesh: no points or triangles!\n"); return false; }
+	vector<vec3> computed;
+	if (!normals || normals->size() != points.size())
+		ComputeVertexNormals(points, triangles, computed);
+	ChunkWriter writer;
+	if (!writer.Begin(filename)) { printf("WriteChunkedMesh: can't write %s\n", filename); return false; }
+	WriteChunks(writer, points, computed.size()? computed : *normals, triangles, std::max(1, maxTriangles));
+	vec3 min, max;
+	Bounds(points.data(), points.size(), min, max);
+	return writer.End(min, max);
+}
+
+// OBJ Conversion
+
+namespace {
+
+const int nBins = 4;						// per axis
+
+bool ReadFace(const char *ptr, vector<int> &ids, int nPointsRead, int nPoints) {
+	// vertex ids of "f" line (1-based, or negative relative to nPointsRead, with optional /uv/normal ids)
+	// to 0-based ids
+	ids.resize(0);
+	for (;;) {
+		ptr += strspn(ptr, " \t\r\n");
+		if (!*ptr)
+			break;
+		char *end;
+		long id = strtol(ptr, &end, 10);
+		if (end == ptr)
+			return false;
+		id = id < 0? nPointsRead+id : id-1;
+		if (id < 0 || id >= nPoints)
+			return false;
+		ids.push_back((int) id);
+		ptr = end+strcspn(end, " \t\r\n");
+	}
+	return ids.size() >= 3;
+}
+
+} // end namespace
+
+bool ConvertObjToChunked(const char *objFilename, const char *chunkFilename, int maxTriangles) {
+	FILE *in = fopen(objFilename, "r");
+	if (!in) { printf("ConvertObjToChunked: can't read %s\n", objFilename); return false; }
+	char line[4096];
+	vec3 v;
+	// pass 1: points
+	vector<vec3> points;
+	while (fgets(line, sizeof(line), in))
+		if (line[0] == 'v' && (line[1] == ' ' || line[1] == '\t') && sscanf(line+2, "%g%g%g", &v.x, &v.y, &v.z) == 3)
+			points.push_back(v);
+	if (!points.size()) {
+		fclose(in);
+		printf("ConvertObjToChunked: no points in %s\n", objFilename);
+		return false;
+	}
+	vec3 min, max;
+	Bounds(points.data(), points.size(), min, max);
+	vec3 range = max-min;
+	for (int k = 0; k < 3; k++)
+		range[k] = range[k] > 0? range[k] : 1;
+	// pass 2: bin triangles by centroid, accumulate area-weighted normals
+	vector<vec3> normals(points.size());
+	FILE *bins[nBins*nBins*nBins] = { NULL };
+	for (int i = 0; i < nBins*nBins*nBins; i++)
+		if (!(bins[i] = tmpfile())) {
+			printf("ConvertObjToChunked: can't open temporary file\n");
+			for (int k = 0; k < i; k++)
+				fclose(bins[k]);
+			fclose(in);
+			return false;
+		}
+	rewind(in);
+	vector<int> ids;
+	int nPointsRead = 0, nBadFaces = 0, nTriangles = 0;
+	while (fgets(line, sizeof(line), in)) {
+		if (line[0] == 'v' && (line[1] == ' ' || line[1] == '\t'))
+			nPointsRead++;
+		if (line[0] != 'f' || (line[1] != ' ' && line[1] != '\t'))
+			continue;
+		if (!ReadFace(line+2, ids, nPointsRead, points.size())) {
+			nBadFaces++;
+			continue;
+		}
+		for (size_t i = 1; i+1 < ids.size(); i++) {
+			int3 t(ids[0], ids[i], ids[i+1]);
+			vec3 p1 = points[t.i1], p2 = points[t.i2], p3 = points[t.i3], n = cross(p2-p1, p3-p1);
+			normals[t.i1] += n;
+			normals[t.i2] += n;
+			normals[t.i3] += n;
+			vec3 c = (p1+p2+p3)/3;
+			int b[3];
+			for (int k = 0; k < 3; k++)
+				b[k] = std::min(nBins-1, std::max(0, (int) (nBins*(c[k]-min[k])/range[k])));
+			fwrite(&t, sizeof(int3), 1, bins[b[0]+nBins*(b[1]+nBins*b[2])]);
+			nTriangles++;
+		}
+	}
+	fclose(in);
+	if (nBadFaces)
+		printf("ConvertObjToChunked: %i bad faces skipped\n", nBadFaces);
+	if (!nTriangles) {
+		printf("ConvertObjToChunked: no valid faces in %s\n", objFilename);
+		for (int i = 0; i < nBins*nBins*nBins; i++)
+			fclose(bins[i]);
+		return false;
+	}
+	NormalizeVectors(normals.data(), normals.size());
+	// pass 3: partition and write each bin
+	ChunkWriter writer;
+	bool ok = writer.Begin(chunkFilename);
+	vector<int3> triangles;
+	for (int i = 0; i < nBins*nBins*nBins; i++) {
+		FILE *bin = bins[i];
+		if (ok) {
+			long nBytes = ftell(bin);
+			triangles.resize(nBytes/sizeof(int3));
+			rewind(bin);
+			if (triangles.size() && fread(triangles.data(), sizeof(int3), triangles.size(), bin) == triangles.size())
+				WriteChunks(writer, points, normals, triangles, std::max(1, maxTriangles));
+		}
+		fclose(bin);
+	}
+	if (!ok) { printf("ConvertObjToChunked: can't write %s\n", chunkFilename); return false; }
+	return writer.End(min, max);
+}
+
+// Memory-Mapped File
+
+namespace {
+
+uintptr_t PageSize() {
+	// of the host (eg, 4KB, or 16KB on Apple silicon)
+	static uintptr_t pageSize = 0;
+	if (!pageSize) {
+#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		pageSize = info.dwPageSize;
+#else
+		long n = sysconf(_SC_PAGESIZE);
+		pageSize = n > 0? (uintptr_t) n : 4096;
+#endif
+	}
+	return pageSize;
+}
+
+bool WholePages(const void *p, uint64_t nBytes, uintptr_t &begin, uintptr_t &end) {
+	// the pages entirely within p to p+nBytes; false if none
+	uintptr_t size = PageSize();
+	begin = ((uintptr_t) p+size-1)/size*size;
+	end = ((uintptr_t) p+nBytes)/size*size;
+	return end > begin;
+}
+
+} // end namespace
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const char *filename) {
+	Close();
+	file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = NULL;
+		return false;
+	}
+	LARGE_INTEGER s;
+	GetFileSizeEx(file, &s);
+	size = (uint64_t) s.QuadPart;
+	mapping = size? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	data = mapping? (const char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (!data)
+		Close();
+	return data != NULL;
+}
+
+void MappedFile::Close() {
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+	data = NULL;
+	mapping = file = NULL;
+	size = 0;
+}
+
+void MappedFile::Evict(const void *p, uint64_t nBytes) {
+	// unlocking pages that are not locked removes them from the working set (whole pages only, as
+	// pages partly outside the range may hold a neighboring chunk)
+	uintptr_t begin, end;
+	if (WholePages(p, nBytes, begin, end))
+		VirtualUnlock((void *) begin, (SIZE_T) (end-begin));
+}
+
+#else
+
+bool MappedFile::Open(const char *filename) {
+	Close();
+	if ((fd = open(filename, O_RDONLY)) < 0)
+		return false;
+	struct stat info;
+	if (fstat(fd, &info) == 0 && info.st_size > 0) {
+		size = (uint64_t) info.st_size;
+		void *p = mmap(NULL, (size_t) size, PROT_READ, MAP_SHARED, fd, 0);
+		if (p != MAP_FAILED) {
+			data = (const char *) p;
+			madvise(p, (size_t) size, MADV_RANDOM);
+		}
+	}
+	if (!data)
+		Close();
+	return data != NULL;
+}
+
+void MappedFile::Close() {
+	if (data) munmap((void *) data, (size_t) size);
+	if (fd >= 0) close(fd);
+	data = NULL;
+	fd = -1;
+	size = 0;
+}
+
+void MappedFile::Evict(const void *p, uint64_t nBytes) {
+	// whole pages only; file-backed pages are re-read on next access
+	uintptr_t begin, end;
+	if (WholePages(p, nBytes, begin, end))
+		madvise((void *) begin, end-begin, MADV_DONTNEED);
+}
+
+#endif
+
+// Chunked Mesh
+
+bool ChunkedMesh::Open(const char *filename) {
+	Close();
+	if (!file.Open(filename)) { printf("ChunkedMesh::Open: can't map %s\n", filename); return false; }
+	if (file.size < sizeof(ChunkFileHeader)) { printf("ChunkedMesh::Open: %s too small\n", filename); Close(); return false; }
+	header = *(const ChunkFileHeader *) file.data;
+	if (strncmp(header.magic, "MCHK", 4) || header.version != 1 || header.nChunks <= 0 ||
+		header.maxVertices <= 0 || header.maxTriangles <= 0 ||
+		header.tableOffset > file.size || (uint64_t) header.nChunks*sizeof(ChunkInfo) > file.size-header.tableOffset) {
+		printf("ChunkedMesh::Open: %s not a chunked mesh (or empty)\n", filename);
+		Close();
+		return false;
+	}
+	chunks = (const ChunkInfo *) (file.data+header.tableOffset);
+	for (int i = 0; i < header.nChunks; i++) {
+		// chunk data must lie within the file, and sizes within the header maxima (used to size pools)
+		const ChunkInfo &c = chunks[i];
+		uint64_t nBytes = (uint64_t) c.nVertices*2*sizeof(vec3)+(uint64_t) c.nTriangles*sizeof(int3);
+		if (c.nVertices < 0 || c.nTriangles < 0 || c.nVertices > header.maxVertices || c.nTriangles > header.maxTriangles ||
+			c.offset > file.size || nBytes > file.size-c.offset) {
+			printf("ChunkedMesh::Open: %s chunk %i corrupt\n", filename, i);
+			Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void ChunkedMesh::Close() {
+	file.Close();
+	header = ChunkFileHeader();
+	chunks = NULL;
+}
+
+bool ChunkedMesh::Read(int chunk, Mesh &mesh, bool buffer) {
+	if (chunk < 0 || chunk >= header.nChunks)
+		return false;
+	const ChunkInfo &c = chunks[chunk];
+	mesh.Clear();
+	mesh.points.assign(Points(chunk), Points(chunk)+c.nVertices);
+	mesh.normals.assign(Normals(chunk), Normals(chunk)+c.nVertices);
+	mesh.triangles.assign(Triangles(chunk), Triangles(chunk)+c.nTriangles);
+	if (buffer)
+		mesh.Buffer();
+	return true;
+}
+
+// Streamed Mesh
+
+bool StreamedMesh::Open(const char *filename, bool standardize, uint64_t budget) {
+	Release();
+	if (!source.Open(filename))
+		return false;
+	ChunkFileHeader &h = source.header;
+	if (standardize) {
+		vec3 bounds[] = { h.min, h.max };
+		toWorld = StandardizeMat(bounds, 2);
+	}
+	gpuBudget = budget;
+	uint64_t slotBytes = (uint64_t) h.maxVertices*2*sizeof(vec3)+(uint64_t) h.maxTriangles*sizeof(int3);
+	if (h.nChunks <= 0 || !slotBytes) {
+		printf("StreamedMesh::Open: %s has no chunks\n", filename);
+		source.Close();
+		return false;
+	}
+	// pool offsets are int (as UploadBuffer), so pools stay under 2GB
+	uint64_t budgetBytes = std::min(gpuBudget, (uint64_t) 0x7fffffff);
+	nSlots = (int) std::min((uint64_t) h.nChunks, std::max((uint64_t) 1, budgetBytes/slotBytes));
+	slots.assign(nSlots, Slot());
+	chunkSlots.assign(h.nChunks, -1);
+	chunkVisible.assign(h.nChunks, 0);
+	chunkDistances.assign(h.nChunks, 0);
+	order.resize(h.nChunks);
+	// pools: points then normals in vbo, triangles in ebo
+	int nVertices = nSlots*h.maxVertices;
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &ebo);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) nVertices*2*sizeof(vec3), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr) nSlots*h.maxTriangles*sizeof(int3), NULL, GL_DYNAMIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *) 0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void *) (nVertices*sizeof(vec3)));
+	glDisableVertexAttribArray(2);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	frame = 0;
+	return true;
+}
+
+void StreamedMesh::Load(int chunk, int slot) {
+	ChunkFileHeader &h = source.header;
+	const ChunkInfo &c = source.chunks[chunk];
+	Slot &s = slots[slot];
+	if (s.chunk >= 0) {
+		chunkSlots[s.chunk] = -1;
+		nEvictions++;
+	}
+	// chunk-local triangle ids are offset by the slot's base vertex at draw time
+	uint64_t vertexBase = (uint64_t) slot*h.maxVertices, normalsStart = (uint64_t) nSlots*h.maxVertices*sizeof(vec3);
+	int sizeVertices = c.nVertices*sizeof(vec3), sizeTriangles = c.nTriangles*sizeof(int3);
+	UploadBuffer(vbo, (int) (vertexBase*sizeof(vec3)), sizeVertices, source.Points(chunk), persistentUpload);
+	UploadBuffer(vbo, (int) (normalsStart+vertexBase*sizeof(vec3)), sizeVertices, source.Normals(chunk), persistentUpload);
+	UploadBuffer(ebo, (int) ((uint64_t) slot*h.maxTriangles*sizeof(int3)), sizeTriangles, source.Triangles(chunk), persistentUpload);
+	if (evictHostPages)
+		source.file.Evict(source.Points(chunk), 2*sizeVertices+sizeTriangles);
+	s.chunk = chunk;
+	chunkSlots[chunk] = slot;
+	nUploads++;
+}
+
+void StreamedMesh::Update(const Camera &camera) {
+	int nChunks = source.header.nChunks;
+	if (!nChunks || !nSlots)
+		return;
+	frame++;
+	nUploads = nEvictions = nVisible = 0;
+	// visibility and distance of each chunk, in mesh space
+	Frustum frustum(camera.fullview*toWorld);
+	vec4 e = Invert(camera.modelview*toWorld)*vec4(0, 0, 0, 1);
+	vec3 eye = vec3(e.x, e.y, e.z)/e.w;
+	for (int i = 0; i < nChunks; i++) {
+		const ChunkInfo &c = source.chunks[i];
+		chunkVisible[i] = frustum.SphereVisible(c.center, c.radius);
+		chunkDistances[i] = std::max(0.f, length(c.center-eye)-c.radius);
+		nVisible += chunkVisible[i];
+		order[i] = i;
+	}
+	// rank: in view first, then nearest; the top nSlots are wanted
+	std::sort(order.begin(), order.end(), [this](int a, int b) {
+		return chunkVisible[a] != chunkVisible[b]? chunkVisible[a] > chunkVisible[b] : chunkDistances[a] < chunkDistances[b];
+	});
+	for (int i = 0; i < nSlots; i++)
+		if (chunkSlots[order[i]] >= 0)
+			slots[chunkSlots[order[i]]].lastUsed = frame;
+	// page in wanted chunks, replacing least recently used slots not wanted this frame
+	for (int i = 0; i < nSlots && nUploads < maxUploadsPerFrame; i++) {
+		int chunk = order[i];
+		if (chunkSlots[chunk] >= 0)
+			continue;
+		int lru = -1;
+		for (int s = 0; s < nSlots; s++)
+			if (slots[s].lastUsed < frame && (lru < 0 || slots[s].lastUsed < slots[lru].lastUsed))
+				lru = s;
+		if (lru < 0)
+			break;
+		Load(chunk, lru);
+		slots[lru].lastUsed = frame;
+	}
+	if (persistentUpload && nUploads)
+		FenceUploads();
+	nResident = 0;
+	for (int s = 0; s < nSlots; s++)
+		nResident += slots[s].chunk >= 0;
+}
+
+void StreamedMesh::Display(const Camera &camera, bool lines) {
+	Update(camera);
+	ChunkFileHeader &h = source.header;
+	vector<GLsizei> counts;
+	vector<void *> offsets;
+	vector<GLint> baseVertices;
+	for (int s = 0; s < nSlots; s++) {
+		int chunk = slots[s].chunk;
+		if (chunk >= 0 && chunkVisible[chunk]) {
+			counts.push_back(3*source.chunks[chunk].nTriangles);
+			offsets.push_back((void *) ((uint64_t) s*h.maxTriangles*sizeof(int3)));
+			baseVertices.push_back(s*h.maxVertices);
+		}
+	}
+	nDrawn = counts.size();
+	if (!nDrawn)
+		return;
+	int shader = UseMeshShader(lines);
+	SetUniform(shader, "useTexture", false);
+	SetUniform(shader, "modelview", camera.modelview*toWorld);
+	SetUniform(shader, "persp", camera.persp);
+	if (lines)
+		SetUniform(shader, "vp", Viewport());
+	SetUniform(shader, "color", color);
+	glBindVertexArray(vao);
+	glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), nDrawn, baseVertices.data());
+	glBindVertexArray(0);
+}
+
+void StreamedMesh::Release() {
+	if (vbo) glDeleteBuffers(1, &vbo);
+	if (ebo) glDeleteBuffers(1, &ebo);
+	if (vao) glDeleteVertexArrays(1, &vao);
+	vao = vbo = ebo = 0;
+	slots.resize(0);
+	chunkSlots.resize(0);
+	nSlots = nResident = nDrawn = 0;
+	source.Close();
+}
@@ -0,0 +1,503 @@
+// Meshlets.cpp - partition triangles into small clusters, cull clusters on the GPU
+
+#include <algorithm>
+#include "Draw.h"
+#include "GLXtras.h"
+#include "Meshlets.h"
+
+// Meshlet Building
+
+namespace {
+
+vec3 Centroid(vector<vec3> &points, int3 &t) {
+	return (points[t.i1]+points[t.i2]+points[t.i3])/3;
+}
+
+} // end namespace
+
+void SetMeshletBounds(vector<vec3> &points, vector<int3> &triangles, Meshlet &m) {
+	// sphere about box center
+	vec3 min(FLT_MAX), max(-FLT_MAX);
+	for (int t = m.startTriangle; t < m.startTriangle+m.nTriangles; t++)
+		for (int k = 0; k < 3; k++) {
+			vec3 &p = points[triangles[t][k]];
+			for (int j = 0; j < 3; j++) {
+				min[j] = std::min(min[j], p[j]);
+				max[j] = std::max(max[j], p[j]);
+			}
+		}
+	m.center = .5f*(min+max);
+	m.radius = 0;
+	for (int t = m.startTriangle; t < m.startTriangle+m.nTriangles; t++)
+		for (int k = 0; k < 3; k++)
+			m.radius = std::max(m.radius, length(points[triangles[t][k]]-m.center));
+	// cone about average unit normal; half-angle from the normal farthest from the axis
+	vector<vec3> normals;
+	vec3 sum;
+	for (int t = m.startTriangle; t < m.startTriangle+m.nTriangles; t++) {
+		vec3 p1 = points[triangles[t].i1], p2 = points[triangles[t].i2], p3 = points[triangles[t].i3];
+		vec3 n = cross(p2-p1, p3-p1);
+		float len = length(n);
+		if (len > FLT_MIN) {
+			normals.push_back(n/len);
+			sum += normals.back();
+		}
+	}
+	float len = length(sum), minDot = 1;
+	m.coneAxis = len > FLT_MIN? sum/len : vec3(0, 0, 1);
+	for (size_t i = 0; i < normals.size(); i++)
+		minDot = std::min(minDot, dot(normals[i], m.coneAxis));
+	// cones wider than about 84 degrees would rarely cull
+	m.coneCutoff = len <= FLT_MIN || minDot <= .1f? 1 : sqrt(1-minDot*minDot);
+}
+
+int BuildMeshlets(vector<vec3> &points, vector<int3> &triangles, int start, int n,
+				  vector<Meshlet> &meshlets, int maxVertices, int maxTriangles) {
+	if (n <= 0)
+		return 0;
+	maxVertices = std::max(maxVertices, 3);
+	maxTriangles = std::max(maxTriangles, 1);
+	// local vertex ids
+	vector<int> vids(3*n);
+	for (int t = 0; t < n; t++)
+		for (int k = 0; k < 3; k++)
+			vids[3*t+k] = triangles[start+t][k];
+	std::sort(vids.begin(), vids.end());
+	vids.erase(std::unique(vids.begin(), vids.end()), vids.end());
+	int nVertices = vids.size();
+	vector<int3> tris(n);
+	for (int t = 0; t < n; t++)
+		for (int k = 0; k < 3; k++)
+			tris[t][k] = (int) (std::lower_bound(vids.begin(), vids.end(), triangles[start+t][k])-vids.begin());
+	// vertex-to-triangle adjacency: triangles of v are adjacent[offsets[v]] to adjacent[offsets[v+1]-1]
+	vector<int> offsets(nVertices+1, 0), adjacent(3*n);
+	for (int t = 0; t < n; t++)
+		for (int k = 0; k < 3; k++)
+			offsets[tris[t][k]+1]++;
+	for (int v = 0; v < nVertices; v++)
+		offsets[v+1] += offsets[v];
+	vector<int> fill(offsets.begin(), offsets.end()-1);
+	for (int t = 0; t < n; t++)
+		for (int k = 0; k < 3; k++)
+			adjacent[fill[tris[t][k]]++] = t;
+	vector<vec3> centroids(n);
+	for (int t = 0; t < n; t++)
+		centroids[t] = Centroid(points, triangles[start+t]);
+	// grow meshlets greedily
+	vector<char> emitted(n, 0);
+	vector<int> owner(nVertices, -1), listed(n, -1), candidates, order;
+	order.reserve(n);
+	int nMeshlets = 0;
+	for (int cursor = 0; (int) order.size() < n; nMeshlets++) {
+		Meshlet m;
+		m.startTriangle = start+order.size();
+		vec3 centroidSum;
+		while (m.nTriangles < maxTriangles) {
+			int best = -1, bestNew = 4;
+			float bestDistance = FLT_MAX;
+			if (!m.nTriangles) {
+				// seed with a triangle bordering the previous meshlet, else the next unused
+				for (size_t i = 0; i < candidates.size() && best < 0; i++)
+					if (!emitted[candidates[i]])
+						best = candidates[i];
+				candidates.resize(0);
+				while (best < 0 && emitted[cursor])
+					cursor++;
+				if (best < 0)
+					best = cursor;
+			}
+			else {
+				vec3 center = centroidSum/(float) m.nTriangles;
+				size_t nCandidates = 0;
+				for (size_t i = 0; i < candidates.size(); i++) {
+					int t = candidates[i];
+					if (emitted[t])
+						continue;
+					candidates[nCandidates++] = t;
+					int nNew = (owner[tris[t].i1] != nMeshlets)+(owner[tris[t].i2] != nMeshlets)+(owner[tris[t].i3] != nMeshlets);
+					if (m.nVertices+nNew > maxVertices || nNew > bestNew)
+						continue;
+					vec3 d = centroids[t]-center;
+					float distance = dot(d, d);
+					if (nNew < bestNew || distance < bestDistance) {
+						best = t;
+						bestNew = nNew;
+						bestDistance = distance;
+					}
+				}
+				candidates.resize(nCandidates);
+			}
+			if (best < 0)
+				break;
+			emitted[best] = 1;
+			order.push_back(best);
+			centroidSum += centroids[best];
+			m.nTriangles++;
+			for (int k = 0; k < 3; k++) {
+				int v = tris[best][k];
+				if (owner[v] == nMeshlets)
+					continue;
+				owner[v] = nMeshlets;
+				m.nVertices++;
+				for (int a = offsets[v]; a < offsets[v+1]; a++) {
+					int t = adjacent[a];
+					if (!emitted[t] && listed[t] != nMeshlets) {
+						listed[t] = nMeshlets;
+						candidates.push_back(t);
+					}
+				}
+			}
+		}
+		meshlets.push_back(m);
+	}
+	for (int t = 0; t < n; t++)
+		triangles[start+t] = int3(vids[tris[order[t]].i1], vids[tris[order[t]].i2], vids[tris[order[t]].i3]);
+	for (int i = (int) meshlets.size()-nMeshlets; i < (int) meshlets.size(); i++)
+		SetMeshletBounds(points, triangles, meshlets[i]);
+	return nMeshlets;
+}
+
+int BuildMeshlets(vector<vec3> &points, vector<int3> &triangles, vector<Group> &groups, vector<Mtl> &mtls,
+				  vector<Meshlet> &meshlets, int maxVertices, int maxTriangles) {
+	int nTriangles = triangles.size(), nMeshlets = 0;
+	// partition only within ranges bounded by groups and materials
+	vector<int> bounds = { 0, nTriangles };
+	for (size_t i = 0; i < groups.size(); i++) {
+		bounds.push_back(groups[i].startTriangle);
+		bounds.push_back(groups[i].startTriangle+groups[i].nTriangles);
+	}
+	for (size_t i = 0; i < mtls.size(); i++)
+		if (mtls[i].startTriangle >= 0) {
+			bounds.push_back(mtls[i].startTriangle);
+			bounds.push_back(mtls[i].startTriangle+mtls[i].nTriangles);
+		}
+	std::sort(bounds.begin(), bounds.end());
+	bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+	for (size_t i = 0; i+1 < bounds.size(); i++) {
+		int start = bounds[i], n = std::min(bounds[i+1], nTriangles)-start;
+		if (start >= 0 && n > 0)
+			nMeshlets += BuildMeshlets(points, triangles, start, n, meshlets, maxVertices, maxTriangles);
+	}
+	return nMeshlets;
+}
+
+// Shaders
+
+namespace {
+
+GLuint cullProgram = 0, hizProgram = 0;
+
+// one thread per meshlet; visible meshlets append a DrawElementsIndirectCommand
+// frustum planes and eye are in mesh space, so non-uniform scale in toWorld is handled exactly
+const char *cullShader = R"(
+	#version 430 core
+	layout (local_size_x = 64) in;
+	struct Meshlet {
+		vec3 center;
+		float radius;
+		vec3 coneAxis;
+		float coneCutoff;
+		int startTriangle, nTriangles, nVertices, unused;
+	};
+	struct Command {
+		uint count, instanceCount, firstIndex;
+		int baseVertex;
+		uint baseInstance;
+	};
+	layout (std430, binding = 14) readonly buffer Meshlets { Meshlet meshlets[]; };
+	layout (std430, binding = 15) writeonly buffer Commands { Command commands[]; };
+	layout (binding = 0, offset = 0) uniform atomic_uint nVisible;
+	uniform int nMeshlets;
+	uniform bool frustumCull = true, coneCull = true, occlusionCull = false;
+	uniform vec4 planes[6];
+	uniform vec3 eye;
+	uniform mat4 hizModelview;					// mesh to camera space when Hi-Z was built
+	uniform mat4 hizPersp;
+	uniform float hizScale;						// scale of hizModelview
+	uniform sampler2D hiz;
+	uniform vec2 hizSize;
+	uniform int hizLevels;
+	bool Occluded(vec3 center, float radius) {
+		vec3 c = (hizModelview*vec4(center, 1)).xyz;
+		float r = hizScale*radius;
+		// screen rectangle from corners of sphere's camera-space box
+		vec2 lo = vec2(1), hi = vec2(-1);
+		for (int i = 0; i < 8; i++) {
+			vec3 p = c+r*vec3((i&1) != 0? 1 : -1, (i&2) != 0? 1 : -1, (i&4) != 0? 1 : -1);
+			vec4 q = hizPersp*vec4(p, 1);
+			if (q.w <= 0)
+				return false;					// sphere reaches behind eye
+			lo = min(lo, q.xy/q.w);
+			hi = max(hi, q.xy/q.w);
+		}
+		// depth of nearest point
+		vec4 q = hizPersp*vec4(c.x, c.y, c.z+r, 1);
+		float depth = .5*q.z/q.w+.5;
+		// level at which rectangle spans at most 2x2 texels
+		vec2 uvLo = clamp(.5*lo+.5, 0, 1), uvHi = clamp(.5*hi+.5, 0, 1);
+		vec2 size = (uvHi-uvLo)*hizSize;
+		float level = clamp(ceil(log2(max(max(size.x, size.y), 1))), 0, hizLevels-1);
+		float far = max(max(textureLod(hiz, uvLo, level).r, textureLod(hiz, vec2(uvHi.x, uvLo.y), level).r),
+						max(textureLod(hiz, vec2(uvLo.x, uvHi.y), level).r, textureLod(hiz, uvHi, level).r));
+		return depth > far;
+	}
+	void main() {
+		uint i = gl_GlobalInvocationID.x;
+		if (i >= uint(nMeshlets))
+			return;
+		Meshlet m = meshlets[i];
+		if (frustumCull)
+			for (int k = 0; k < 6; k++)
+				if (dot(planes[k].xyz, m.center)+planes[k].w < -m.radius)
+					return;
+		vec3 d = m.center-eye;
+		if (coneCull && dot(d, m.coneAxis) >= m.coneCutoff*length(d)+m.radius)
+			return;
+		if (occlusionCull && Occluded(m.center, m.radius))
+			return;
+		uint n = atomicCounterIncrement(nVisible);
+		commands[n] = Command(uint(3*m.nTriangles), 1, uint(3*m.startTriangle), 0, 0);
+	}
+)";
+
+// level 0 from depth texture, else each texel the farthest of the (2x2, or 3 wide at odd edge) texels below
+const char *hizShader = R"(
+	#version 430 core
+	layout (local_size_x = 8, local_size_y = 8) in;
+	layout (r32f, binding = 0) readonly uniform image2D src;
+	layout (r32f, binding = 1) writeonly uniform image2D dst;
+	uniform sampler2D depth;
+	uniform bool fromDepth = false;
+	uniform ivec2 srcSize, dstSize;
+	void main() {
+		ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+		if (p.x >= dstSize.x || p.y >= dstSize.y)
+			return;
+		if (fromDepth) {
+			imageStore(dst, p, vec4(texelFetch(depth, p, 0).r));
+			return;
+		}
+		int nx = p.x == dstSize.x-1 && srcSize.x > 2*dstSize.x? 3 : 2;
+		int ny = p.y == dstSize.y-1 && srcSize.y > 2*dstSize.y? 3 : 2;
+		float d = 0;
+		for (int j = 0; j < ny; j++)
+			for (int i = 0; i < nx; i++)
+				d = max(d, imageLoad(src, min(2*p+ivec2(i, j), srcSize-1)).r);
+		imageStore(dst, p, vec4(d));
+	}
+)";
+
+static bool cullRegistered = RegisterProgram("Meshlet cull", &cullShader);
+static bool hizRegistered = RegisterProgram("Meshlet hi-z", &hizShader);
+
+const int meshletBinding = 14, commandBinding = 15, hizTextureUnit = 15;
+
+// glMultiDrawElementsIndirectCount is core in OpenGL 4.6 (ARB_indirect_parameters before)
+// the loader here is 4.5, so fetch it directly; without it, culled commands are zeroed and all drawn
+typedef void (APIENTRYP MultiDrawElementsIndirectCount)(GLenum mode, GLenum type, const void *indirect,
+	GLintptr drawCount, GLsizei maxDrawCount, GLsizei stride);
+MultiDrawElementsIndirectCount multiDrawIndirectCount = NULL;
+bool multiDrawIndirectCountLoaded = false;
+const GLenum parameterBuffer = 0x80EE;			// GL_PARAMETER_BUFFER
+
+MultiDrawElementsIndirectCount GetMultiDrawIndirectCount() {
+	if (!multiDrawIndirectCountLoaded) {
+		multiDrawIndirectCount = (MultiDrawElementsIndirectCount) glfwGetProcAddress("glMultiDrawElementsIndirectCount");
+		if (!multiDrawIndirectCount)
+			multiDrawIndirectCount = (MultiDrawElementsIndirectCount) glfwGetProcAddress("glMultiDrawElementsIndirectCountARB");
+		multiDrawIndirectCountLoaded = true;
+	}
+	return multiDrawIndirectCount;
+}
+
+// Hi-Z state
+GLuint hizTexture = 0, depthTexture = 0, depthFramebuffer = 0;
+int hizWidth = 0, hizHeight = 0, hizLevels = 0;
+mat4 hizModelview, hizPersp;
+
+float MaxScale(const mat4 &m) {
+	float scale = 0;
+	for (int j = 0; j < 3; j++)
+		scale = std::max(scale, length(vec3(m[0][j], m[1][j], m[2][j])));
+	return scale;
+}
+
+} // end namespace
+
+// GPU Culling
+
+bool MeshletCuller::Upload(vector<Meshlet> &meshlets) {
+	nMeshlets = meshlets.size();
+	if (!nMeshlets)
+		return false;
+	if (!cullProgram)
+		cullProgram = LinkProgramViaCode(&cullShader);
+	if (!cullProgram) { printf("MeshletCuller::Upload: can't link culling shader!\n"); return false; }
+	if (!meshletBuffer) {
+		glGenBuffers(1, &meshletBuffer);
+		glGenBuffers(1, &commandBuffer);
+		glGenBuffers(1, &counterBuffer);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshletBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, nMeshlets*sizeof(Meshlet), meshlets.data(), GL_STATIC_DRAW);
+	// five uints per command (as DrawElementsIndirectCommand)
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, nMeshlets*5*sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, counterBuffer);
+	glBufferData(GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+	return true;
+}
+
+void MeshletCuller::Cull(const Camera &camera, const mat4 &toWorld) {
+	if (!nMeshlets || !cullProgram)
+		return;
+	mat4 modelview = camera.modelview*toWorld;
+	Frustum frustum(camera.fullview*toWorld);
+	vec4 eye = Invert(modelview)*vec4(0, 0, 0, 1);
+	bool occlusion = occlusionCull && hizTexture;
+	// reset counter (and, if draws are not counted, the commands)
+	GLuint zero = 0;
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, counterBuffer);
+	glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &zero);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+	if (!GetMultiDrawIndirectCount()) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+	glUseProgram(cullProgram);
+	SetUniform(cullProgram, "nMeshlets", nMeshlets);
+	SetUniform(cullProgram, "frustumCull", frustumCull);
+	SetUniform(cullProgram, "coneCull", coneCull);
+	SetUniform(cullProgram, "occlusionCull", occlusion);
+	SetUniform4v(cullProgram, "planes", 6, (float *) frustum.planes);
+	SetUniform(cullProgram, "eye", vec3(eye.x, eye.y, eye.z)/eye.w);
+	if (occlusion) {
+		mat4 m = hizModelview*toWorld;
+		SetUniform(cullProgram, "hizModelview", m);
+		SetUniform(cullProgram, "hizPersp", hizPersp);
+		SetUniform(cullProgram, "hizScale", MaxScale(m));
+		SetUniform(cullProgram, "hizSize", vec2((float) hizWidth, (float) hizHeight));
+		SetUniform(cullProgram, "hizLevels", hizLevels);
+		SetUniform(cullProgram, "hiz", hizTextureUnit);
+		glActiveTexture(GL_TEXTURE0+hizTextureUnit);
+		glBindTexture(GL_TEXTURE_2D, hizTexture);
+		glActiveTexture(GL_TEXTURE0);
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, meshletBinding, meshletBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, commandBinding, commandBuffer);
+	glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, counterBuffer);
+	glDispatchCompute((nMeshlets+63)/64, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
+}
+
+void MeshletCuller::Draw() {
+	if (!nMeshlets || !commandBuffer)
+		return;
+	MultiDrawElementsIndirectCount drawCount = GetMultiDrawIndirectCount();
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	if (drawCount) {
+		glBindBuffer(parameterBuffer, counterBuffer);
+		drawCount(GL_TRIANGLES, GL_UNSIGNED_INT, (void *) 0, 0, nMeshlets, 0);
+		glBindBuffer(parameterBuffer, 0);
+	}
+	else
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *) 0, nMeshlets, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+int MeshletCuller::VisibleCount() {
+	GLuint n = 0;
+	if (counterBuffer) {
+		glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, counterBuffer);
+		glGetBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &n);
+		glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+	}
+	return (int) n;
+}
+
+void MeshletCuller::Release() {
+	if (meshletBuffer) glDeleteBuffers(1, &meshletBuffer);
+	if (commandBuffer) glDeleteBuffers(1, &commandBuffer);
+	if (counterBuffer) glDeleteBuffers(1, &counterBuffer);
+	meshletBuffer = commandBuffer = counterBuffer = 0;
+	nMeshlets = 0;
+}
+
+// Hierarchical Depth
+
+void ReleaseHiZ() {
+	if (hizTexture) glDeleteTextures(1, &hizTexture);
+	if (depthTexture) glDeleteTextures(1, &depthTexture);
+	if (depthFramebuffer) glDeleteFramebuffers(1, &depthFramebuffer);
+	hizTexture = depthTexture = depthFramebuffer = 0;
+	hizWidth = hizHeight = hizLevels = 0;
+}
+
+void UpdateHiZ(const Camera &camera) {
+	int width, height;
+	ViewportSize(width, height);
+	if (width <= 0 || height <= 0)
+		return;
+	if (!hizProgram)
+		hizProgram = LinkProgramViaCode(&hizShader);
+	if (!hizProgram) { printf("UpdateHiZ: can't link shader!\n"); return; }
+	if (width != hizWidth || height != hizHeight) {
+		ReleaseHiZ();
+		hizWidth = width;
+		hizHeight = height;
+		for (int s = std::max(width, height); s > 0; s >>= 1)
+			hizLevels++;
+		// depth copy target, matching the usual 24/8 default depth-stencil format (as blit requires)
+		glGenTextures(1, &depthTexture);
+		glBindTexture(GL_TEXTURE_2D, depthTexture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH24_STENCIL8, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glGenFramebuffers(1, &depthFramebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthFramebuffer);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		// max-depth pyramid
+		glGenTextures(1, &hizTexture);
+		glBindTexture(GL_TEXTURE_2D, hizTexture);
+		glTexStorage2D(GL_TEXTURE_2D, hizLevels, GL_R32F, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	// resolve (if multisampled) and copy depth of default framebuffer
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthFramebuffer);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	// build levels
+	int program = CurrentProgram();
+	glUseProgram(hizProgram);
+	glActiveTexture(GL_TEXTURE0+hizTextureUnit);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glActiveTexture(GL_TEXTURE0);
+	SetUniform(hizProgram, "depth", hizTextureUnit);
+	int w = width, h = height;
+	for (int level = 0; level < hizLevels; level++) {
+		int dstW = level? std::max(1, w/2) : w, dstH = level? std::max(1, h/2) : h;
+		SetUniform(hizProgram, "fromDepth", level == 0);
+		glUniform2i(glGetUniformLocation(hizProgram, "srcSize"), w, h);
+		glUniform2i(glGetUniformLocation(hizProgram, "dstSize"), dstW, dstH);
+		if (level)
+			glBindImageTexture(0, hizTexture, level-1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, hizTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((dstW+7)/8, (dstH+7)/8, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		w = dstW;
+		h = dstH;
+	}
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	glUseProgram(program);
+	hizModelview = camera.modelview;
+	hizPersp = camera.persp;
+}
@@ -0,0 +1,244 @@
+// Normals.cpp - multi-threaded vertex normals, crease splitting, and tangents
+
+#include <algorithm>
+#include <stdio.h>
+#include "Misc.h"
+#include "Normals.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#define NORMALS_SSE
+	#include <xmmintrin.h>
+#endif
+
+namespace {
+
+const int chunkSize = 4096;	// vectors per normalization task
+
+vec3 SafeNormalize(vec3 v) {
+	float len = length(v);
+	return len > 0? v/len : v;
+}
+
+float Angle(vec3 a, vec3 b) {
+	float d = dot(SafeNormalize(a), SafeNormalize(b));
+	return acos(d < -1? -1 : d > 1? 1 : d);
+}
+
+void FaceNormals(vector<vec3> &points, vector<int3> &triangles, NormalWeight weight, vector<vec3> &normals) {
+	// weighted face normal per triangle or, for angle weighting, per corner (3*triangle+k)
+	bool perCorner = weight == NormalWeight::Angle;
+	normals.resize((perCorner? 3 : 1)*triangles.size());
+	ParallelFor(triangles.size(), [&](int t) {
+		int3 &tri = triangles[t];
+		vec3 p[] = { points[tri.i1], points[tri.i2], points[tri.i3] };
+		vec3 n = cross(p[1]-p[0], p[2]-p[0]);
+		if (weight == NormalWeight::Area)
+			normals[t] = n;
+		else if (weight == NormalWeight::Equal)
+			normals[t] = SafeNormalize(n);
+		else {
+			n = SafeNormalize(n);
+			for (int k = 0; k < 3; k++)
+				normals[3*t+k] = Angle(p[(k+1)%3]-p[k], p[(k+2)%3]-p[k])*n;
+		}
+	});
+}
+
+void NormalizeParallel(vector<vec3> &v) {
+	int n = v.size();
+	ParallelFor((n+chunkSize-1)/chunkSize, [&](int c) {
+		NormalizeVectors(v.data()+c*chunkSize, std::min(chunkSize, n-c*chunkSize));
+	}, 1);
+}
+
+} // end namespace
+
+// Adjacency
+
+void VertexAdjacency::Build(vector<int3> &triangles, int nVertices) {
+	int nCorners = 3*triangles.size();
+	offsets.assign(nVertices+1, 0);
+	for (int c = 0; c < nCorners; c++)
+		offsets[triangles[c/3][c%3]+1]++;
+	for (int v = 0; v < nVertices; v++)
+		offsets[v+1] += offsets[v];
+	corners.resize(nCorners);
+	vector<int> fill(offsets.begin(), offsets.end()-1);
+	for (int c = 0; c < nCorners; c++)
+		corners[fill[triangles[c/3][c%3]]++] = c;
+}
+
+// Normalization
+
+void NormalizeVectors(vec3 *v, int n) {
+	int i = 0;
+#ifdef NORMALS_SSE
+	// four vec3s (12 floats) per iteration: deinterleave to x, y, z, scale, reinterleave
+	float *f = (float *) v;
+	__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1);
+	for (; i+4 <= n; i += 4, f += 12) {
+		__m128 a = _mm_loadu_ps(f), b = _mm_loadu_ps(f+4), c = _mm_loadu_ps(f+8);
+		// a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+		__m128 x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+		__m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+								  _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+								  _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+		__m128 s = _mm_and_ps(_mm_div_ps(one, _mm_sqrt_ps(len2)), _mm_cmpgt_ps(len2, zero));
+		x = _mm_mul_ps(x, s);
+		y = _mm_mul_ps(y, s);
+		z = _mm_mul_ps(z, s);
+		a = _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)),
+						   _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+		b = _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)),
+						   _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+		c = _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)),
+						   _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+		_mm_storeu_ps(f, a);
+		_mm_storeu_ps(f+4, b);
+		_mm_storeu_ps(f+8, c);
+	}
+#endif
+	for (; i < n; i++)
+		v[i] = SafeNormalize(v[i]);
+}
+
+// Vertex Normals
+
+void ComputeVertexNormals(vector<vec3> &points, vector<int3> &triangles, vector<vec3> &normals,
+						  NormalWeight weight, VertexAdjacency *adjacency) {
+	int nVertices = points.size();
+	VertexAdjacency local, &a = adjacency? *adjacency : local;
+	if (!a.Valid(triangles, nVertices))
+		a.Build(triangles, nVertices);
+	vector<vec3> faces;
+	FaceNormals(points, triangles, weight, faces);
+	int shift = weight == NormalWeight::Angle? 0 : 1;	// index faces by corner, else by triangle
+	// gather: each vertex sums its own corners, so threads never write the same normal
+	normals.resize(nVertices);
+	ParallelFor(nVertices, [&](int v) {
+		vec3 n;
+		for (int i = a.offsets[v]; i < a.offsets[v+1]; i++)
+			n += faces[shift? a.corners[i]/3 : a.corners[i]];
+		normals[v] = n;
+	});
+	NormalizeParallel(normals);
+}
+
+// Creases
+
+int SplitCreases(vector<vec3> &points, vector<int3> &triangles, vector<vec3> &normals, float creaseAngle,
+				 NormalWeight weight, vector<vec2> *uvs, vector<int> *sourceVertices) {
+	int nVertices = points.size(), nTriangles = triangles.size();
+	float cosCrease = cos(creaseAngle*3.1415926f/180);
+	VertexAdjacency a;
+	a.Build(triangles, nVertices);
+	vector<vec3> faceNormals, faces;
+	FaceNormals(points, triangles, NormalWeight::Equal, faceNormals);
+	FaceNormals(points, triangles, weight, faces);
+	int shift = weight == NormalWeight::Angle? 0 : 1;
+	// per vertex, cluster corners into smooth fans: union triangles that share an edge at the vertex
+	// and whose normals differ by less than creaseAngle; label clusters 0, 1, ...
+	vector<int> cornerClusters(3*nTriangles, 0), nClusters(nVertices, 1);
+	ParallelFor(nVertices, [&](int v) {
+		int begin = a.offsets[v], n = a.offsets[v+1]-begin;
+		if (n < 2)
+			return;
+		vector<int> parents(n), labels(n, -1);
+		for (int i = 0; i < n; i++)
+			parents[i] = i;
+		auto Root = [&parents](int i) { while (parents[i] != i) i = parents[i] = parents[parents[i]]; return i; };
+		for (int i = 0; i < n; i++) {
+			int ti = a.corners[begin+i]/3;
+			for (int j = i+1; j < n; j++) {
+				int tj = a.corners[begin+j]/3, nShared = 0;
+				for (int ki = 0; ki < 3; ki++)
+					for (int kj = 0; kj < 3; kj++)
+						nShared += triangles[ti][ki] == triangles[tj][kj];
+				if (nShared >= 2 && dot(faceNormals[ti], faceNormals[tj]) >= cosCrease)
+					parents[Root(i)] = Root(j);
+			}
+		}
+		int nLabels = 0;
+		for (int i = 0; i < n; i++) {
+			int r = Root(i);
+			if (labels[r] < 0)
+				labels[r] = nLabels++;
+			cornerClusters[a.corners[begin+i]] = labels[r];
+		}
+		nClusters[v] = nLabels;
+	});
+	// new vertices for clusters beyond the first
+	vector<int> bases(nVertices);
+	int nNew = nVertices;
+	for (int v = 0; v < nVertices; v++) {
+		bases[v] = nNew;
+		nNew += nClusters[v]-1;
+	}
+	bool extendUvs = uvs && (int) uvs->size() == nVertices;
+	points.resize(nNew);
+	if (extendUvs)
+		uvs->resize(nNew);
+	if (sourceVertices)
+		sourceVertices->resize(nNew);
+	normals.assign(nNew, vec3(0, 0, 0));
+	ParallelFor(nVertices, [&](int v) {
+		for (int c = 1; c < nClusters[v]; c++) {
+			points[bases[v]+c-1] = points[v];
+			if (extendUvs)
+				(*uvs)[bases[v]+c-1] = (*uvs)[v];
+		}
+		if (sourceVertices)
+			for (int c = 0; c < nClusters[v]; c++)
+				(*sourceVertices)[c? bases[v]+c-1 : v] = v;
+		// each new vertex belongs to one original vertex, so this gather is race-free
+		for (int i = a.offsets[v]; i < a.offsets[v+1]; i++) {
+			int corner = a.corners[i], c = cornerClusters[corner], id = c? bases[v]+c-1 : v;
+			normals[id] += faces[shift? corner/3 : corner];
+			triangles[corner/3][corner%3] = id;
+		}
+	});
+	NormalizeParallel(normals);
+	return nNew-nVertices;
+}
+
+// Tangents
+
+void ComputeTangents(vector<vec3> &points, vector<vec3> &normals, vector<vec2> &uvs, vector<int3> &triangles,
+					 vector<vec4> &tangents, VertexAdjacency *adjacency) {
+	int nVertices = points.size(), nTriangles = triangles.size();
+	if ((int) normals.size() != nVertices || (int) uvs.size() != nVertices) {
+		printf("ComputeTangents: normals and uvs must correspond with points\n");
+		return;
+	}
+	VertexAdjacency local, &a = adjacency? *adjacency : local;
+	if (!a.Valid(triangles, nVertices))
+		a.Build(triangles, nVertices);
+	// per-triangle directions of increasing u (s) and v (t) (Lengyel)
+	vector<vec3> sDirs(nTriangles), tDirs(nTriangles);
+	ParallelFor(nTriangles, [&](int t) {
+		int3 &tri = triangles[t];
+		vec3 e1 = points[tri.i2]-points[tri.i1], e2 = points[tri.i3]-points[tri.i1];
+		vec2 d1 = uvs[tri.i2]-uvs[tri.i1], d2 = uvs[tri.i3]-uvs[tri.i1];
+		float r = d1.x*d2.y-d2.x*d1.y;
+		if (fabs(r) > 1e-12f) {
+			sDirs[t] = (e1*d2.y-e2*d1.y)/r;
+			tDirs[t] = (e2*d1.x-e1*d2.x)/r;
+		}
+	});
+	tangents.resize(nVertices);
+	ParallelFor(nVertices, [&](int v) {
+		vec3 s, t, n = normals[v];
+		for (int i = a.offsets[v]; i < a.offsets[v+1]; i++) {
+			s += sDirs[a.corners[i]/3];
+			t += tDirs[a.corners[i]/3];
+		}
+		// Gram-Schmidt orthogonalize against normal; arbitrary perpendicular if degenerate
+		vec3 tangent = s-n*dot(n, s);
+		if (dot(tangent, tangent) < 1e-20f)
+			tangent = cross(n, fabs(n.x) < .9f? vec3(1, 0, 0) : vec3(0, 1, 0));
+		tangent = SafeNormalize(tangent);
+		tangents[v] = vec4(tangent.x, tangent.y, tangent.z, dot(cross(n, tangent), t) < 0? -1.f : 1.f);
+	});
+}
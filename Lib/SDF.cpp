@@ -0,0 +1,290 @@
+// SDF.cpp - signed distance fields baked from triangle meshes
+
+#include <algorithm>
+#include "Collide.h"
+#include "Misc.h"
+#include "SDF.h"
+
+namespace {
+
+// Bounding Volume Hierarchy
+
+struct BvhNode {
+	vec3 min, max;							// box of triangle vertices
+	int children = -1;						// first child (second follows), -1 if leaf
+	int start = 0, count = 0;				// triangles, in Bvh.corners order
+	vec3 center;							// area-weighted centroid, for far-field winding
+	vec3 areaNormal;						// sum of triangle area times unit normal
+	float area = 0, radius = 0;				// radius of sphere about center enclosing box
+};
+
+struct Bvh {
+	vector<BvhNode> nodes;
+	vector<int> ids;						// original triangle ids, in leaf order
+	vector<vec3> corners;					// three per triangle, in leaf order
+};
+
+void BuildNode(Bvh &bvh, vector<vec3> &centroids, int node, int start, int count) {
+	bvh.nodes[node].start = start;
+	bvh.nodes[node].count = count;
+	if (count <= 4)
+		return;
+	// split at middle of longest side of centroid bounds, else at median
+	int *ids = bvh.ids.data()+start;
+	vec3 min(FLT_MAX), max(-FLT_MAX);
+	for (int i = 0; i < count; i++)
+		for (int a = 0; a < 3; a++) {
+			min[a] = std::min(min[a], centroids[ids[i]][a]);
+			max[a] = std::max(max[a], centroids[ids[i]][a]);
+		}
+	vec3 d = max-min;
+	int a = d.x > d.y? (d.x > d.z? 0 : 2) : (d.y > d.z? 1 : 2);
+	float split = .5f*(min[a]+max[a]);
+	int half = (int) (std::partition(ids, ids+count, [&](int t) { return centroids[t][a] < split; })-ids);
+	if (half == 0 || half == count) {
+		half = count/2;
+		std::nth_element(ids, ids+half, ids+count, [&](int t1, int t2) { return centroids[t1][a] < centroids[t2][a]; });
+	}
+	int children = bvh.nodes.size();
+	bvh.nodes[node].children = children;
+	bvh.nodes.resize(children+2);
+	BuildNode(bvh, centroids, children, start, half);
+	BuildNode(bvh, centroids, children+1, start+half, count-half);
+}
+
+void SetBounds(Bvh &bvh, int node) {
+	// boxes and dipoles, bottom-up
+	BvhNode &n = bvh.nodes[node];
+	vec3 weighted;
+	n.min = vec3(FLT_MAX);
+	n.max = vec3(-FLT_MAX);
+	if (n.children < 0)
+		for (int i = 3*n.start; i < 3*(n.start+n.count); i += 3) {
+			vec3 *v = &bvh.corners[i], an = .5f*cross(v[1]-v[0], v[2]-v[0]);
+			float a = length(an);
+			for (int k = 0; k < 3; k++)
+				for (int c = 0; c < 3; c++) {
+					n.min[c] = std::min(n.min[c], v[k][c]);
+					n.max[c] = std::max(n.max[c], v[k][c]);
+				}
+			n.areaNormal += an;
+			n.area += a;
+			weighted += (a/3)*(v[0]+v[1]+v[2]);
+		}
+	else
+		for (int k = 0; k < 2; k++) {
+			SetBounds(bvh, n.children+k);
+			BvhNode &c = bvh.nodes[n.children+k];
+			for (int i = 0; i < 3; i++) {
+				n.min[i] = std::min(n.min[i], c.min[i]);
+				n.max[i] = std::max(n.max[i], c.max[i]);
+			}
+			n.areaNormal += c.areaNormal;
+			n.area += c.area;
+			weighted += c.area*c.center;
+		}
+	n.center = n.area > 0? weighted/n.area : .5f*(n.min+n.max);
+	vec3 far;
+	for (int i = 0; i < 3; i++)
+		far[i] = std::max(n.center[i]-n.min[i], n.max[i]-n.center[i]);
+	n.radius = length(far);
+}
+
+void BuildBvh(Bvh &bvh, vector<vec3> &points, vector<int3> &triangles) {
+	int n = triangles.size();
+	vector<vec3> centroids(n);
+	bvh.ids.resize(n);
+	for (int t = 0; t < n; t++) {
+		bvh.ids[t] = t;
+		centroids[t] = (points[triangles[t].i1]+points[triangles[t].i2]+points[triangles[t].i3])/3;
+	}
+	bvh.nodes.reserve(n/2+1);
+	bvh.nodes.resize(1);
+	BuildNode(bvh, centroids, 0, 0, n);
+	bvh.corners.resize(3*n);
+	for (int i = 0; i < n; i++)
+		for (int k = 0; k < 3; k++)
+			bvh.corners[3*i+k] = points[triangles[bvh.ids[i]][k]];
+	SetBounds(bvh, 0);
+}
+
+// Queries
+
+float BoxDistance2(const BvhNode &n, vec3 q) {
+	float d2 = 0;
+	for (int i = 0; i < 3; i++) {
+		float d = q[i] < n.min[i]? n.min[i]-q[i] : q[i] > n.max[i]? q[i]-n.max[i] : 0;
+		d2 += d*d;
+	}
+	return d2;
+}
+
+float Closest2(const Bvh &bvh, vec3 q, float best2, int &triangle, vector<int> &stack) {
+	// squared distance to nearest triangle if less than best2 (triangle set to its leaf-order index)
+	stack.assign(1, 0);
+	while (stack.size()) {
+		const BvhNode &n = bvh.nodes[stack.back()];
+		stack.pop_back();
+		if (BoxDistance2(n, q) >= best2)
+			continue;
+		if (n.children < 0) {
+			for (int t = n.start; t < n.start+n.count; t++) {
+				const vec3 *v = &bvh.corners[3*t];
+				vec3 d = q-ClosestOnTriangle(q, v[0], v[1], v[2]);
+				float d2 = dot(d, d);
+				if (d2 < best2) {
+					best2 = d2;
+					triangle = t;
+				}
+			}
+			continue;
+		}
+		// nearer child last, so examined first
+		int nearer = n.children, farther = n.children+1;
+		float dNearer = BoxDistance2(bvh.nodes[nearer], q), dFarther = BoxDistance2(bvh.nodes[farther], q);
+		if (dFarther < dNearer) {
+			std::swap(nearer, farther);
+			std::swap(dNearer, dFarther);
+		}
+		if (dFarther < best2) stack.push_back(farther);
+		if (dNearer < best2) stack.push_back(nearer);
+	}
+	return best2;
+}
+
+float Winding(const Bvh &bvh, vec3 q, int node) {
+	// generalized winding number (Barill et al., "Fast Winding Numbers for Soups and Clouds")
+	// distant nodes use their dipole, else triangles contribute solid angle/4pi (Van Oosterom & Strackee)
+	const float pi4 = 4*3.1415926535f;
+	const BvhNode &n = bvh.nodes[node];
+	vec3 d = n.center-q;
+	float dist2 = dot(d, d);
+	if (dist2 > 4*n.radius*n.radius)
+		return dot(d, n.areaNormal)/(pi4*dist2*sqrt(dist2));
+	if (n.children >= 0)
+		return Winding(bvh, q, n.children)+Winding(bvh, q, n.children+1);
+	float w = 0;
+	for (int t = n.start; t < n.start+n.count; t++) {
+		const vec3 *v = &bvh.corners[3*t];
+		vec3 a = v[0]-q, b = v[1]-q, c = v[2]-q;
+		float la = length(a), lb = length(b), lc = length(c);
+		float det = dot(a, cross(b, c));
+		float denom = la*lb*lc+dot(a, b)*lc+dot(b, c)*la+dot(c, a)*lb;
+		w += 2*atan2(det, denom);
+	}
+	return w/pi4;
+}
+
+} // end namespace
+
+// Baking
+
+bool BakeSDF(vector<vec3> &points, vector<int3> &triangles, SDF &sdf, int resolution, float padding) {
+	sdf.values.resize(0);
+	if (triangles.empty())
+		return false;
+	Bvh bvh;
+	BuildBvh(bvh, points, triangles);
+	// cubic cells over padded bounds
+	vec3 size = bvh.nodes[0].max-bvh.nodes[0].min;
+	float longest = std::max(1e-6f, std::max(size.x, std::max(size.y, size.z))), pad = padding*longest;
+	float cell = (longest+2*pad)/(std::max(2, resolution)-1);
+	sdf.min = bvh.nodes[0].min-vec3(pad);
+	for (int a = 0; a < 3; a++) {
+		sdf.res[a] = std::max(2, (int) ceil((size[a]+2*pad)/cell-1e-3f)+1);
+		sdf.max[a] = sdf.min[a]+cell*(sdf.res[a]-1);
+	}
+	sdf.cellSize = vec3(cell);
+	sdf.values.resize(sdf.res.i1*sdf.res.i2*sdf.res.i3);
+	// threaded by row; each sample bounds its search by the nearest triangle of the previous sample
+	ParallelFor(sdf.res.i2*sdf.res.i3, [&](int row) {
+		int j = row%sdf.res.i2, k = row/sdf.res.i2, nearest = -1;
+		float *values = &sdf.values[row*sdf.res.i1];
+		vector<int> stack;
+		for (int i = 0; i < sdf.res.i1; i++) {
+			vec3 q = sdf.min+vec3(i*cell, j*cell, k*cell), d;
+			float best2 = FLT_MAX;
+			if (nearest >= 0) {
+				vec3 *v = &bvh.corners[3*nearest];
+				d = q-ClosestOnTriangle(q, v[0], v[1], v[2]);
+				best2 = dot(d, d);
+			}
+			best2 = Closest2(bvh, q, best2, nearest, stack);
+			values[i] = (Winding(bvh, q, 0) > .5f? -1 : 1)*sqrt(best2);
+		}
+	}, 1);
+	return true;
+}
+
+// Sampling
+
+float SDF::Sample(vec3 p) const {
+	if (values.empty())
+		return FLT_MAX;
+	int i[3];
+	float f[3];
+	vec3 clamped;
+	for (int a = 0; a < 3; a++) {
+		float x = std::max(0.f, std::min((float) (res[a]-1), (p[a]-min[a])/cellSize[a]));
+		clamped[a] = min[a]+x*cellSize[a];
+		i[a] = std::min((int) x, res[a]-2);
+		f[a] = x-i[a];
+	}
+	auto Lerp = [](float a, float b, float t) { return a+t*(b-a); };
+	float v00 = Lerp(Value(i[0], i[1], i[2]), Value(i[0]+1, i[1], i[2]), f[0]);
+	float v10 = Lerp(Value(i[0], i[1]+1, i[2]), Value(i[0]+1, i[1]+1, i[2]), f[0]);
+	float v01 = Lerp(Value(i[0], i[1], i[2]+1), Value(i[0]+1, i[1], i[2]+1), f[0]);
+	float v11 = Lerp(Value(i[0], i[1]+1, i[2]+1), Value(i[0]+1, i[1]+1, i[2]+1), f[0]);
+	return Lerp(Lerp(v00, v10, f[1]), Lerp(v01, v11, f[1]), f[2])+length(p-clamped);
+}
+
+vec3 SDF::Gradient(vec3 p) const {
+	vec3 g;
+	for (int a = 0; a < 3; a++) {
+		vec3 h;
+		h[a] = .5f*cellSize[a];
+		g[a] = (Sample(p+h)-Sample(p-h))/cellSize[a];
+	}
+	return g;
+}
+
+vec3 SDF::Project(vec3 p, int iterations) const {
+	for (int i = 0; i < iterations; i++) {
+		vec3 g = Gradient(p);
+		float len = length(g);
+		if (len == 0)
+			break;
+		p -= (Sample(p)/len)*g;
+	}
+	return p;
+}
+
+// GPU
+
+GLuint SDF::Upload() {
+	if (values.empty())
+		return 0;
+	if (!texture)
+		glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_3D, texture);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, res.i1, res.i2, res.i3, 0, GL_RED, GL_FLOAT, values.data());
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_3D, 0);
+	return texture;
+}
+
+mat4 SDF::TextureTransform() const {
+	// ((p-min)/cellSize+.5)/res
+	vec3 s(1/(cellSize.x*res.i1), 1/(cellSize.y*res.i2), 1/(cellSize.z*res.i3));
+	return Translate(.5f/res.i1, .5f/res.i2, .5f/res.i3)*Scale(s.x, s.y, s.z)*Translate(-min);
+}
+
+void SDF::Release() {
+	if (texture)
+		glDeleteTextures(1, &texture);
+	texture = 0;
+}
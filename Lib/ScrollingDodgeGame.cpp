@@ -4,9 +4,12 @@
 #include <glad.h>
 #include <GLFW/glfw3.h>
 #include <time.h>
+#include <string.h>
 #include <vector>
 #include "GLXtras.h"
+#include "DepthQuery.h"
 #include "Draw.h"
+#include "GLState.h"
 #include "Text.h"
 #include "IO.h"
 #include "Sprite.h"
@@ -49,6 +52,9 @@ Sprite fences[3] = { fence1, fence2, fence3 };
 // gamestate
 bool	startedGame = false, scrolling = false, endGame = false;
 float	currentScore = 0.0, highScore = 0.0;
+TextBlock currentScoreText((float) (winWidth - 550), (float) (winHeight - 50), vec3(1, 1, 1), 20);
+TextBlock highScoreText((float) (winWidth - 550), (float) (winHeight - 100), vec3(1, 1, 1), 20);
+	// laid out again only when a score changes
 bool	bertBlinking = false;
 bool	jumping = false;
 float	velocityUp = 0.3f, velocityDown = 0.0f, gravity = -0.05f;
@@ -62,6 +68,7 @@ int		chance = 0;
 int     bounds[4];
 int		levels[] = { 1, 0, 0 };
 int     numObstacles = 1;
+bool	verbose = false;	// -v: print GL state, program cache and shader timings at exit
 
 // times
 time_t	startTime = clock();
@@ -80,24 +87,20 @@ int     oldTime = 0;
 // probes: locations wrt cactus sprite
 vec2	cactusSensors[] = { { .9f, .3f}, { .3f, 0.9f }, { -.2f, 0.9f }, { 0.9f, 0.0f }, { -.9f, -.4f }, { -.9f, .0f } };
 const	int nCactusSensors = sizeof(cactusSensors) / sizeof(vec2);
-vec3	cactusProbes[nCactusSensors];
 
 vec2	fenceSensors[] = { {-0.99f, -0.14f}, {-0.96f, 0.31f}, {-0.72f, 0.85f}, {-0.35f, 0.84f}, {0.03f, 0.84f}, {0.40f, 0.84f},
 	{0.77f, 0.84f}, {0.95f, 0.31f}, {0.98f, -0.15f} };
 const	int nFenceSensors = sizeof(fenceSensors) / sizeof(vec2);
-vec3	fenceProbes[nFenceSensors];
 
 vec2	bushSensors[] = { {-0.97f, -0.63f}, {-0.98f, -0.20f}, {-0.92f, 0.02f}, {-0.88f, 0.10f}, {-0.82f, 0.22f}, {-0.47f, 0.32f},
 	{-0.38f, 0.51f}, {-0.31f, 0.63f}, {-0.21f, 0.75f}, {-0.11f, 0.83f}, {0.11f, 0.83f}, {0.22f, 0.72f}, {0.31f, 0.61f}, {0.37f, 0.52f},
 	{0.43f, 0.40f}, {0.47f, 0.31f}, {0.53f, 0.01f}, {0.61f, 0.01f}, {0.78f, -0.00f}, {0.89f, -0.11f}, {0.94f, -0.22f}, {0.98f, -0.31f} };
 const	int nBushSensors = sizeof(bushSensors) / sizeof(vec2);
-vec3	bushProbes[nBushSensors];
 
 vec2	clockSensors[] = { {-0.87f, -0.67f}, {-0.85f, -0.47f}, {-0.86f, -0.23f}, {-0.87f, 0.15f}, {-0.98f, 0.36f}, {-0.84f, 0.52f},
 	{-0.66f, 0.60f}, {-0.35f, 0.74f}, {-0.25f, 0.84f}, {0.01f, 0.84f}, {0.26f, 0.83f}, {0.34f, 0.75f}, {0.63f, 0.60f}, {0.85f, 0.52f},
 	{0.96f, 0.38f}, {0.85f, 0.15f}, {0.85f, -0.23f} };
 const	int nClockSensors = sizeof(clockSensors) / sizeof(vec2);
-vec3	clockProbes[nClockSensors];
 
 // misc
 float	maxJumpHeight;
@@ -289,18 +292,54 @@ void UpdateStatus() {
 }
 
 // Probing Z-Buffer
+// sensors of all obstacles (and the clock) are submitted after bert is drawn, before any obstacle,
+// and read back in one asynchronous capture; hits are evaluated when the capture resolves (a frame later)
 
-vec3 Probe(vec2 ndc) {
-	// ndc (normalized device coords) lower left (-1,-1) to upper right (1,1)
-	// return screen-space s: s.z is depth-buffer value at pixel (s.x, s.y)
-	int4 vp = VP();
-	vec3 s(vp[0] + (ndc.x + 1) * vp[2] / 2, vp[1] + (ndc.y + 1) * vp[3] / 2, 0);
-	DepthXY((int)s.x, (int)s.y, s.z);
-	return s;
+enum { ObstacleProbe = 1, ClockProbe = 2 };
+DepthQueries probes;
+
+void SubmitProbes(vec2 *sensors, int nSensors, mat4 m, int tag) {
+	// sensors in sprite space, m maps to ndc (normalized device coords), lower left (-1,-1) to upper right (1,1)
+	int4 vp = VPi();
+	for (int i = 0; i < nSensors; i++) {
+		vec2 ndc = Vec2(m * vec4(sensors[i], 0, 1));
+		probes.Submit((int)(vp[0] + (ndc.x + 1) * vp[2] / 2), (int)(vp[1] + (ndc.y + 1) * vp[3] / 2), tag);
+	}
+}
+
+void SubmitProbes() {
+	for (int i = 0; i < 3; i++) {
+		if (levels[i] == 1)
+			SubmitProbes(cactusSensors, nCactusSensors, cacti[i].ptTransform, ObstacleProbe);
+		else if (levels[i] == 2)
+			SubmitProbes(bushSensors, nBushSensors, bushes[i].ptTransform, ObstacleProbe);
+		else if (levels[i] == 3)
+			SubmitProbes(fenceSensors, nFenceSensors, fences[i].ptTransform, ObstacleProbe);
+	}
+	if (levelBound >= 3 && !clockUsed && !clockCoolDown)
+		SubmitProbes(clockSensors, nClockSensors, freezeClock.ptTransform, ClockProbe);
+	if (!probes.Pending())
+		bertHit = false;
+	probes.Capture();
 }
 
-vec3 Probe(vec2 v, mat4 m) {
-	return Probe(Vec2(m * vec4(v, 0, 1)));
+void ResolveProbes() {
+	if (!probes.Resolve())
+		return;
+	bool obstacleHit = false, clockHit = false;
+	for (DepthQueries::Result &r : probes.results)
+		if (abs(r.depth - bertRunning.z) < .05f)
+			(r.tag == ClockProbe ? clockHit : obstacleHit) = true;
+	bertHit = obstacleHit;
+	if (obstacleHit)
+		bertSwitch = true;
+	if (clockHit && !clockUsed && !clockCoolDown)
+	{
+		clockUsed = true;
+		oldTime = loopDurationGround;
+		loopDurationGround = 2.5;
+		startClock = clock();
+	}
 }
 
 // Display
@@ -321,77 +360,8 @@ void blinkingBert() {
 	}
 }
 
-void displayCactus(int index)
-{
-	for (int i = 0; i < nCactusSensors; i++)
-	{
-		cactusProbes[i] = Probe(cactusSensors[i], cacti[index].ptTransform);
-	}
-	cacti[index].Display();
-	bertHit = false;
-	for (vec3 p : cactusProbes)
-	{
-		if (abs(p.z - bertRunning.z) < .05f)
-		{
-			bertHit = true;
-			bertSwitch = true;
-		}
-	}
-}
-
-void displayBush(int index)
-{
-	for (int i = 0; i < nBushSensors; i++)
-	{
-		bushProbes[i] = Probe(bushSensors[i], bushes[index].ptTransform);
-	}
-	bushes[index].Display();
-	bertHit = false;
-	for (vec3 u : bushProbes)
-	{
-		if (abs(u.z - bertRunning.z) < .05f)
-		{
-			bertHit = true;
-			bertSwitch = true;
-		}
-	}
-}
-
-void displayFence(int index)
-{
-	for (int i = 0; i < nFenceSensors; i++)
-	{
-		fenceProbes[i] = Probe(fenceSensors[i], fences[index].ptTransform);
-	}
-	fences[index].Display();
-	bertHit = false;
-	for (vec3 q : fenceProbes)
-	{
-		if (abs(q.z - bertRunning.z) < .05f)
-		{
-			bertHit = true;
-			bertSwitch = true;
-		}
-	}
-}
-
-void displayClock()
-{
-	for (int i = 0; i < nClockSensors; i++)
-	{
-		clockProbes[i] = Probe(clockSensors[i], freezeClock.ptTransform);
-	}
-	freezeClock.Display();
-	for (vec3 p : clockProbes)
-	{
-		if (abs(p.z - bertRunning.z) < .05f)
-		{
-			clockUsed = true;
-		}
-	}
-}
-
 void Display(float dt) {
+	ResolveProbes();
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glEnable(GL_DEPTH_TEST);
@@ -433,27 +403,23 @@ void Display(float dt) {
 		bertHurtDisplayTime = 0;
 	}
 
+	SubmitProbes();
+
 	for (int i = 0; i < 3; i++) {
 		if (levels[i] == 1) {
-			displayCactus(i);
+			cacti[i].Display();
 		}
 		else if (levels[i] == 2) {
-			displayBush(i);
+			bushes[i].Display();
 		}
 		else if (levels[i] == 3) {
-			displayFence(i);
+			fences[i].Display();
 		}
 	}
 
 	if (levelBound >= 3 && !clockUsed && !clockCoolDown)
 	{
-		displayClock();
-		if (clockUsed)
-		{
-			oldTime = loopDurationGround;
-			loopDurationGround = 2.5;
-			startClock = clock();
-		}
+		freezeClock.Display();
 	}
 
 	// Checks clock usage in order to reset when freeze effect is over
@@ -499,8 +465,10 @@ void Display(float dt) {
 	}
 
 	glDisable(GL_DEPTH_TEST);
-	Text(winWidth - 550, winHeight - 50, vec3(1, 1, 1), 20, "Current Score: %.0f", currentScore);
-	Text(winWidth - 550, winHeight - 100, vec3(1, 1, 1), 20, "High Score: %.0f", highScore);
+	currentScoreText.Print("Current Score: %.0f", currentScore);
+	currentScoreText.Draw();
+	highScoreText.Print("High Score: %.0f", highScore);
+	highScoreText.Draw();
 
 	glFlush();
 }
@@ -574,9 +542,11 @@ void Resize(int width, int height) {
 int main(int ac, char** av) {
 	// Ensures random chance variable for every run 
 	srand(time(NULL));
+	verbose = ac > 1 && !strcmp(av[1], "-v");
 
 	// init app window and GL context
 	GLFWwindow* w = InitGLFW(100, 100, winWidth, winHeight, "BertGame");
+	WarmUpShaders({ "Sprite", "Letters", "Text" });	// driver compiles the game's shaders while textures load
 
 	// sprites
 	clouds.Initialize(cloudsImage, 0, false);
@@ -626,6 +596,15 @@ int main(int ac, char** av) {
 		glfwPollEvents();
 	}
 	// terminate
+	if (verbose) {
+		PrintGLStateCounts();
+		PrintProgramCacheCounts();
+		PrintShaderTimes();
+	}
+	ReleaseUnclaimedShaders();
+	probes.Release();
+	currentScoreText.Release();
+	highScoreText.Release();
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glfwDestroyWindow(w);
 	glfwTerminate();
@@ -0,0 +1,277 @@
+// Simplify.cpp - quadric error edge-collapse simplification (after Garland and Heckbert)
+
+#include <algorithm>
+#include <stdint.h>
+#include "Misc.h"
+#include "Simplify.h"
+
+namespace {
+
+struct Quadric {
+	// symmetric 4x4 error matrix (upper triangle): error(p) = [p 1] Q [p 1]T / w
+	double a00 = 0, a01 = 0, a02 = 0, a03 = 0, a11 = 0, a12 = 0, a13 = 0, a22 = 0, a23 = 0, a33 = 0;
+	double w = 0;								// sum of weights, so error is mean squared distance
+	Quadric() { }
+	Quadric(vec3 n, float d, float w) {
+		// squared distance to plane n.p+d = 0, weighted by w
+		a00 = w*n.x*n.x; a01 = w*n.x*n.y; a02 = w*n.x*n.z; a03 = w*n.x*d;
+		a11 = w*n.y*n.y; a12 = w*n.y*n.z; a13 = w*n.y*d;
+		a22 = w*n.z*n.z; a23 = w*n.z*d;
+		a33 = w*d*d;
+		this->w = w;
+	}
+	Quadric &operator += (const Quadric &q) {
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+		a11 += q.a11; a12 += q.a12; a13 += q.a13;
+		a22 += q.a22; a23 += q.a23; a33 += q.a33;
+		w += q.w;
+		return *this;
+	}
+	double Error(vec3 p) const {
+		double x = p.x, y = p.y, z = p.z;
+		double e = x*(a00*x+2*(a01*y+a02*z+a03))+y*(a11*y+2*(a12*z+a13))+z*(a22*z+2*a23)+a33;
+		return e > 0 && w > 0? e/w : 0;
+	}
+};
+
+struct Collapse {
+	int from = -1, to = -1;
+	float cost = FLT_MAX;
+	bool operator < (const Collapse &c) const { return cost < c.cost; }
+};
+
+uint64_t EdgeKey(int a, int b) {
+	return a < b? ((uint64_t) a << 32) | (uint32_t) b : ((uint64_t) b << 32) | (uint32_t) a;
+}
+
+bool Contains(const int3 &t, int v) { return t.i1 == v || t.i2 == v || t.i3 == v; }
+
+void BuildAdjacency(vector<int3> &tris, int nVertices, vector<int> &offsets, vector<int> &adjacent) {
+	// vertex-to-triangle adjacency: triangles of vertex v are adjacent[offsets[v]] to adjacent[offsets[v+1]-1]
+	offsets.assign(nVertices+1, 0);
+	for (size_t t = 0; t < tris.size(); t++)
+		for (int k = 0; k < 3; k++)
+			offsets[tris[t][k]+1]++;
+	for (int v = 0; v < nVertices; v++)
+		offsets[v+1] += offsets[v];
+	adjacent.resize(3*tris.size());
+	vector<int> fill(offsets.begin(), offsets.end()-1);
+	for (size_t t = 0; t < tris.size(); t++)
+		for (int k = 0; k < 3; k++)
+			adjacent[fill[tris[t][k]]++] = (int) t;
+}
+
+bool LinkCondition(vector<int3> &tris, vector<int> &offsets, vector<int> &adjacent, int a, int b, vector<int> &ring) {
+	// collapse of edge ab keeps mesh manifold only if the vertices adjacent to both a and b
+	// are those opposite ab in the triangles sharing ab
+	ring.resize(0);
+	int nOpposite = 0;
+	for (int i = offsets[a]; i < offsets[a+1]; i++) {
+		int3 &t = tris[adjacent[i]];
+		bool hasB = Contains(t, b);
+		for (int k = 0; k < 3; k++)
+			if (t[k] != a && t[k] != b)
+				ring.push_back(t[k]);
+		nOpposite += hasB;
+	}
+	std::sort(ring.begin(), ring.end());
+	ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+	int nCommon = 0;
+	for (int i = offsets[b]; i < offsets[b+1]; i++) {
+		int3 &t = tris[adjacent[i]];
+		for (int k = 0; k < 3; k++)
+			if (t[k] != a && t[k] != b && std::binary_search(ring.begin(), ring.end(), t[k])) {
+				nCommon++;
+				// count each common vertex once
+				ring.erase(std::lower_bound(ring.begin(), ring.end(), t[k]));
+			}
+	}
+	return nCommon == nOpposite;
+}
+
+void LockVertices(vector<vec3> &points, vector<int3> &tris, vector<int> &triGroups, vector<char> &locked) {
+	int nVertices = points.size(), nTris = tris.size();
+	locked.assign(nVertices, 0);
+	// seams: vertices that share a position (split for uv or normal discontinuity)
+	vector<int> order(nVertices);
+	for (int i = 0; i < nVertices; i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&points](int a, int b) {
+		vec3 &p = points[a], &q = points[b];
+		return p.x != q.x? p.x < q.x : p.y != q.y? p.y < q.y : p.z < q.z;
+	});
+	for (int i = 1; i < nVertices; i++) {
+		vec3 &p = points[order[i-1]], &q = points[order[i]];
+		if (p.x == q.x && p.y == q.y && p.z == q.z)
+			locked[order[i-1]] = locked[order[i]] = 1;
+	}
+	// borders and non-manifold edges: edges not shared by exactly two triangles
+	vector<uint64_t> edges(3*nTris);
+	for (int t = 0; t < nTris; t++)
+		for (int k = 0; k < 3; k++)
+			edges[3*t+k] = EdgeKey(tris[t][k], tris[t][(k+1)%3]);
+	std::sort(edges.begin(), edges.end());
+	for (size_t i = 0, n; i < edges.size(); i += n) {
+		for (n = 1; i+n < edges.size() && edges[i+n] == edges[i]; n++) ;
+		if (n != 2)
+			locked[(int) (edges[i] >> 32)] = locked[(int) (edges[i] & 0xffffffff)] = 1;
+	}
+	// group boundaries: vertices used by triangles of different groups
+	vector<int> vertexGroups(nVertices, -2);
+	for (int t = 0; t < nTris; t++)
+		for (int k = 0; k < 3; k++) {
+			int v = tris[t][k], &g = vertexGroups[v];
+			if (g == -2)
+				g = triGroups[t];
+			else if (g != triGroups[t])
+				locked[v] = 1;
+		}
+}
+
+} // end namespace
+
+int Simplify(vector<vec3> &points, vector<int3> &triangles, vector<int3> &result, int targetTriangles,
+			 float maxError, vector<Group> *groups, vector<Group> *resultGroups, float *resultError) {
+	int nVertices = points.size(), nGroups = groups? groups->size() : 0;
+	vector<int3> tris = triangles;
+	vector<int> triGroups(tris.size(), -1);
+	for (int g = 0; g < nGroups; g++) {
+		Group &grp = (*groups)[g];
+		for (int t = grp.startTriangle; t < grp.startTriangle+grp.nTriangles && t < (int) tris.size(); t++)
+			triGroups[t] = g;
+	}
+	vector<char> locked;
+	LockVertices(points, tris, triGroups, locked);
+	// vertex quadrics: area-weighted plane quadrics of adjacent triangles
+	vector<Quadric> triQuadrics(tris.size()), quadrics(nVertices);
+	ParallelFor(tris.size(), [&](int t) {
+		vec3 p1 = points[tris[t].i1], n = cross(points[tris[t].i2]-p1, points[tris[t].i3]-p1);
+		float area2 = length(n);
+		if (area2 > 0)
+			triQuadrics[t] = Quadric(n/area2, -dot(n, p1)/area2, .5f*area2);
+	});
+	vector<int> offsets, adjacent;
+	BuildAdjacency(tris, nVertices, offsets, adjacent);
+	ParallelFor(nVertices, [&](int v) {
+		for (int i = offsets[v]; i < offsets[v+1]; i++)
+			quadrics[v] += triQuadrics[adjacent[i]];
+	});
+	// passes of independent collapses, each pass in order of increasing cost
+	double maxCost = maxError < FLT_MAX? (double) maxError*maxError : DBL_MAX, largestCost = 0;
+	vector<int> remap(nVertices);
+	vector<char> marked(nVertices);
+	vector<uint64_t> edges;
+	vector<Collapse> collapses;
+	vector<int> ring;
+	while ((int) tris.size() > targetTriangles) {
+		// unique edges
+		edges.resize(3*tris.size());
+		for (size_t t = 0; t < tris.size(); t++)
+			for (int k = 0; k < 3; k++)
+				edges[3*t+k] = EdgeKey(tris[t][k], tris[t][(k+1)%3]);
+		std::sort(edges.begin(), edges.end());
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+		// cost of cheaper direction for each edge
+		collapses.resize(edges.size());
+		ParallelFor(edges.size(), [&](int i) {
+			int a = (int) (edges[i] >> 32), b = (int) (edges[i] & 0xffffffff);
+			Collapse c;
+			Quadric q = quadrics[a];
+			q += quadrics[b];
+			if (!locked[a]) {
+				c.from = a; c.to = b;
+				c.cost = (float) q.Error(points[b]);
+			}
+			if (!locked[b]) {
+				float cost = (float) q.Error(points[a]);
+				if (cost < c.cost) {
+					c.from = b; c.to = a;
+					c.cost = cost;
+				}
+			}
+			collapses[i] = c;
+		}, 4096);
+		std::sort(collapses.begin(), collapses.end());
+		BuildAdjacency(tris, nVertices, offsets, adjacent);
+		for (int v = 0; v < nVertices; v++) {
+			remap[v] = v;
+			marked[v] = 0;
+		}
+		int nRemove = tris.size()-targetTriangles, nRemoved = 0, nCollapses = 0;
+		for (size_t i = 0; i < collapses.size() && nRemoved < nRemove; i++) {
+			Collapse &c = collapses[i];
+			if (c.from < 0 || c.cost > maxCost)
+				break;
+			if (marked[c.from] || marked[c.to])
+				continue;
+			// reject if any remaining triangle around c.from would flip or fold
+			bool flip = false;
+			int nVanish = 0;
+			for (int a = offsets[c.from]; a < offsets[c.from+1] && !flip; a++) {
+				int3 &t = tris[adjacent[a]];
+				if (Contains(t, c.to)) {
+					nVanish++;
+					continue;
+				}
+				vec3 p[3], q[3];
+				for (int k = 0; k < 3; k++) {
+					p[k] = points[t[k]];
+					q[k] = t[k] == c.from? points[c.to] : p[k];
+				}
+				vec3 n0 = cross(p[1]-p[0], p[2]-p[0]), n1 = cross(q[1]-q[0], q[2]-q[0]);
+				// reject if normal rotates more than ~75 degrees (small rotations accumulate over passes)
+				flip = dot(n0, n0) > 0 && dot(n0, n1) < .25f*length(n0)*length(n1);
+			}
+			if (flip || !LinkCondition(tris, offsets, adjacent, c.from, c.to, ring))
+				continue;
+			remap[c.from] = c.to;
+			quadrics[c.to] += quadrics[c.from];
+			// mark one-ring so collapses within a pass are independent
+			for (int a = offsets[c.from]; a < offsets[c.from+1]; a++)
+				for (int k = 0; k < 3; k++)
+					marked[tris[adjacent[a]][k]] = 1;
+			nRemoved += nVanish;
+			nCollapses++;
+			largestCost = std::max(largestCost, (double) c.cost);
+		}
+		if (!nCollapses)
+			break;
+		// apply collapses, remove degenerate triangles, preserve order (and thus groups)
+		size_t n = 0;
+		for (size_t t = 0; t < tris.size(); t++) {
+			int3 r(remap[tris[t].i1], remap[tris[t].i2], remap[tris[t].i3]);
+			if (r.i1 != r.i2 && r.i2 != r.i3 && r.i3 != r.i1) {
+				triGroups[n] = triGroups[t];
+				tris[n++] = r;
+			}
+		}
+		tris.resize(n);
+		triGroups.resize(n);
+	}
+	if (resultGroups && groups) {
+		*resultGroups = *groups;
+		for (int g = 0; g < nGroups; g++)
+			(*resultGroups)[g].startTriangle = (*resultGroups)[g].nTriangles = 0;
+		for (int t = 0; t < (int) tris.size(); t++)
+			if (triGroups[t] >= 0) {
+				Group &g = (*resultGroups)[triGroups[t]];
+				if (!g.nTriangles++)
+					g.startTriangle = t;
+			}
+		// empty groups start where the previous group ends
+		int next = 0;
+		while (next < (int) tris.size() && triGroups[next] < 0)
+			next++;
+		for (int g = 0; g < nGroups; g++) {
+			Group &grp = (*resultGroups)[g];
+			if (grp.nTriangles)
+				next = grp.startTriangle+grp.nTriangles;
+			else
+				grp.startTriangle = next;
+		}
+	}
+	if (resultError)
+		*resultError = (float) sqrt(largestCost);
+	result = tris;
+	return result.size();
+}
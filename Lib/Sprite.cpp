@@ -15,78 +15,82 @@ GLuint spriteShader = 0, spriteCollisionShader = 0;
 
 namespace SpriteSpace {
 
-int BuildSpriteShader(bool collisionTest = false) {
-	const char *vShader = R"(
-		#version 330
-		uniform mat4 view;
-		uniform float z = 0;
-		out vec2 uv;
-		void main() {
-			// works for 1 quad or 2 tris
-			const vec2 pts[6] = vec2[6](vec2(-1,-1), vec2(1,-1), vec2(1,1), vec2(-1,1), vec2(-1,-1), vec2(1,1));
-			uv = (vec2(1,1)+pts[gl_VertexID])/2;
-			gl_Position = view*vec4(pts[gl_VertexID], z, 1);
+const char *vShader = R"(
+	#version 330
+	uniform mat4 view;
+	uniform float z = 0;
+	out vec2 uv;
+	void main() {
+		// works for 1 quad or 2 tris
+		const vec2 pts[6] = vec2[6](vec2(-1,-1), vec2(1,-1), vec2(1,1), vec2(-1,1), vec2(-1,-1), vec2(1,1));
+		uv = (vec2(1,1)+pts[gl_VertexID])/2;
+		gl_Position = view*vec4(pts[gl_VertexID], z, 1);
+	}
+)";
+const char *pShader = R"(
+	#version 330
+	in vec2 uv;
+	out vec4 pColor;
+	uniform mat4 uvTransform;
+	uniform sampler2D textureImage, textureMat;
+	uniform bool useMat;
+	uniform int nTexChannels = 3;
+	void main() {
+		vec2 st = (uvTransform*vec4(uv, 0, 1)).xy;
+		if (nTexChannels == 4)
+			pColor = texture(textureImage, st);
+		else {
+			pColor.rgb = texture(textureImage, st).rgb;
+			pColor.a = useMat? texture(textureMat, st).r : 1;
 		}
-	)";
-	const char *pShader = R"(
-		#version 330
-		in vec2 uv;
-		out vec4 pColor;
-		uniform mat4 uvTransform;
-		uniform sampler2D textureImage, textureMat;
-		uniform bool useMat;
-		uniform int nTexChannels = 3;
-		void main() {
-			vec2 st = (uvTransform*vec4(uv, 0, 1)).xy;
-			if (nTexChannels == 4)
-				pColor = texture(textureImage, st);
-			else {
-				pColor.rgb = texture(textureImage, st).rgb;
-				pColor.a = useMat? texture(textureMat, st).r : 1;
-			}
-			if (pColor.a < .02) // if nearly full matte,
-				discard;		// don't tag z-buffer
+		if (pColor.a < .02) // if nearly full matte,
+			discard;		// don't tag z-buffer
+	}
+)";
+const char *pCollisionShader = R"(
+	#version 430
+	layout(binding = 11, std430) buffer Occupy  { int occupy[]; };		// set occupy[x][y] to sprite id
+	layout(binding = 12, std430) buffer Collide { int collide[]; };		// does spriteId collide with spriteN?
+	layout(binding = 0, r32ui) uniform uimage1D atomicCollide;			// does spriteId collide with spriteN?
+	layout(binding = 0, offset = 0) uniform atomic_uint counter;		// # collided pixels
+	in vec2 uv;
+	out vec4 pColor;
+	uniform vec4 vp;
+	uniform bool showOccupy = false, useMat = false;
+	uniform sampler2D textureImage, textureMat;
+	uniform mat4 uvTransform;
+	uniform int spriteId = 0, nTexChannels = 3;
+	void main() {
+		vec2 st = (uvTransform*vec4(uv, 0, 1)).xy;
+		if (nTexChannels == 4)
+			pColor = texture(textureImage, st);
+		else {
+			pColor.rgb = texture(textureImage, st).rgb;
+			pColor.a = useMat? texture(textureMat, st).r : 1;
 		}
-	)";
-	const char *pCollisionShader = R"(
-		#version 430
-		layout(binding = 11, std430) buffer Occupy  { int occupy[]; };		// set occupy[x][y] to sprite id
-		layout(binding = 12, std430) buffer Collide { int collide[]; };		// does spriteId collide with spriteN?
-		layout(binding = 0, r32ui) uniform uimage1D atomicCollide;			// does spriteId collide with spriteN?
-		layout(binding = 0, offset = 0) uniform atomic_uint counter;		// # collided pixels
-		in vec2 uv;
-		out vec4 pColor;
-		uniform vec4 vp;
-		uniform bool showOccupy = false, useMat = false;
-		uniform sampler2D textureImage, textureMat;
-		uniform mat4 uvTransform;
-		uniform int spriteId = 0, nTexChannels = 3;
-		void main() {
-			vec2 st = (uvTransform*vec4(uv, 0, 1)).xy;
-			if (nTexChannels == 4)
-				pColor = texture(textureImage, st);
-			else {
-				pColor.rgb = texture(textureImage, st).rgb;
-				pColor.a = useMat? texture(textureMat, st).r : 1;
-			}
-			if (pColor.a < .02) // if nearly full matte, don't tag z-buffer
-				discard;
-			if (pColor.a >= .02) {
-				vec3 cols[] = vec3[](vec3(.7,.13,.13),vec3(1,0,0),vec3(1,1,0),vec3(0,1,0),vec3(.6,.2,.8),vec3(0,0,.8),vec3(1,.45,.23),
-									 vec3(0,.39,0),vec3(.12,.57,1),vec3(1,0,1),vec3(.24,.7,.44),vec3(0,.81,.82),vec3(.78,.08,.52));
-			//	vec3 cols[] = vec3[](vec3(1,0,0),vec3(1,1,0),vec3(0,1,0),vec3(0,0,1));
-				int id = int((gl_FragCoord.y-vp[1])*vp[2]+gl_FragCoord.x-vp[0]);
-				int o = occupy[id];
-				if (o > -1) {
-					collide[o] = 1;
-					atomicCounterIncrement(counter);
-					if (showOccupy)
-						pColor = vec4(cols[(o+spriteId) % 12], 1);
-				}
-				occupy[id] = spriteId;
+		if (pColor.a < .02) // if nearly full matte, don't tag z-buffer
+			discard;
+		if (pColor.a >= .02) {
+			vec3 cols[] = vec3[](vec3(.7,.13,.13),vec3(1,0,0),vec3(1,1,0),vec3(0,1,0),vec3(.6,.2,.8),vec3(0,0,.8),vec3(1,.45,.23),
+								 vec3(0,.39,0),vec3(.12,.57,1),vec3(1,0,1),vec3(.24,.7,.44),vec3(0,.81,.82),vec3(.78,.08,.52));
+		//	vec3 cols[] = vec3[](vec3(1,0,0),vec3(1,1,0),vec3(0,1,0),vec3(0,0,1));
+			int id = int((gl_FragCoord.y-vp[1])*vp[2]+gl_FragCoord.x-vp[0]);
+			int o = occupy[id];
+			if (o > -1) {
+				collide[o] = 1;
+				atomicCounterIncrement(counter);
+				if (showOccupy)
+					pColor = vec4(cols[(o+spriteId) % 12], 1);
 			}
+			occupy[id] = spriteId;
 		}
-	)";
+	}
+)";
+
+static bool spriteRegistered = RegisterProgram("Sprite", &vShader, &pShader);
+static bool spriteCollisionRegistered = RegisterProgram("Sprite collision", &vShader, &pCollisionShader);
+
+int BuildSpriteShader(bool collisionTest = false) {
 	return LinkProgramViaCode(&vShader, collisionTest? &pCollisionShader : &pShader);
 }
 
@@ -278,10 +282,10 @@ void Sprite::InitializeGIF(string gifFile, float z) {
 	UpdateTransform();
 }
 
-bool Sprite::Hit(double x, double y) {
+bool Sprite::Hit(double x, double y, DepthQueries *depths) {
 	// test against z-buffer
 	float depth;
-	if (DepthXY((int) x, (int) y, depth))
+	if ((depths && depths->Depth((int) x, (int) y, depth)) || DepthXY((int) x, (int) y, depth))
 		return abs(depth-z) < .01;
 	// test against quad
 	vec2 test = NDCfromScreen(x, y);
@@ -7,8 +7,10 @@
 #include "GLXtras.h"
 #include "Letters.h"
 #include "Text.h"
+#include <algorithm>
 #include <map>
 #include <stdio.h>
+#include <string.h>
 
 // if FreeType not linked, comment next line:
 //#define FREETYPE_OK
@@ -23,6 +25,26 @@
 	}                                                  \
 }
 
+static int DecodeUtf8(const char *s, int *nBytes) {
+	// return code point at s (U+FFFD if malformed), set its length in bytes
+	unsigned char c = s[0];
+	int n = c < 0x80? 1 : (c >> 5) == 6? 2 : (c >> 4) == 14? 3 : (c >> 3) == 30? 4 : 0;
+	if (!n) {
+		*nBytes = 1;
+		return 0xFFFD;
+	}
+	int code = n == 1? c : c & (0x7F >> n);
+	for (int i = 1; i < n; i++) {
+		if ((s[i] & 0xC0) != 0x80) {
+			*nBytes = i;
+			return 0xFFFD;
+		}
+		code = (code << 6) | (s[i] & 0x3F);
+	}
+	*nBytes = n;
+	return code;
+}
+
 #ifndef FREETYPE_OK
 float scaleAdj = 1;//.5f;
 void Text(int x, int y, vec3 color, float scale, const char *format, ...) {
@@ -41,7 +63,7 @@ void Text(float x, float y, vec3 color, float scale, const char *format, ...) {
 	FormatString(text, 500, format);
 	Letters((int) x, (int) y, text, color, scaleAdj*scale);
 }
-void RenderText(const char *text, float x, float y, vec3 color, float scale, mat4 view) {
+void RenderText(const char *text, float x, float y, vec3 color, float scale, mat4 view, bool vertical) {
 	vec2 s = ScreenPoint(vec3(x, y, 0), view);
 	Letters((int) s.x, (int) s.y, text, color, scaleAdj*scale);
 }
@@ -57,14 +79,38 @@ int TextWidth(int scale, const char *format, ...) {
 	return (int) TextWidth((float) scale, text);
 }
 CharacterSet *SetFont(const char *fontName, int charRes, int pixelRes, bool forceInit) { return NULL; };
+void BeginText() { BeginLetters(); }
+void EndText() { EndLetters(); }
+void FlushText() { FlushLetters(); }
+void TextOutline(float width, vec3 color) { }
+void TextShadow(vec2 offset, float opacity, vec3 color) { }
+void SetGlyphCacheSize(int maxBytes) { }
+int GlyphCacheSize() { return 0; }
+void ClearGlyphCache() { }
+static CharacterSet *TextFont() { return NULL; }
+static int GlyphGeneration() { return 0; }
+static void CacheText(CharacterSet *font, const char *text) { }
+static float AddGlyph(CharacterSet *font, int c, float x, float y, vec3 color, float scale, std::vector<GlyphVertex> &v) {
+	if (c < 128)
+		LetterQuads((int) x, (int) y, (char) c, color, scaleAdj*scale, v);
+	return scaleAdj*scale;
+}
+static void UseGlyphShader(mat4 view) { UseLettersShader(view); }
+static void GlyphAttributes(int program) {
+	VertexAttribPointer(program, "point", 4, sizeof(GlyphVertex), 0);
+	VertexAttribPointer(program, "color", 3, sizeof(GlyphVertex), (void *) (2*sizeof(vec2)));
+}
 #else
 
 #include <ft2build.h>
 #include <freetype/freetype.h>
+#include <vector>
+#include "Misc.h"
 
 using std::string;
+using std::vector;
 
-static GLuint textShaderProgram = 0, textVertexBuffer = 0;
+static GLuint textShaderProgram = 0, textVertexArray = 0, textVertexBuffer = 0;
 
 CharacterSet *currentFont = NULL;
 
@@ -72,124 +118,514 @@ CharacterSet *currentFont = NULL;
 struct Compare { bool operator() (const string &a, const string &b) const { return a.compare(b) > 0; }};
 typedef std::map<string, CharacterSet, Compare> CharacterSets;
 CharacterSets fonts;
+static FT_Library ftLibrary = NULL;
 
-void SetCharacterSet(CharacterSet &cs, const char *fontName, int charRes, int pixelRes) {
-	cs.charRes = charRes;
-	// init FreeType, load font face
-	FT_Library ft;
-	FT_Face face;
-	if (FT_Init_FreeType(&ft) ||
-		FT_New_Face(ft, fontName, 0, &face) ||
-		FT_Set_Char_Size(face, 0, charRes*64, pixelRes, pixelRes) || // set character point size
-		FT_Set_Pixel_Sizes(face, 0, pixelRes))  {                    // set pixel res
-			printf("problem with FreeType, font load, or font face\n");
-			return;
+// signed distance fields
+// each glyph is rasterized at sdfOversample times atlas resolution and converted to a distance field
+// (.5 at the glyph edge, 1 inside and 0 outside at sdfSpread atlas pixels); glyphs are stored at sdfEm
+// pixels per em whatever the font's charRes and pixelRes, and serve every text size with crisp edges
+
+static const int pageSize = 1024, glyphPad = 2;		// pad keeps linear filtering from bleeding between glyphs
+static const int sdfEm = 48, sdfOversample = 4, sdfSpread = 6;
+
+struct Bitmap {
+	int c = 0;										// code point
+	int2 hiSize, hiBearing;							// rasterized glyph, at sdfEm*sdfOversample
+	GLuint hiAdvance = 0;
+	vector<unsigned char> hiPixels;
+	int2 size;										// distance field, including sdfSpread margin
+	vector<unsigned char> pixels;
+};
+
+static void DistanceTransform1D(const float *f, float *d, int *v, float *z, int n) {
+	// squared distance to nearest sample, each sample at height f (Felzenszwalb & Huttenlocher)
+	int k = 0;
+	v[0] = 0;
+	z[0] = -1e20f;
+	z[1] = 1e20f;
+	for (int q = 1; q < n; q++) {
+		float s = ((f[q]+q*q)-(f[v[k]]+v[k]*v[k]))/(2*q-2*v[k]);
+		while (s <= z[k]) {
+			k--;
+			s = ((f[q]+q*q)-(f[v[k]]+v[k]*v[k]))/(2*q-2*v[k]);
+		}
+		k++;
+		v[k] = q;
+		z[k] = s;
+		z[k+1] = 1e20f;
+	}
+	for (int q = 0, k = 0; q < n; q++) {
+		while (z[k+1] < q)
+			k++;
+		d[q] = (float) ((q-v[k])*(q-v[k]))+f[v[k]];
+	}
+}
+
+static void DistanceTransform(vector<float> &grid, int w, int h) {
+	// in: 0 at feature pixels, 1e20 elsewhere; out: squared distance to nearest feature
+	int n = std::max(w, h);
+	vector<float> f(n), d(n), z(n+1);
+	vector<int> v(n);
+	for (int x = 0; x < w; x++) {
+		for (int y = 0; y < h; y++)
+			f[y] = grid[y*w+x];
+		DistanceTransform1D(f.data(), d.data(), v.data(), z.data(), h);
+		for (int y = 0; y < h; y++)
+			grid[y*w+x] = d[y];
+	}
+	for (int y = 0; y < h; y++) {
+		DistanceTransform1D(&grid[y*w], d.data(), v.data(), z.data(), w);
+		memcpy(&grid[y*w], d.data(), w*sizeof(float));
+	}
+}
+
+static void MakeDistanceField(Bitmap &b) {
+	const int o = sdfOversample, margin = sdfSpread*o;
+	if (b.hiSize.i1 == 0 || b.hiSize.i2 == 0)
+		return;
+	b.size = int2((b.hiSize.i1+o-1)/o+2*sdfSpread, (b.hiSize.i2+o-1)/o+2*sdfSpread);
+	if (b.size.i1+2*glyphPad > pageSize || b.size.i2+2*glyphPad > pageSize) {
+		b.size = int2(0, 0);
+		return;
+	}
+	int w = b.size.i1*o, h = b.size.i2*o;
+	vector<float> toInk(w*h, 1e20f), toBlank(w*h, 0);
+	for (int y = 0; y < b.hiSize.i2; y++)
+		for (int x = 0; x < b.hiSize.i1; x++)
+			if (b.hiPixels[y*b.hiSize.i1+x] >= 128) {
+				int i = (y+margin)*w+x+margin;
+				toInk[i] = 0;
+				toBlank[i] = 1e20f;
+			}
+	DistanceTransform(toInk, w, h);
+	DistanceTransform(toBlank, w, h);
+	b.pixels.resize(b.size.i1*b.size.i2);
+	for (int y = 0; y < b.size.i2; y++)
+		for (int x = 0; x < b.size.i1; x++) {
+			int i = (y*o+o/2)*w+x*o+o/2;
+			float dist = toInk[i] > 0? .5f-sqrt(toInk[i]) : sqrt(toBlank[i])-.5f;	// in hi-res pixels, + inside
+			float v = .5f+dist/(2*margin);
+			b.pixels[y*b.size.i1+x] = (unsigned char) (255*(v < 0? 0 : v > 1? 1 : v)+.5f);
+		}
+	b.hiPixels = vector<unsigned char>();
+}
+
+// glyph cache
+// glyphs of all fonts share pages (layers of one texture array) added as needed up to maxPages; when
+// no page has room for a new glyph, the least recently used page is cleared and its glyphs forgotten
+
+static const int pageBytes = pageSize*pageSize;
+static int maxPages = 16;
+static GLuint pagesTexture = 0;
+static int nLayers = 0;								// allocated in pagesTexture
+static int glyphClock = 0, glyphGeneration = 0;		// use counter, incremented when glyphs are dropped
+
+struct Shelf { int y, height, x; };
+
+struct GlyphRef { CharacterSet *font; int c; };
+
+struct Page {
+	vector<Shelf> shelves;
+	int top = glyphPad;								// y of next shelf
+	int lastUse = 0;
+	vector<GlyphRef> glyphs;
+};
+
+static vector<Page> pages;
+
+static void BindPages() {
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, pagesTexture);
+}
+
+static void ClearLayer(int layer) {
+	vector<unsigned char> zeros(pageBytes, 0);
+	BindPages();
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, pageSize, pageSize, 1, GL_RED, GL_UNSIGNED_BYTE, zeros.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+static void GrowLayers() {
+	// double the texture array (up to maxPages), copying existing layers;
+	// without glCopyImageSubData (before GL 4.3), allocate maxPages layers at once
+	int n = glCopyImageSubData? std::min(maxPages, std::max(2*nLayers, 1)) : maxPages;
+	GLuint t;
+	glGenTextures(1, &t);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, t);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R8, pageSize, pageSize, n, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (pagesTexture) {
+		glCopyImageSubData(pagesTexture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, t, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, pageSize, pageSize, nLayers);
+		glDeleteTextures(1, &pagesTexture);
 	}
-	// load glyphs
+	pagesTexture = t;
+	nLayers = n;
+}
+
+static void EvictPage(int p) {
+	FlushText();									// pending text may use the page
+	for (GlyphRef &g : pages[p].glyphs)
+		g.font->characters.erase(g.c);
+	pages[p] = Page();
+	ClearLayer(p);
+	glyphGeneration++;
+}
+
+static bool Fit(Page &page, int w, int h, int &x, int &y) {
+	// shelf-pack: first shelf not much taller than h with room, else a new shelf
+	for (Shelf &s : page.shelves)
+		if (h <= s.height && 4*h >= 3*s.height && s.x+w+glyphPad <= pageSize) {
+			x = s.x;
+			y = s.y;
+			s.x += w+glyphPad;
+			return true;
+		}
+	if (page.top+h+glyphPad > pageSize)
+		return false;
+	Shelf s = { page.top, h, glyphPad+w+glyphPad };
+	page.shelves.push_back(s);
+	page.top += h+glyphPad;
+	x = glyphPad;
+	y = s.y;
+	return true;
+}
+
+static bool Allocate(int w, int h, int &page, int &x, int &y) {
+	for (page = 0; page < (int) pages.size(); page++)
+		if (Fit(pages[page], w, h, x, y))
+			return true;
+	int limit = glCopyImageSubData || !nLayers? maxPages : std::min(maxPages, nLayers);
+	if ((int) pages.size() < limit) {
+		if ((int) pages.size() == nLayers)
+			GrowLayers();
+		pages.push_back(Page());
+		page = (int) pages.size()-1;
+		ClearLayer(page);
+	}
+	else {
+		page = 0;
+		for (int p = 1; p < (int) pages.size(); p++)
+			if (pages[p].lastUse < pages[page].lastUse)
+				page = p;
+		EvictPage(page);
+	}
+	return Fit(pages[page], w, h, x, y);
+}
+
+static void CacheGlyphs(CharacterSet *font, vector<int> &codes) {
+	// rasterize (serially, FreeType faces are not thread-safe), make distance fields (in parallel), upload
+	FT_Face face = (FT_Face) font->face;
+	if (!face)
+		return;
+	std::sort(codes.begin(), codes.end());
+	codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+	vector<Bitmap> bitmaps;
 	FT_GlyphSlot g = face->glyph;
-	for (GLubyte c = 0; c < 128; c++) {
-		FT_Error r = FT_Load_Char(face, c, FT_LOAD_RENDER);
-		if (r)
-			printf("FreeType: failed to load Glyph\n");
+	for (int c : codes) {
+		if (font->characters.count(c))
+			continue;
+		Bitmap b;
+		b.c = c;
+		if (FT_Load_Char(face, (FT_ULong) c, FT_LOAD_RENDER))
+			printf("FreeType: failed to load glyph %d\n", c);
 		else {
-			// generate texture
-			GLuint texture;
-			glGenTextures(1, &texture);
-			glBindTexture(GL_TEXTURE_2D, texture);
-			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, g->bitmap.width, g->bitmap.rows, 0, GL_RED, GL_UNSIGNED_BYTE, g->bitmap.buffer);
-			// texture options
+			b.hiSize = int2(g->bitmap.width, g->bitmap.rows);
+			b.hiBearing = int2(g->bitmap_left, g->bitmap_top);
+			b.hiAdvance = (GLuint) g->advance.x;
+			b.hiPixels.resize(b.hiSize.i1*b.hiSize.i2);
+			for (int row = 0; row < b.hiSize.i2; row++)
+				memcpy(&b.hiPixels[row*b.hiSize.i1], g->bitmap.buffer+row*g->bitmap.pitch, b.hiSize.i1);
+		}
+		bitmaps.push_back(b);
+	}
+	ParallelFor((int) bitmaps.size(), [&bitmaps](int i) { MakeDistanceField(bitmaps[i]); }, 4);
+	// metrics in pixels at pixelRes, as with bitmap fonts
+	float toPixelRes = (float) font->pixelRes/sdfEm, hiToPixelRes = toPixelRes/sdfOversample;
+	for (Bitmap &b : bitmaps) {
+		Character ch;
+		ch.advance = (GLuint) (b.hiAdvance*hiToPixelRes+.5f);
+		int page, x, y;
+		if (b.size.i1 > 0 && Allocate(b.size.i1, b.size.i2, page, x, y)) {
+			BindPages();
 			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-			// store character
-			cs.characters[c] = Character(texture, int2(g->bitmap.width, g->bitmap.rows), int2(g->bitmap_left, g->bitmap_top), (GLuint) g->advance.x);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x, y, page, b.size.i1, b.size.i2, 1, GL_RED, GL_UNSIGNED_BYTE, b.pixels.data());
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			ch.uv0 = vec2((float) x/pageSize, (float) y/pageSize);
+			ch.uv1 = vec2((float) (x+b.size.i1)/pageSize, (float) (y+b.size.i2)/pageSize);
+			ch.page = page;
+			ch.size = toPixelRes*vec2((float) b.size.i1, (float) b.size.i2);
+			ch.bearing = hiToPixelRes*vec2((float) b.hiBearing.i1, (float) b.hiBearing.i2)+toPixelRes*vec2(-sdfSpread, sdfSpread);
+			pages[page].glyphs.push_back({font, b.c});
+			pages[page].lastUse = ++glyphClock;
 		}
+		font->characters[b.c] = ch;
+	}
+}
+
+static void CacheText(CharacterSet *font, const char *text) {
+	// cache any new glyphs in text together, so their distance fields are made in parallel
+	vector<int> codes;
+	for (const char *c = text; *c; ) {
+		int n, code = DecodeUtf8(c, &n);
+		c += n;
+		if (!font->characters.count(code))
+			codes.push_back(code);
+	}
+	if (codes.size())
+		CacheGlyphs(font, codes);
+}
+
+static Character *FindGlyph(CharacterSet *font, int c) {
+	CharacterMap::iterator it = font->characters.find(c);
+	if (it == font->characters.end()) {
+		vector<int> codes(1, c);
+		CacheGlyphs(font, codes);
+		it = font->characters.find(c);
+		if (it == font->characters.end())
+			return NULL;
+	}
+	if (it->second.page >= 0)
+		pages[it->second.page].lastUse = ++glyphClock;
+	return &it->second;
+}
+
+static int GlyphGeneration() { return glyphGeneration; }
+
+void SetGlyphCacheSize(int maxBytes) {
+	int n = std::max(1, maxBytes/pageBytes);
+	if (n < nLayers)
+		ClearGlyphCache();							// texture array is reallocated as needed
+	maxPages = n;
+}
+
+int GlyphCacheSize() { return nLayers*pageBytes; }
+
+void ClearGlyphCache() {
+	FlushText();
+	for (CharacterSets::iterator it = fonts.begin(); it != fonts.end(); it++)
+		it->second.characters.clear();
+	pages.clear();
+	if (pagesTexture)
+		glDeleteTextures(1, &pagesTexture);
+	pagesTexture = 0;
+	nLayers = 0;
+	glyphGeneration++;
+}
+
+// fonts
+
+void SetCharacterSet(CharacterSet &cs, const char *fontName, int charRes, int pixelRes) {
+	// open face; glyphs are rasterized as they are used
+	cs.charRes = charRes;
+	cs.pixelRes = pixelRes;
+	cs.face = NULL;
+	FT_Face face;
+	if ((!ftLibrary && FT_Init_FreeType(&ftLibrary)) ||
+		FT_New_Face(ftLibrary, fontName, 0, &face) ||
+		FT_Set_Pixel_Sizes(face, 0, sdfEm*sdfOversample)) {
+			printf("problem with FreeType, font load, or font face\n");
+			return;
 	}
-	FT_Done_Face(face);
-	FT_Done_FreeType(ft);
+	cs.face = face;
 }
 
 CharacterSet *SetFont(const char *fontName, int charRes, int pixelRes, bool forceInit) {
 	CharacterSets::iterator it = fonts.find(fontName);
 	if (it == fonts.end() || forceInit) {
-		CharacterSet cs;
+		CharacterSet &cs = fonts[string(fontName)];	// map nodes don't move: glyph cache refers to cs
+		if (cs.face) {
+			// reloading: forget glyphs (their images are left as dead space in the pages)
+			FlushText();
+			for (Page &p : pages)
+				p.glyphs.erase(std::remove_if(p.glyphs.begin(), p.glyphs.end(), [&cs](GlyphRef &g) { return g.font == &cs; }), p.glyphs.end());
+			cs.characters.clear();
+			FT_Done_Face((FT_Face) cs.face);
+			glyphGeneration++;
+		}
 		SetCharacterSet(cs, fontName, charRes, pixelRes);
-		fonts[string(fontName)] = cs;
 		it = fonts.find(fontName);
 	}
 	currentFont = &it->second;
 	return currentFont;
 }
 
-static const char *textVertexShader = "\
-	#version 130                                    \n\
-	in vec4 point;							        \n\
-	out vec2 vUv;                                   \n\
-	uniform mat4 view;                              \n\
-	void main() {                                   \n\
-		gl_Position = view*vec4(point.xy, 0, 1);    \n\
-		vUv = point.zw;                             \n\
-	}                                               \n";
-
-static const char *textPixelShader = "\
-	#version 130                                    \n\
-	in vec2 vUv;                                    \n\
-	out vec4 pColor;                                \n\
-	uniform sampler2D textureImage;                 \n\
-	uniform vec3 color;                             \n\
-	void main() {                                   \n\
-		float a = texture(textureImage, vUv).r;     \n\
-		pColor = vec4(color, a);                    \n\
-	}                                               \n";
+static const char *textVertexShader = R"(
+	#version 330 core
+	in vec4 point;                                  // xy: position, zw: atlas uv
+	in vec3 color;
+	in float page;
+	out vec2 vUv;
+	out vec3 vColor;
+	flat out float vPage;
+	uniform mat4 view;
+	void main() {
+		gl_Position = view*vec4(point.xy, 0, 1);
+		vUv = point.zw;
+		vColor = color;
+		vPage = page;
+	}
+)";
+
+static const char *textPixelShader = R"(
+	#version 330 core
+	in vec2 vUv;
+	in vec3 vColor;
+	flat in float vPage;
+	out vec4 pColor;
+	uniform sampler2DArray textureImage;			// signed distance, .5 at glyph edge
+	uniform float edge = .5;						// lower for outline
+	uniform vec3 outlineColor;
+	uniform vec2 shadowOffset;						// in uv
+	uniform float shadowOpacity = 0;
+	uniform vec3 shadowColor;
+	void main() {
+		float d = texture(textureImage, vec3(vUv, vPage)).r;
+		float aa = max(.7*fwidth(d), 1e-4);		// about a pixel at any scale
+		float fill = smoothstep(.5-aa, .5+aa, d);
+		float a = smoothstep(edge-aa, edge+aa, d);
+		vec3 c = mix(outlineColor, vColor, fill);
+		if (shadowOpacity > 0) {
+			// shadow under glyph and outline, same sample footprint
+			float s = shadowOpacity*smoothstep(edge-aa, edge+aa, texture(textureImage, vec3(vUv-shadowOffset, vPage)).r);
+			float alpha = a+s*(1-a);
+			c = alpha > 0? (a*c+s*(1-a)*shadowColor)/alpha : c;
+			a = alpha;
+		}
+		pColor = vec4(c, a);
+	}
+)";
 
-void RenderText(const char *text, float x, float y, vec3 color, float scale, mat4 view, bool vertical) {
-	if (!currentFont) {
+static bool textRegistered = RegisterProgram("Text", &textVertexShader, &textPixelShader);
+
+// batch
+
+static vector<GlyphVertex> textVertices;			// six per glyph, any font
+static mat4 textView;
+static int textCapacity = 0, textDepth = 0;			// bytes allocated in textVertexBuffer, Begin nesting
+
+// effects
+static float textOutline = 0, textShadowOpacity = 0;
+static vec3 textOutlineColor, textShadowColor;
+static vec2 textShadowOffset;
+
+void TextOutline(float width, vec3 color) {
+	FlushText();
+	textOutline = width < 0? 0 : width > 1? 1 : width;
+	textOutlineColor = color;
+}
+
+void TextShadow(vec2 offset, float opacity, vec3 color) {
+	FlushText();
+	textShadowOffset = offset;
+	textShadowOpacity = opacity;
+	textShadowColor = color;
+}
+
+static CharacterSet *TextFont() {
+	if (!currentFont)
 		SetFont("C:/Fonts/OpenSans/OpenSans-Regular.ttf", 64, 100);  // unsure exact effect of charRes, pixelRes
-		return;
+	return currentFont;
+}
+
+static float AddGlyph(CharacterSet *font, int c, float x, float y, vec3 color, float scale, vector<GlyphVertex> &v) {
+	// append quad for code point c with pen at (x, y), return advance
+	Character *g = FindGlyph(font, c);
+	if (!g)
+		return 0;
+	Character &ch = *g;
+	scale /= (float) font->charRes;
+	float xpos = x+ch.bearing.x*scale, ypos = y-(ch.size.y-ch.bearing.y)*scale;
+	float w = ch.size.x*scale, h = ch.size.y*scale;
+	if (ch.page >= 0 && w > 0 && h > 0) {
+		// two triangles, top-left of glyph at uv0
+		float page = (float) ch.page;
+		GlyphVertex tl(vec2(xpos, ypos+h), ch.uv0, color, page), tr(vec2(xpos+w, ypos+h), vec2(ch.uv1.x, ch.uv0.y), color, page);
+		GlyphVertex br(vec2(xpos+w, ypos), ch.uv1, color, page), bl(vec2(xpos, ypos), vec2(ch.uv0.x, ch.uv1.y), color, page);
+		GlyphVertex quad[] = { tl, tr, br, tl, br, bl };
+		v.insert(v.end(), quad, quad+6);
 	}
+	return (ch.advance >> 6)*scale;					// advance is in 1/64 pixel
+}
+
+static void UseGlyphShader(mat4 view) {
 	if (!textShaderProgram)
 		textShaderProgram = LinkProgramViaCode(&textVertexShader, &textPixelShader);
 	glUseProgram(textShaderProgram);
-	scale /= (float) currentFont->charRes;
-	// create quad vertex buffer and build characters
-	if (textVertexBuffer == 0)
-		glGenBuffers(1, &textVertexBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, textVertexBuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(float)*6*4, NULL, GL_DYNAMIC_DRAW);
-	VertexAttribPointer(textShaderProgram, "point", 4, 4*sizeof(float), 0);
 	SetUniform(textShaderProgram, "view", view);
-	SetUniform(textShaderProgram, "color", color);
-	// SetUniform(textShaderProgram, "textureImage", (int) textureID); // not needed? (defaults to 0?)
-	glActiveTexture(GL_TEXTURE0);
-	glBindBuffer(GL_ARRAY_BUFFER, textVertexBuffer);
+	SetUniform(textShaderProgram, "textureImage", 0);
+	SetUniform(textShaderProgram, "edge", .5f-.5f*textOutline);
+	SetUniform(textShaderProgram, "outlineColor", textOutlineColor);
+	float texel = (float) sdfSpread/pageSize;
+	SetUniform(textShaderProgram, "shadowOffset", vec2(texel*textShadowOffset.x, -texel*textShadowOffset.y));	// page rows run down
+	SetUniform(textShaderProgram, "shadowOpacity", textShadowOpacity);
+	SetUniform(textShaderProgram, "shadowColor", textShadowColor);
+	BindPages();
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	for (const char *c = text; *c; c++) {
-		Character ch = currentFont->characters[(int)*c];
-		float xpos = x+ch.bearing.i1*scale, ypos = y-(ch.gSize.i2-ch.bearing.i2)*scale;
-		float w = ch.gSize.i1*scale, h = ch.gSize.i2*scale;
-		glBindTexture(GL_TEXTURE_2D, ch.textureID);
-		// update vertex memory
-#ifdef GL_QUADS
-		float vertices[][4] = {{xpos, ypos+h, 0, 0}, {xpos+w, ypos+h, 1, 0}, {xpos+w, ypos, 1, 1}, {xpos, ypos, 0, 1}};
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-		glDrawArrays(GL_QUADS, 0, 4);     // render glyph texture with quad
-#else
-		float vertices[][4] = {{xpos, ypos+h, 0, 0}, {xpos+w, ypos+h, 1, 0}, {xpos+w, ypos, 1, 1},
-							   {xpos, ypos+h, 0, 0}, {xpos+w, ypos, 1, 1},   {xpos, ypos, 0, 1}};
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-		glDrawArrays(GL_TRIANGLES, 0, 6); // render glyph texture with triangles
-#endif
+}
+
+static void GlyphAttributes(int program) {
+	VertexAttribPointer(program, "point", 4, sizeof(GlyphVertex), 0);
+	VertexAttribPointer(program, "color", 3, sizeof(GlyphVertex), (void *) (2*sizeof(vec2)));
+	VertexAttribPointer(program, "page", 1, sizeof(GlyphVertex), (void *) (2*sizeof(vec2)+sizeof(vec3)));
+}
+
+void FlushText() {
+	if (textVertices.empty())
+		return;
+	FlushDrawList();								// keep draw order with batched lines, disks, etc.
+	UseGlyphShader(textView);
+	if (!textVertexArray) {
+		glGenVertexArrays(1, &textVertexArray);
+		glGenBuffers(1, &textVertexBuffer);
+		glBindVertexArray(textVertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, textVertexBuffer);
+		GlyphAttributes(textShaderProgram);
+	}
+	glBindVertexArray(textVertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, textVertexBuffer);
+	int nBytes = textVertices.size()*sizeof(GlyphVertex);
+	if (nBytes > textCapacity)
+		textCapacity = std::max(nBytes+nBytes/2, 6*256*(int) sizeof(GlyphVertex));
+	glBufferData(GL_ARRAY_BUFFER, textCapacity, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, nBytes, textVertices.data());
+	glDrawArrays(GL_TRIANGLES, 0, (int) textVertices.size());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+	textVertices.resize(0);
+}
+
+void BeginText() { textDepth++; }
+
+void EndText() {
+	if (textDepth > 0 && --textDepth == 0)
+		FlushText();
+}
+
+void RenderText(const char *text, float x, float y, vec3 color, float scale, mat4 view, bool vertical) {
+	CharacterSet *font = TextFont();
+	if (!font->face)
+		return;
+	if (!textVertices.empty() && memcmp(&textView, &view, sizeof(mat4)))
+		FlushText();
+	textView = view;
+	CacheText(font, text);
+	for (const char *c = text; *c; ) {
+		int n, code = DecodeUtf8(c, &n);
+		float advance = AddGlyph(font, code, x, y, color, scale, textVertices);
+		c += n;
 		if (vertical)
-			y -= 24*scale;
+			y -= 24*scale/(float) font->charRes;
 		else
-			x += (ch.advance >> 6)*scale;     // advance character position in terms of 1/64 pixel
+			x += advance;
 	}
-	glBindVertexArray(0);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	if (!textDepth)
+		FlushText();
 }
 
 float TextWidth(float scale, const char *format, ...) {
@@ -199,11 +635,15 @@ float TextWidth(float scale, const char *format, ...) {
 	if (!currentFont)
 		SetFont("C:/Fonts/OpenSans/OpenSans-Regular.ttf", 15, 30);  // unsure exact affect of charRes, pixelRes
 			// name, charRes, pixelRes
-	if (currentFont != NULL) {
+	if (currentFont != NULL && currentFont->face) {
 		scale /= (float) currentFont->charRes;
-		for (const char* c = text; *c; c++) {
-			Character ch = currentFont->characters[(int)*c];
-			w += (ch.advance >> 6) * scale;
+		CacheText(currentFont, text);
+		for (const char *c = text; *c; ) {
+			int n;
+			Character *ch = FindGlyph(currentFont, DecodeUtf8(c, &n));
+			c += n;
+			if (ch)
+				w += (ch->advance >> 6) * scale;
 		}
 	}
 //  printf("wid of %s = %4.3f\n", text, w);
@@ -237,6 +677,142 @@ void Text(float x, float y, vec3 color, float scale, const char *format, ...) {
 
 #endif
 
+// retained text
+
+TextBlock::TextBlock(float x, float y, vec3 color, float scale) : x(x), y(y), scale(scale), color(color) { }
+
+void TextBlock::SetPosition(float newX, float newY) {
+	if (newX != x || newY != y)
+		relayout = true;
+	x = newX;
+	y = newY;
+}
+
+void TextBlock::SetColor(vec3 newColor) {
+	if (newColor.x != color.x || newColor.y != color.y || newColor.z != color.z)
+		relayout = true;
+	color = newColor;
+}
+
+void TextBlock::SetScale(float newScale) {
+	if (newScale != scale)
+		relayout = true;
+	scale = newScale;
+}
+
+bool TextBlock::Print(const char *format, ...) {
+	char s[500];
+	FormatString(s, 500, format);
+	return SetText(s);
+}
+
+bool TextBlock::SetText(const char *s) {
+	if (!relayout && font == TextFont() && generation == GlyphGeneration() && text == s)
+		return false;
+	Layout(s);
+	return true;
+}
+
+void TextBlock::Layout(const char *s) {
+	CharacterSet *f = TextFont();
+	bool all = relayout || f != font || generation != GlyphGeneration() || starts.empty();
+	int first = 0;
+	if (all) {
+		starts.assign(1, 0);
+		pens.assign(1, x);
+	}
+	else {
+		while (s[first] && s[first] == text[first])
+			first++;
+		while (first > 0 && ((s[first] & 0xC0) == 0x80 || (text[first] & 0xC0) == 0x80))
+			first--;								// back up to start of a multi-byte character
+	}
+	font = f;
+	relayout = false;
+	if (font)
+		CacheText(font, s+first);
+	generation = GlyphGeneration();
+	// characters before first keep their quads; lay out the rest
+	int base = starts[first], n = (int) strlen(s);
+	previous.assign(vertices.begin()+base, vertices.end());
+	vertices.resize(base);
+	starts.resize(first+1);
+	pens.resize(first+1);
+	float pen = pens[first];
+	for (int i = first; i < n; ) {
+		int nBytes, code = DecodeUtf8(s+i, &nBytes);
+		pen += AddGlyph(font, code, pen, y, color, scale, vertices);
+		for (int k = 0; k < nBytes; k++) {			// bytes after the first of a character are empty
+			starts.push_back((int) vertices.size());
+			pens.push_back(pen);
+		}
+		i += nBytes;
+	}
+	text = s;
+	// the buffer holds previous: trim the new vertices that match it from either end
+	int nNew = (int) vertices.size()-base, nOld = (int) previous.size(), lo = 0, hi = nNew;
+	while (lo < nNew && lo < nOld && !memcmp(&vertices[base+lo], &previous[lo], sizeof(GlyphVertex)))
+		lo++;
+	if (nNew == nOld)
+		while (hi > lo && !memcmp(&vertices[base+hi-1], &previous[hi-1], sizeof(GlyphVertex)))
+			hi--;
+	if (hi > lo) {
+		dirtyBegin = dirtyEnd > dirtyBegin? std::min(dirtyBegin, base+lo) : base+lo;
+		dirtyEnd = std::max(dirtyEnd, base+hi);
+	}
+}
+
+void TextBlock::Draw() { Draw(ScreenMode()); }
+
+void TextBlock::Draw(mat4 view) {
+	if (generation != GlyphGeneration()) {
+		// glyphs were dropped from the cache: their quads may refer to recycled pages
+		relayout = true;
+		Layout(text.c_str());
+	}
+	int n = (int) vertices.size();
+	if (!n)
+		return;
+	FlushText();									// keep draw order with batched text,
+	FlushDrawList();								// lines, disks, etc.
+	int was = CurrentProgram();
+	UseGlyphShader(view);
+	if (!vArray) {
+		glGenVertexArrays(1, &vArray);
+		glGenBuffers(1, &vBuffer);
+		glBindVertexArray(vArray);
+		glBindBuffer(GL_ARRAY_BUFFER, vBuffer);
+		GlyphAttributes(CurrentProgram());
+	}
+	glBindVertexArray(vArray);
+	glBindBuffer(GL_ARRAY_BUFFER, vBuffer);
+	if (n > capacity) {
+		capacity = n+n/2;
+		glBufferData(GL_ARRAY_BUFFER, capacity*sizeof(GlyphVertex), NULL, GL_DYNAMIC_DRAW);
+		dirtyBegin = 0;
+		dirtyEnd = n;
+	}
+	int end = std::min(dirtyEnd, n);
+	if (end > dirtyBegin)
+		glBufferSubData(GL_ARRAY_BUFFER, dirtyBegin*sizeof(GlyphVertex), (end-dirtyBegin)*sizeof(GlyphVertex), &vertices[dirtyBegin]);
+	dirtyBegin = dirtyEnd = 0;
+	glDrawArrays(GL_TRIANGLES, 0, n);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+	glUseProgram(was);
+}
+
+void TextBlock::Release() {
+	if (vBuffer)
+		glDeleteBuffers(1, &vBuffer);
+	if (vArray)
+		glDeleteVertexArrays(1, &vArray);
+	vBuffer = vArray = 0;
+	capacity = 0;
+	dirtyBegin = dirtyEnd = 0;
+	relayout = true;
+}
+
 const int nnicemax = 100;
 char nicees[nnicemax][nnicemax];
 int nnicee = 0;